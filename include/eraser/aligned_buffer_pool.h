@@ -0,0 +1,76 @@
+#if defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+namespace shredder {
+
+/// @brief Page-aligned buffers of the same size, allocated in one anonymous mapping,
+/// optionally backed by huge pages. Suitable for O_DIRECT writes and io_uring fixed buffers
+/// Not thread-safe, one pool per eraser
+class AlignedBufferPool {
+public:
+
+    /// Direct I/O alignment of buffers, offsets and lengths, enough for 4Kn drives
+    static constexpr size_t IO_ALIGNMENT = 4096;
+
+    /// Huge page size, buffers are rounded up to it if huge pages are requested
+    static constexpr size_t HUGE_PAGE_SIZE = 1024 * 1024 * 2;
+
+    /// @brief Empty pool
+    AlignedBufferPool() = default;
+
+    /// @brief Unmap buffers
+    ~AlignedBufferPool();
+
+    AlignedBufferPool(const AlignedBufferPool&) = delete;
+    AlignedBufferPool& operator=(const AlignedBufferPool&) = delete;
+
+    /// @brief Allocate buffers, every buffer size is rounded up to IO_ALIGNMENT
+    /// @param huge_pages: try explicit huge pages (MAP_HUGETLB), then transparent ones,
+    /// fall back to regular pages silently
+    /// @return false if unable to allocate
+    bool init(size_t buffers_count, size_t buffer_size, bool huge_pages = false);
+
+    /// @brief Unmap buffers
+    void release();
+
+    /// @brief True if buffers are allocated
+    bool is_ready() const { return memory_ != nullptr; }
+
+    /// @brief Fill every buffer by the repeated mask
+    void fill(const uint8_t* mask, size_t mask_length);
+
+    /// @brief Buffer by index
+    uint8_t* buffer(size_t index) const;
+
+    /// @brief Size of every buffer
+    size_t buffer_size() const { return buffer_size_; }
+
+    /// @brief Number of buffers
+    size_t buffers_count() const { return buffers_count_; }
+
+    /// @brief True if buffers are backed by explicit huge pages
+    bool is_huge_pages() const { return huge_pages_; }
+
+private:
+
+    /// One mapping for all buffers
+    uint8_t* memory_ = nullptr;
+
+    /// Size of the mapping
+    size_t memory_size_ = 0;
+
+    /// Size of every buffer
+    size_t buffer_size_ = 0;
+
+    /// Number of buffers
+    size_t buffers_count_ = 0;
+
+    /// Mapped by MAP_HUGETLB
+    bool huge_pages_ = false;
+};
+
+} // namespace shredder
+
+#endif // defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
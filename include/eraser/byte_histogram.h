@@ -0,0 +1,64 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace shredder {
+
+/// @brief 256-bin counter of byte values
+/// Counts are accumulated in several interleaved tables, so that repeating bytes
+/// do not serialize on the same counter (store-to-load dependency).
+/// Counting kernel (scalar or SSE4.2/AVX2/AVX-512 run-skipping) is chosen for every page, see histogram_kernels.h
+class ByteHistogram {
+public:
+
+    /// Number of possible byte values
+    static constexpr size_t BINS_COUNT = 256;
+
+    /// @brief Empty histogram
+    ByteHistogram() = default;
+
+    /// @brief Satisfy compiler
+    ~ByteHistogram() = default;
+
+    /// @brief Count every byte of the block
+    void update(const uint8_t* block_start, size_t block_size);
+
+    /// @brief Add counters of another histogram (e.g. calculated in a different thread)
+    void merge(const ByteHistogram& other);
+
+    /// @brief Reset all counters
+    void clear();
+
+    /// @brief Number of bytes counted so far
+    uintmax_t total() const { return total_; }
+
+    /// @brief Counter of the particular byte value
+    uint64_t count(uint8_t byte_value) const { return counters_[byte_value]; }
+
+    /// @brief Shannon entropy of counted bytes, from 0.0 to 8.0
+    double entropy() const;
+
+    /// @brief Counters as a vector, indexed by byte value
+    std::vector<size_t> distribution() const;
+
+private:
+
+    /// Max bytes per one partial pass, so that 32-bit partial counters never overflow
+    static constexpr size_t MAX_PASS_SIZE = 1024 * 1024 * 1024;
+
+    /// The kernel is chosen for every page of the pass
+    static constexpr size_t KERNEL_PAGE_SIZE = 4096;
+
+    /// Count bytes using interleaved 32-bit tables and flush them into the 64-bit counters
+    void update_pass(const uint8_t* block_start, size_t block_size);
+
+    /// Counters, indexed by byte value
+    std::array<uint64_t, BINS_COUNT> counters_{};
+
+    /// Total bytes counted
+    uintmax_t total_{};
+};
+
+} // namespace shredder
@@ -0,0 +1,30 @@
+#pragma once
+#include <atomic>
+
+namespace shredder {
+
+/// @brief Cancellation flag of one submitted job (e.g. entropy scan of one file)
+/// Shared by the submitter and the worker, checked by the worker once per block,
+/// so that cancellation of one job does not affect the others
+class CancellationToken {
+public:
+
+    /// @brief Not cancelled
+    CancellationToken() = default;
+
+    CancellationToken(const CancellationToken&) = delete;
+    CancellationToken& operator=(const CancellationToken&) = delete;
+
+    /// @brief Request cancellation, the job stops at the next check
+    void cancel() { cancelled_.store(true, std::memory_order_relaxed); }
+
+    /// @brief True if cancellation has been requested
+    bool is_cancelled() const { return cancelled_.load(std::memory_order_relaxed); }
+
+private:
+
+    /// Relaxed access is enough, the flag does not guard any data
+    std::atomic<bool> cancelled_{ false };
+};
+
+} // namespace shredder
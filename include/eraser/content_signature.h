@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+namespace shredder {
+
+/// @brief Container format recognized by the leading bytes of the file (magic number).
+/// Archives and media are compressed (high entropy, but not ciphertext),
+/// encrypted volumes and messages are ciphertext after a short header
+class ContentSignature {
+public:
+
+    enum ContainerType {
+        Unknown,
+        Zip,
+        Gzip,
+        Zstd,
+        Xz,
+        SevenZip,
+        Jpeg,
+        Png,
+        Mp4,
+        Luks,
+        Age,
+        Gpg
+    };
+
+    /// Bytes enough to recognize any known container
+    static constexpr size_t HEADER_SIZE = 32;
+
+    /// @brief Recognize container by the leading bytes of the file
+    /// @param header_size: may be less than HEADER_SIZE for small files
+    static ContainerType detect(const uint8_t* header, size_t header_size);
+
+    /// @brief Content of the container is ciphertext
+    static bool is_encrypted(ContainerType container);
+
+    /// @brief Signature is short or generic enough to be met in other data by chance,
+    /// so that the content has to be confirmed by a sample
+    static bool is_weak(ContainerType container);
+
+    /// @brief Readable container name
+    static std::string name(ContainerType container);
+};
+
+} // namespace shredder
@@ -0,0 +1,81 @@
+#pragma once
+#include <eraser/byte_histogram.h>
+
+#include <cstdint>
+#include <cstddef>
+
+namespace shredder {
+
+/// @brief Randomness statistics of the byte sequence, accumulated in the same pass as the histogram:
+/// chi-square of the byte distribution, arithmetic mean, serial correlation of consecutive bytes
+/// and Monte Carlo estimation of pi from 24-bit coordinate pairs (as in the 'ent' tool).
+/// Ciphertext passes all of them, while compressed data has as high entropy, but fails chi-square
+class ContentStatistics {
+public:
+
+    /// @brief Empty statistics
+    ContentStatistics() = default;
+
+    /// @brief Satisfy compiler
+    ~ContentStatistics() = default;
+
+    /// @brief Account every byte of the block, blocks must come in the sequence order
+    void update(const uint8_t* block_start, size_t block_size);
+
+    /// @brief Account statistics of the sequence following this one (e.g. the next range of the file).
+    /// Exact if the length of this sequence is multiple of the Monte Carlo point (6 bytes),
+    /// otherwise bytes of its incomplete last point are not counted
+    void append(const ContentStatistics& next);
+
+    /// @brief Byte counters of the sequence
+    const ByteHistogram& histogram() const { return histogram_; }
+
+    /// @brief Number of bytes accounted so far
+    uintmax_t total() const { return histogram_.total(); }
+
+    /// @brief Pearson's chi-square of byte counters against the uniform distribution, 255 degrees of freedom
+    double chi_square() const;
+
+    /// @brief Arithmetic mean of bytes, 127.5 for random data
+    double mean() const;
+
+    /// @brief Circular serial correlation coefficient of consecutive bytes, close to 0.0 for random data
+    double serial_correlation() const;
+
+    /// @brief Monte Carlo value of pi, close to M_PI for random data
+    double monte_carlo_pi() const;
+
+    /// @brief Number of points of the Monte Carlo estimation
+    uint64_t monte_carlo_points() const { return monte_carlo_points_; }
+
+    /// Bytes per coordinate pair of the Monte Carlo estimation
+    static constexpr size_t MONTE_CARLO_POINT_SIZE = 6;
+
+private:
+
+    /// Blocks are passed to the histogram and statistics by parts of that size, which stay in L2 cache
+    static constexpr size_t CACHE_PASS_SIZE = 1024 * 64;
+
+    /// Update serial and Monte Carlo sums of the cache-resident part of the block
+    void update_pass(const uint8_t* block_start, size_t block_size);
+
+    /// Byte counters
+    ByteHistogram histogram_;
+
+    /// Sum of products of consecutive bytes
+    uint64_t serial_products_{};
+
+    /// First and last byte of the sequence, closing the circular correlation
+    uint8_t first_byte_{};
+    uint8_t last_byte_{};
+
+    /// Bytes of the incomplete Monte Carlo point at the end of the previous block
+    uint8_t point_bytes_[MONTE_CARLO_POINT_SIZE]{};
+    size_t point_bytes_size_{};
+
+    /// Monte Carlo points total and inside the circle
+    uint64_t monte_carlo_points_{};
+    uint64_t monte_carlo_inside_{};
+};
+
+} // namespace shredder
@@ -11,7 +11,11 @@
 #include <mutex>
 #include <winapi-helpers/partition_information.h>
 #include <winapi-helpers/dynamic_handler_map.h>
+#include <eraser/erase_range.h>
+#include <eraser/erasure_checkpoint.h>
+#include <eraser/erasure_scheme.h>
 #include <eraser/random_generator.h>
+#include <eraser/shredder_file_identity.h>
 #include <eraser/shredder_file_info.h>
 
 
@@ -28,6 +32,9 @@ class ShannonEncryptionChecker;
 namespace shredder {
 
 class NativeFileEraser;
+class IoUringEraser;
+class ReadBackVerifier;
+class ShredderDatabaseWrapper;
 
 #ifdef ERASE_PROFILING
 struct OutputInfo
@@ -48,11 +55,13 @@ public:
     using DiskType = helpers::PartititonInformation::DiskType;
 
     // Full - all file, Random - begin, end and random areas in the middle, BeginEnd - only begin and End (suitable for excrypted)
+    // Discard - begin and end, blocks in the middle are released (suitable for SSD)
     enum class ErasureMethod {
         Smart,
         Full,
         Random,
-        BeginEnd
+        BeginEnd,
+        Discard
     };
 
     // @brief Also accept erasure type (Smart by default) and disk type
@@ -70,10 +79,15 @@ public:
     ~DriveEraser() = default;
 
     /// @brief Shred files on this particular drive
-    void shred_files();
+    /// @param erasure_scheme: overwrite passes of the job, a single pass of the drive random sequence if nullptr
+    /// @param journal: progress of files is saved there and the interrupted job is resumed from it, nullptr for no journal
+    /// @return paths of files whose last pass did not read back as written, empty if verification is off
+    std::vector<std::wstring> shred_files(std::shared_ptr<const ErasureScheme> erasure_scheme = nullptr, ShredderDatabaseWrapper* journal = nullptr);
     
     /// @brief Submit file root and path
-    void submit(const std::wstring& root, const std::wstring& file_path, double entropy);
+    /// @param flags: file properties, Compressed flag affects the smart erasure
+    void submit(const std::wstring& root, const std::wstring& file_path, double entropy, int64_t flags = 0,
+                std::shared_ptr<const EntropyMap> entropy_map = nullptr);
     
     /// @brief Remove file root and path
     void remove(const std::wstring& root, const std::wstring& file_path);
@@ -96,10 +110,34 @@ public:
     /// @brief Return directories prepared for erase this moment
     std::vector<std::wstring> directories_prepared() const;
 
+    /// @brief Rename the file several times, without removal. Names keep the length of the original one
+    /// and are unique in the process, so that nodes waiting for the asynchronous unlink never replace each other.
+    /// An existing entry is never replaced
+    /// @return false if the file is not renamed to the final name
+    static bool rename_file_node(const std::wstring& initial_path, boost::filesystem::path& renamed_path);
+
+    /// @brief Hash the bytes the checkpoint is validated by: up to ErasureCheckpoint::PROBE_SIZE bytes
+    /// just before its offset, or at the file beginning if the offset is 0
+    /// @return false if the file could not be read
+    static bool read_checkpoint_probe(const std::wstring& file_path, const ErasureCheckpoint& checkpoint, uint64_t& probe);
+
 private:
 
     /// pass by value so that handle std::move and async execution
-    void erase_file(std::wstring file_path, double entropy);
+    /// compressed: high entropy is not ciphertext, file is erased as Binary
+    void erase_file(ShredderFileInfo erase_info);
+
+    /// Run all passes of the erasure scheme on the open file back to back, flush it between passes,
+    /// queue read-back of the last pass if verification is on. Passes before the checkpoint are skipped,
+    /// progress is journaled if the journal is set
+    void overwrite_passes(NativeFileEraser& native_file_eraser, ErasureMethod erasure_method, const std::wstring& file_path,
+                          const ShredderFileIdentity& identity, const ErasureCheckpoint& checkpoint);
+
+    /// Save progress of the file with the probe of its content, nothing is saved if the file could not be read
+    void journal_checkpoint(const std::wstring& file_path, const ShredderFileIdentity& identity, ErasureCheckpoint checkpoint);
+
+    /// Sync the filesystem once, then remove file nodes overwritten since the last commit
+    void commit_group(const std::wstring& root);
 
     /// Multiple rename of the file
     bool cheat_file_node(const std::wstring& initial_path);
@@ -129,6 +167,24 @@ private:
     /// Save random generated sequence for erasure
     RandomGenerator gen_;
 
+    /// Overwrite passes of the current job, nullptr for a single pass of gen_ sequence
+    std::shared_ptr<const ErasureScheme> erasure_scheme_;
+
+    /// Asynchronous engine of the drive while files are shredded, nullptr for blocking writes
+    IoUringEraser* io_uring_eraser_ = nullptr;
+
+    /// Verifier of the drive while files are shredded, nullptr if verification is off
+    ReadBackVerifier* readback_verifier_ = nullptr;
+
+    /// Journal of the current job, nullptr if progress is not saved
+    ShredderDatabaseWrapper* journal_ = nullptr;
+
+    /// Overwritten files of the current partition waiting for the group commit
+    std::vector<std::wstring> uncommitted_files_;
+
+    /// Filesystem ranges released by files of the current partition, trimmed after the drive is erased
+    std::vector<EraseRange> released_extents_;
+
     /// Map installation response codes to handle actions
     helpers::HandlerMap <
         ErasureMethod,
@@ -0,0 +1,19 @@
+#pragma once
+
+namespace shredder {
+
+/// @brief When overwritten data is forced to the drive. In any case it happens before the file node is removed
+enum class DurabilityPolicy {
+
+    /// Every write reaches the drive before it returns (FILE_FLAG_WRITE_THROUGH, O_DSYNC)
+    PerWrite,
+
+    /// Writes are cached, the file is flushed once after the overwrite (FlushFileBuffers, fdatasync)
+    PerFile,
+
+    /// Writes are cached, the filesystem is flushed once after all its files are overwritten (syncfs),
+    /// then file nodes are removed. The cheapest one for thousands of small files
+    GroupCommit
+};
+
+} // namespace shredder
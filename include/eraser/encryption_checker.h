@@ -2,13 +2,20 @@
 #include <eraser/shredder_callback_interface.h>
 
 #include <algorithm>
+#include <atomic>
 #include <vector>
 #include <map>
+#include <memory>
 #include <string>
 #include <cmath>
 #include <cassert>
 namespace shredder {
 
+class ByteHistogram;
+class ContentStatistics;
+class EntropyMap;
+class CancellationToken;
+
 /// @brief Accept range of probabilities per byte
 /// Zero-probability in the sequence could be skipped
 /// @return entropy if everything ok, -1.0 if probabilities range overflows one byte
@@ -48,6 +55,75 @@ public:
         EntropyLevelSize
     };
 
+    /// @brief How the file content is delivered to the histogram
+    enum FileScanMode {
+        /// Read by blocks into the heap buffer
+        BufferedScan,
+        /// Map file by read-only windows (Linux), zero-copy scanning of big files.
+        /// Small and special files are still read by buffers.
+        /// Files must not be truncated during the scan
+        MappedScan,
+        /// Keep reads of the next blocks in flight by io_uring (Linux) while the current one is counted,
+        /// for high-latency volumes. Histograms count blocks in completion order, statistics and entropy maps
+        /// in the file order. Falls back to buffered reading if io_uring is unavailable
+        AsyncScan
+    };
+
+    /// @brief Entropy of the file estimated from the whole file or from the sample of blocks
+    struct EntropyEstimate
+    {
+        /// Point estimate, -1.0 if calculation was interrupted
+        double entropy = -1.0;
+
+        /// Confidence interval of the estimate, equal to the entropy if the whole file was read
+        double lower_bound = -1.0;
+        double upper_bound = -1.0;
+
+        /// Bytes actually read
+        uintmax_t sample_size = 0;
+
+        /// Size of the file
+        uintmax_t file_size = 0;
+
+        /// True if only randomly placed blocks were read
+        bool sampled = false;
+
+        /// Classification of the estimate
+        InformationEntropyEstimation estimation = Unknown;
+    };
+
+    /// @brief Classification of the content by several randomness statistics, calculated in one pass
+    struct ContentClassification
+    {
+        /// Shannon entropy, -1.0 if calculation was interrupted
+        double entropy = -1.0;
+
+        /// Chi-square of byte counters, 255 degrees of freedom, and its normal approximation (z-score)
+        double chi_square = 0.0;
+        double chi_square_z = 0.0;
+
+        /// Arithmetic mean of bytes, 127.5 for random data
+        double mean = 0.0;
+
+        /// Serial correlation coefficient of consecutive bytes, close to 0.0 for random data
+        double serial_correlation = 0.0;
+
+        /// Monte Carlo value of pi, close to M_PI for random data
+        double monte_carlo_pi = 0.0;
+
+        /// Bytes analyzed
+        uintmax_t sample_size = 0;
+
+        /// All statistics are consistent with uniformly random bytes
+        bool random = false;
+
+        /// Entropy is as high as of ciphertext, but statistics are not random (compressed data)
+        bool compressed = false;
+
+        /// Encrypted only if entropy and randomness tests agree, otherwise compressed data is Binary
+        InformationEntropyEstimation estimation = Unknown;
+    };
+
     /// @brief Set facet for unsigned char (boost binary reading twice)
     ShannonEncryptionChecker();
 
@@ -59,11 +135,83 @@ public:
     /// but callback::cleanup() can be elsewhere
     void set_callback(IShredderCallback* callback);
 
+    /// @brief Set file scanning mode, BufferedScan by default
+    void set_scan_mode(FileScanMode scan_mode);
+
+    /// @brief Set number of blocks in flight in AsyncScan mode
+    void set_async_queue_depth(unsigned queue_depth);
+
+    /// @brief Set map filled with entropy of every region in the next complete file scan
+    /// (get_file_entropy(), get_file_classification(), range scans), nullptr to disable.
+    /// Regions are counted in the file order in every scan mode.
+    /// Sampled scans give sampled regions entropy of their blocks, other regions the whole file estimate
+    void set_entropy_map(EntropyMap* entropy_map);
+
+    /// @brief Set token cancelling every following scan of this checker only, nullptr to disable.
+    /// The token is checked once per block, as well as the interrupt() flag
+    void set_cancellation_token(std::shared_ptr<const CancellationToken> cancellation_token);
+
     /// @brief Detect whether file encrypted or very highly compressed with high enough probability
     /// @param file_path: full file path, passed by r-value to be executed in different thread 
     /// @param epsilon: estimated difference between absolute chaos (8.0) and actual entropy
     double get_file_entropy(std::wstring file_path) const;
 
+    /// @brief Set sample for get_sampled_file_entropy()
+    /// @param blocks_count: number of randomly placed blocks to read
+    /// @param block_size: size of every block in bytes
+    void set_sampling(size_t blocks_count, size_t block_size = SAMPLE_BLOCK_SIZE);
+
+    /// @brief Estimate entropy reading only a sample of randomly placed blocks, so that time does not
+    /// depend on the file size. Files not bigger than the sample are read completely.
+    /// Point estimate is bias-corrected (Miller-Madow), confidence interval is a block jackknife
+    EntropyEstimate get_sampled_file_entropy(std::wstring file_path) const;
+
+    /// @brief Classify the file from the same sample as get_sampled_file_entropy(): entropy is the sampled estimate,
+    /// randomness statistics are those of the sample, so that compressed data is not taken for ciphertext.
+    /// Files not bigger than the sample are classified by get_file_classification()
+    ContentClassification get_sampled_file_classification(std::wstring file_path) const;
+
+    /// @brief Classify the file reading it block by block, and stop as soon as the class
+    /// can not change with the required confidence (e.g. text clearly below 6.0 after first Mbs).
+    /// Blocks are spread over the whole file from the very beginning of the scan.
+    /// If the class is never settled, the whole file is read and the entropy is exact
+    EntropyEstimate classify_file_entropy(std::wstring file_path) const;
+
+    /// @brief Classify the file by entropy, chi-square, mean, serial correlation and Monte Carlo pi,
+    /// all calculated in the same pass over the file, so that compressed data is not taken for ciphertext
+    ContentClassification get_file_classification(std::wstring file_path) const;
+
+    /// @brief Set number of SAMPLE_BLOCK_SIZE blocks confirming get_signature_classification(),
+    /// 0 to trust strong archive and media signatures without reading further
+    /// (weak signatures and encrypted containers are always confirmed)
+    void set_signature_confirmation(size_t blocks_count);
+
+    /// @brief Classify the file by the container signature of its leading bytes (archives, media,
+    /// encrypted volumes and messages, see ContentSignature) without reading the whole file.
+    /// Archives and media are Binary and compressed, encrypted containers are Encrypted
+    /// @return false if the signature is unknown, the confirming sample is plain (e.g. text after zip header),
+    /// or the sample of the encrypted container is not Encrypted
+    bool get_signature_classification(std::wstring file_path, ContentClassification& classification) const;
+
+    /// @brief Classify the bytes sequence (e.g. memory) the same way as get_file_classification()
+    ContentClassification get_sequence_classification(const uint8_t* sequence_start, size_t sequence_size) const;
+
+    /// @brief Count bytes of the file range, so that the file could be split between threads
+    /// Histograms of all ranges are merged, then entropy is calculated by ByteHistogram::entropy().
+    /// The range is scanned in the current scan mode, offset must be multiple of the page size in MappedScan mode.
+    /// The entropy map, if set, gets regions of the range only, starting at the offset
+    /// @return false if interrupted or unable to read the file
+    bool get_file_range_histogram(const std::wstring& file_path, uintmax_t offset, uintmax_t length, ByteHistogram& histogram) const;
+
+    /// @brief Randomness statistics of the file range, the same way as get_file_range_histogram().
+    /// Statistics of all ranges are appended in the file order (see ContentStatistics::append()),
+    /// then classified by get_statistics_classification()
+    /// @return false if interrupted or unable to read the file
+    bool get_file_range_statistics(const std::wstring& file_path, uintmax_t offset, uintmax_t length, ContentStatistics& statistics) const;
+
+    /// @brief Classify statistics of the whole sequence the same way as get_file_classification()
+    static ContentClassification get_statistics_classification(const ContentStatistics& statistics);
+
     /// @brief Detect whether the bytes sequence (e.g. memory) is encrypted
     double get_sequence_entropy(const uint8_t* sequence_start, size_t sequence_size) const;
 
@@ -79,34 +227,89 @@ public:
     /// @brief Interrupt all calculating threads
     static void interrupt(bool interrupt_flag);
 
+    /// @brief True if io_uring is available, so that AsyncScan does not fall back to buffered reading
+    static bool is_async_scan_supported();
+
 private:
 
-    /// do not make it atomic so that avoid cache ping-pong
-    static bool interrupt_all_;
+    /// set by another thread while checks are running, read once per block by relaxed loads,
+    /// the cache line is shared until the flag changes
+    static std::atomic<bool> interrupt_all_;
 
     /// Callback function called on every n-th iteration to observe calculation progress
     IShredderCallback* callback_{};
 
-    /// Calculate probabilities to meet some byte in the file
-    std::vector<double> read_file_probabilities(const std::wstring& file_path, uintmax_t file_size) const;
+    /// Buffered or memory-mapped file scanning
+    FileScanMode scan_mode_ = BufferedScan;
+
+    /// Blocks in flight in AsyncScan mode
+    unsigned async_queue_depth_ = ASYNC_QUEUE_DEPTH;
+
+    /// Entropy map of the scanned file, optional
+    EntropyMap* entropy_map_{};
+
+    /// Cancellation of this checker scans, optional
+    std::shared_ptr<const CancellationToken> cancellation_token_;
+
+    /// Number of randomly placed blocks in the sampled estimation
+    size_t sample_blocks_count_ = SAMPLE_BLOCKS_COUNT;
+
+    /// Size of the block in the sampled estimation
+    size_t sample_block_size_ = SAMPLE_BLOCK_SIZE;
+
+    /// Number of blocks confirming the signature classification
+    size_t signature_confirmation_blocks_ = SIGNATURE_CONFIRMATION_BLOCKS;
+
+    /// Internal function passing the file range (the whole file from 0 to its size) to the counter
+    /// (ByteHistogram or ContentStatistics) using the current scan mode, callback is optional
+    /// @return false if interrupted or unable to read the file
+    template <typename BlockCounter>
+    bool file_probabilities(const std::wstring& file_path, uintmax_t offset, uintmax_t length, BlockCounter& counter) const;
+
+    /// Internal function for files read by buffers
+    template <typename BlockCounter>
+    bool file_probabilities_buffered(const std::wstring& file_path, uintmax_t offset, uintmax_t length, BlockCounter& counter) const;
+
+    /// Internal function for files mapped by windows
+    /// Falls back to buffered reading if the file could not be mapped
+    template <typename BlockCounter>
+    bool file_probabilities_mapped(const std::wstring& file_path, uintmax_t offset, uintmax_t length, BlockCounter& counter) const;
+
+    /// Internal function for files read asynchronously, ByteHistogram counts blocks in completion order,
+    /// other counters in the file order. Falls back to buffered reading if io_uring is unavailable
+    template <typename BlockCounter>
+    bool file_probabilities_async(const std::wstring& file_path, uintmax_t offset, uintmax_t length, BlockCounter& counter) const;
+
+    /// Internal function for generic sequences
+    template <typename BlockCounter>
+    bool stream_probabilities(const uint8_t* sequence_start, uintmax_t sequence_size, BlockCounter& counter) const;
+
+    /// Count all blocks of the source, reporting progress if callback is set
+    /// Without callback the progress sink is empty and compiled out
+    template <typename BlockSource, typename BlockCounter>
+    bool scan_blocks(BlockSource& source, uintmax_t total_size, BlockCounter& counter) const;
 
-    /// Internal probabilities function for files without observing the progress, which is slightly faster
-    std::vector<size_t> file_probabilities_fast(const std::wstring& file_path, uintmax_t file_size) const;
+    /// Block counting engine shared by all file and sequence scans
+    /// BlockSource::next_block() returns the next block (zero size at the end) or false on error,
+    /// BlockCounter::update() accounts the block, ProgressSink::update() is called once per block
+    template <typename BlockSource, typename BlockCounter, typename ProgressSink>
+    bool count_blocks(BlockSource& source, BlockCounter& counter, ProgressSink& progress) const;
 
-    /// Internal probabilities function for files with observing the progress with callback
-    /// callback pointer in this function must not be zero
-    std::vector<size_t> file_probabilities_observed(const std::wstring& file_path, uintmax_t file_size) const;
+    /// True if all scans are interrupted or the scan of this checker is cancelled
+    bool is_interrupted() const;
 
-    /// Calculate probabilities to meet some byte in the sequence
-    std::vector<double> read_stream_probabilities(const uint8_t* sequence_start, uintmax_t sequence_size) const;
+    /// Sample of get_sampled_file_entropy() of the file bigger than the sample,
+    /// statistics of the sample blocks are accounted if requested
+    EntropyEstimate sample_file_entropy(const std::wstring& file_path, ContentStatistics* statistics) const;
 
-    /// Internal probabilities function for generic sequences 
-    /// without observing the progress, which is slightly faster
-    std::vector<size_t> stream_probabilities_fast(const uint8_t* sequence_start, uintmax_t sequence_size) const;
+    /// Fill classification from statistics of the whole sequence
+    static void classify_statistics(const ContentStatistics& statistics, uintmax_t sequence_size, ContentClassification& classification);
 
-    /// Internal probabilities function for generic sequences with observing the progress with callback
-    /// callback pointer in this function must not be zero
-    std::vector<size_t> stream_probabilities_observed(const uint8_t* sequence_start, uintmax_t sequence_size) const;
+    /// Bias-corrected entropy of the merged groups and its jackknife confidence interval
+    static void jackknife_estimate(const std::vector<ByteHistogram>& groups, EntropyEstimate& estimate);
+
+    /// True if the confidence interval of the estimate lies inside one class
+    static bool classification_settled(const EntropyEstimate& estimate);
 
     /// Relate epsilon to checked file size
     /// Entropy of encrypted file very close to 8.0 (like 7.999998..)
@@ -120,8 +323,56 @@ private:
     /// Map information properties to string description
     static std::map<InformationEntropyEstimation, std::string> entropy_string_description_;
 
-    /// Buffer size, should not be close to 1 MB as created on a thread stack
-    static constexpr size_t MAX_BUFFER_SIZE = 1024 * 64;
+    /// File read block size, the buffer is allocated on the heap once per file
+    static constexpr size_t READ_BLOCK_SIZE = 1024 * 1024;
+
+    /// Files smaller than that are read by buffers even in MappedScan mode
+    static constexpr uintmax_t MIN_MAPPED_FILE_SIZE = 1024 * 1024 * 16;
+
+    /// Size of the mapped window, multiple of huge page size, bounds the address space per scan
+    static constexpr size_t MAP_WINDOW_SIZE = 1024 * 1024 * 128;
+
+    /// Default number of READ_BLOCK_SIZE blocks in flight in AsyncScan mode
+    static constexpr unsigned ASYNC_QUEUE_DEPTH = 8;
+
+    /// Progress is reported once per that part of the scan (percent)...
+    static constexpr uintmax_t PROGRESS_STEPS_COUNT = 100;
+
+    /// ...or once per that interval if the scan is slow, whichever comes first
+    static constexpr unsigned PROGRESS_INTERVAL_MS = 250;
+
+    /// Default sample is 64 Mb, so that bias-corrected entropy of ciphertext
+    /// is still closer to 8.0 than estimated_epsilon() of the biggest files
+    static constexpr size_t SAMPLE_BLOCKS_COUNT = 1024;
+    static constexpr size_t SAMPLE_BLOCK_SIZE = 1024 * 64;
+
+    /// Default sample confirming the container signature is 1 Mb
+    static constexpr size_t SIGNATURE_CONFIRMATION_BLOCKS = 16;
+
+    /// Sample blocks are aligned to the file system page
+    static constexpr size_t SAMPLE_BLOCK_ALIGNMENT = 4096;
+
+    /// Max deviation (z-score) of every randomness statistic of the ciphertext,
+    /// with four statistics random data is classified as compressed with probability about 2.5e-4
+    static constexpr double RANDOMNESS_MAX_Z = 4.0;
+
+    /// Two-sided 99% confidence interval of the sampled estimation
+    static constexpr double SAMPLE_CONFIDENCE_Z = 2.576;
+
+    /// Block of the incremental classification
+    static constexpr size_t CLASSIFY_BLOCK_SIZE = 1024 * 256;
+
+    /// Incremental classification never stops before reading that many bytes
+    static constexpr uintmax_t CLASSIFY_MIN_SIZE = 1024 * 1024 * 4;
+
+    /// Max bytes between two checks of the incremental classification
+    static constexpr uintmax_t CLASSIFY_MAX_CHECK_INTERVAL = 1024 * 1024 * 64;
+
+    /// Independent groups of blocks for the jackknife
+    static constexpr size_t CLASSIFY_GROUPS_COUNT = 64;
+
+    /// Max blocks of the incremental classification requested from the drive at once
+    static constexpr uintmax_t CLASSIFY_PREFETCH_BLOCKS = 64;
 };
 
 } // namespace encryption
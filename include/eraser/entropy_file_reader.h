@@ -0,0 +1,134 @@
+#pragma once
+#include <eraser/io_uring_queue.h>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <Windows.h>
+#endif
+
+namespace shredder {
+
+/// @brief Sequential read-only access to the file by big blocks, bypassing iostreams
+/// Reads straight from the native file handle (descriptor) into the caller's buffer
+/// Not thread-safe, one reader per thread
+class EntropyFileReader {
+public:
+
+    EntropyFileReader() = default;
+
+    EntropyFileReader(const EntropyFileReader&) = delete;
+    EntropyFileReader& operator=(const EntropyFileReader&) = delete;
+
+    /// @brief Close file if opened
+    ~EntropyFileReader();
+
+    /// @brief Open file for sequential reading. Does not throw
+    bool open(const std::wstring& file_path);
+
+    /// @brief Close native handle
+    void close();
+
+    /// @brief True if the native handle is valid
+    bool is_open() const;
+
+    /// @brief Read next block of the file
+    /// @param bytes_read: number of bytes actually read, 0 at the end of file
+    /// @return false on read error
+    bool read(uint8_t* buffer, size_t buffer_size, size_t& bytes_read);
+
+    /// @brief Read block at the given offset, does not move the sequential read position
+    /// @param bytes_read: number of bytes actually read, less than buffer_size at the end of file
+    /// @return false on read error
+    bool read_at(uintmax_t offset, uint8_t* buffer, size_t buffer_size, size_t& bytes_read);
+
+    /// @brief Advise random access, so that read-ahead does not read neighbours of scattered blocks
+    void advise_random();
+
+    /// @brief Start reading the range in background, so that following read_at() calls are served
+    /// from the cache. Scattered ranges requested together are read in the file order by the device queue
+    void prefetch(uintmax_t offset, size_t length);
+
+    /// @brief True if the opened file could be memory-mapped (regular file on Linux)
+    bool can_map() const;
+
+    /// @brief Map read-only window of the opened file and advise sequential access
+    /// @param offset: window offset, must be multiple of the page size
+    /// @return window start, nullptr if mapping failed
+    const uint8_t* map_window(uintmax_t offset, size_t window_size);
+
+    /// @brief Unmap window returned by map_window()
+    void unmap_window(const uint8_t* window_start, size_t window_size);
+
+    /// @brief Start asynchronous reading of the file range (the whole file by default) by io_uring (Linux),
+    /// so that next blocks are read while the current one is processed
+    /// @param block_size: size of every block
+    /// @param queue_depth: number of blocks in flight, every block has its own registered buffer
+    /// @param ordered: blocks are taken in the file order, blocks completed ahead of the next one wait for it
+    /// @return false if io_uring is unavailable or the file is not regular, use read() instead
+    bool start_async(size_t block_size, unsigned queue_depth, uintmax_t offset = 0, uintmax_t length = UINTMAX_MAX,
+                     bool ordered = false);
+
+    /// @brief Take the next completed block, blocks come in completion order unless started ordered.
+    /// Block memory stays valid until the next call, then its buffer is queued for reading again
+    /// @param block_size: 0 at the end of file
+    /// @return false on read error
+    bool next_async_block(const uint8_t*& block_start, size_t& block_size);
+
+private:
+
+    /// Queue reading of the next file block into the free buffer
+    bool queue_async_block(size_t slot);
+
+    /// Wait for all reads in flight and release the queue
+    void stop_async();
+
+    /// Block of the asynchronous read
+    struct AsyncBlock
+    {
+        /// Block offset in the file
+        uintmax_t offset = 0;
+
+        /// Expected block size
+        size_t size = 0;
+
+        /// Bytes already read, short reads are resubmitted
+        size_t filled = 0;
+
+        /// Read is completed, the block waits for the preceding ones in the ordered reading
+        bool completed = false;
+    };
+
+    // io_uring queue, exists only while the asynchronous read is active
+    std::unique_ptr<IoUringQueue> async_queue_;
+
+    // One buffer of async_block_size_ for every queue entry
+    std::vector<uint8_t> async_buffer_;
+    std::vector<AsyncBlock> async_blocks_;
+    size_t async_block_size_ = 0;
+
+    // Offset of the next block to queue and end of the range, not beyond the file size at the start of reading
+    uintmax_t async_offset_ = 0;
+    uintmax_t async_end_ = 0;
+
+    // Buffer returned by the last next_async_block(), -1 if none
+    int async_held_ = -1;
+
+    // Blocks are taken in the file order, the offset of the next one
+    bool async_ordered_ = false;
+    uintmax_t async_next_offset_ = 0;
+
+#if defined(_WIN32) || defined(_WIN64)
+    // Windows file handle
+    HANDLE file_handle_ = INVALID_HANDLE_VALUE;
+#else
+    // POSIX file descriptor
+    int file_descriptor_ = -1;
+#endif
+};
+
+} // namespace shredder
@@ -0,0 +1,63 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace shredder {
+
+/// @brief Entropy of every fixed-size region of the file, built in the same scan as the file entropy
+/// Every value is quantized to one byte (resolution 8/255), so that the map of 1 Tb file
+/// with 1 Mb regions takes 1 Mb. Used to overwrite plain regions of mixed-content files fully,
+/// and high-entropy regions sparsely
+class EntropyMap {
+public:
+
+    /// Default region size
+    static constexpr uint64_t DEFAULT_REGION_SIZE = 1024 * 1024;
+
+    /// @brief Empty map
+    explicit EntropyMap(uint64_t region_size = DEFAULT_REGION_SIZE);
+
+    /// @brief Satisfy compiler
+    ~EntropyMap() = default;
+
+    /// @brief Append entropy of the next region
+    void push_back(double entropy);
+
+    /// @brief Append regions of the map of the next part of the file, e.g. the next range of the split scan
+    /// Every region of this map must be complete, region sizes must be the same
+    void append(const EntropyMap& next);
+
+    /// @brief Remove all regions
+    void clear();
+
+    /// @brief True if no regions
+    bool empty() const { return regions_.empty(); }
+
+    /// @brief Number of regions, the last one may be shorter than the region size
+    size_t regions_count() const { return regions_.size(); }
+
+    /// @brief Region size in bytes
+    uint64_t region_size() const { return region_size_; }
+
+    /// @brief Quantized entropy of the region, from 0.0 to 8.0
+    double entropy(size_t region) const;
+
+    /// @brief Hexadecimal representation to be stored in the database
+    std::string to_hex() const;
+
+    /// @brief Read hexadecimal representation of the map with the given region size
+    /// @return false if the string is malformed
+    static bool from_hex(const std::string& hex, uint64_t region_size, EntropyMap& entropy_map);
+
+private:
+
+    /// Size of every region in bytes
+    uint64_t region_size_;
+
+    /// Quantized entropy of every region
+    std::vector<uint8_t> regions_;
+};
+
+} // namespace shredder
@@ -0,0 +1,29 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+
+namespace shredder {
+
+/// @brief Byte range of the file to overwrite
+struct EraseRange
+{
+    uint64_t offset = 0;
+    uint64_t length = 0;
+
+    /// @brief First byte after the range
+    uint64_t end() const { return offset + length; }
+};
+
+/// @brief Sort ranges by offset, merge overlapping and adjacent ones, drop empty ones,
+/// so that every distinct extent is written by one call
+void coalesce_ranges(std::vector<EraseRange>& ranges);
+
+/// @brief Append parts of the range covered by extents to the result
+/// @param extents: sorted, not overlapping (e.g. coalesced) ranges
+void intersect_range(const std::vector<EraseRange>& extents, const EraseRange& range, std::vector<EraseRange>& result);
+
+/// @brief True if the offset is inside one of extents
+/// @param extents: sorted, not overlapping (e.g. coalesced) ranges
+bool contains_offset(const std::vector<EraseRange>& extents, uint64_t offset);
+
+} // namespace shredder
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+
+namespace shredder {
+
+/// @brief Progress of the file in the erase job journal, so that the job interrupted by the process exit
+/// resumes where it stopped instead of overwriting the file from the beginning
+struct ErasureCheckpoint
+{
+    /// Overwrite pass in progress
+    unsigned pass = 0;
+
+    /// Bytes from the beginning of the file overwritten by the pass and flushed to the drive
+    uint64_t offset = 0;
+
+    /// All passes are on the drive, only the file node is left to remove
+    bool overwritten = false;
+
+    /// Hash of the bytes just before offset, or of the file beginning if overwritten, read back when
+    /// the checkpoint is saved. The row is trusted only if the file still has them
+    uint64_t probe = 0;
+
+    /// Maximum number of bytes hashed by the probe
+    static constexpr uint64_t PROBE_SIZE = 4096;
+};
+
+} // namespace shredder
@@ -0,0 +1,77 @@
+#pragma once
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+namespace shredder {
+
+/// @brief Overwrite passes of the erasure and their patterns. Patterns are generated once per job from its seed,
+/// the scheme is shared read-only by all drives, files and threads of the job
+class ErasureScheme {
+public:
+
+    enum class Type {
+
+        /// One random pass
+        SinglePass,
+
+        /// Zeros, ones, random
+        ZeroOneRandom,
+
+        /// Character, its complement, random (DoD 5220.22-M)
+        DoD5220_22M,
+
+        /// Configurable number of random passes
+        RandomPasses
+    };
+
+    /// Length of every pattern, the same as the length of the random sequence
+    static constexpr size_t PATTERN_LENGTH = 0xFFFF;
+
+    /// Maximum number of passes
+    static constexpr unsigned MAX_PASSES = 35;
+
+    /// @brief Generate patterns of all passes
+    /// @param passes_count: number of passes of RandomPasses, ignored by other schemes
+    explicit ErasureScheme(Type type = Type::SinglePass, unsigned passes_count = 1);
+
+    /// @brief Generate the same patterns as the scheme with the seed, e.g. patterns of the interrupted job
+    ErasureScheme(Type type, unsigned passes_count, uint32_t seed);
+
+    /// @brief Satisfy compiler
+    ~ErasureScheme() = default;
+
+    ErasureScheme(const ErasureScheme&) = delete;
+    ErasureScheme& operator=(const ErasureScheme&) = delete;
+
+    /// @brief Scheme type
+    Type type() const { return type_; }
+
+    /// @brief Number of passes
+    unsigned passes_count() const { return passes_count_; }
+
+    /// @brief Pattern of the pass, repeated over the overwritten range. Never modified by erasers
+    uint8_t* pattern(unsigned pass) const;
+
+    /// @brief Length of every pattern
+    size_t pattern_length() const { return PATTERN_LENGTH; }
+
+    /// @brief Seed of the patterns, saved with the erase job journal
+    uint32_t seed() const { return seed_; }
+
+private:
+
+    /// Scheme type
+    Type type_ = Type::SinglePass;
+
+    /// Number of passes
+    unsigned passes_count_ = 1;
+
+    /// Seed of the pattern generator
+    uint32_t seed_ = 0;
+
+    /// Patterns of all passes one after another
+    std::unique_ptr<uint8_t[]> patterns_;
+};
+
+} // namespace shredder
@@ -1,4 +1,6 @@
 #pragma once
+#include <eraser/durability_policy.h>
+#include <eraser/erasure_scheme.h>
 #include <eraser/shredder_callback_interface.h>
 #include <eraser/shredder_datatbase.h>
 #include <eraser/shredder_file_info.h>
@@ -10,6 +12,9 @@
 #include <vector>
 #include <string>
 #include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <map>
 
 namespace encryption {
 class ShannonEncryptionChecker;
@@ -25,6 +30,8 @@ namespace shredder {
 
 class ShredderCache;
 class ShredderDatabaseWrapper;
+class CancellationToken;
+class ShannonEncryptionChecker;
 
 /// @brief
 struct FileShredderSettings
@@ -37,6 +44,89 @@ struct FileShredderSettings
 
     /// Erase NTFS file journal
     static bool ntfs_erase;
+
+    /// Scan big files for entropy by memory-mapped windows (Linux only)
+    static bool mapped_entropy_scan;
+
+    /// Keep entropy scan reads in flight by io_uring (Linux only), preferred over mapped_entropy_scan if io_uring is available
+    static bool async_entropy_scan;
+
+    /// Number of blocks in flight for async_entropy_scan
+    static unsigned entropy_queue_depth;
+
+    /// Keep entropy of scanned files by (device, inode, size, mtime, ctime),
+    /// so that unchanged files are never scanned again
+    static bool persistent_entropy_cache;
+
+    /// Scanned files (completely, by ranges or by a sample) are also checked by chi-square, mean, serial correlation
+    /// and Monte Carlo pi, so that compressed files are not erased as encrypted ones. Slows down the CPU part of the scan.
+    /// Off by default
+    static bool statistical_classification;
+
+    /// Files bigger than that (bytes) get entropy estimated from a sample of blocks, 0 (default) to read all files completely
+    static uintmax_t sampled_entropy_threshold;
+
+    /// Stop entropy scan as soon as the file class is settled, stored entropy becomes an estimate
+    static bool early_entropy_classification;
+
+    /// Files bigger than that (bytes) are split into ranges, scanned by several calculation workers at once,
+    /// 0 (default) to scan every file by one worker
+    static uintmax_t parallel_entropy_threshold;
+
+    /// Scanned files (completely, by ranges or by a sample) also get entropy of every region of that size (bytes),
+    /// so that smart erasure overwrites plain regions fully and high-entropy regions sparsely, 0 (default) to disable
+    static uintmax_t entropy_map_region_size;
+
+    /// Archives, media and encrypted containers are classified by the signature of their leading bytes,
+    /// without the entropy scan. Off by default
+    static bool signature_classification;
+
+    /// Number of 64 Kb blocks sampled to confirm the signature, 0 to trust strong signatures
+    static size_t signature_confirmation_blocks;
+
+    /// Overwrite files by direct I/O from aligned buffers, bypassing the page cache (POSIX only).
+    /// Keeps the working set of other processes in memory while big files are erased
+    static bool direct_io_erase;
+
+    /// Back direct I/O buffers by huge pages if available
+    static bool direct_io_huge_pages;
+
+    /// Keep many writes in flight by io_uring (Linux only), across chunks and files of one drive.
+    /// Files are synced and unlinked by linked operations
+    static bool async_erase;
+
+    /// Number of writes in flight for async_erase, per drive
+    static unsigned erase_queue_depth;
+
+    /// When overwritten data is forced to the drive: every write, every file, or once per filesystem
+    /// after all its files are overwritten (group commit), file nodes are removed after that
+    static DurabilityPolicy durability_policy;
+
+    /// Files on SSD drives erased by the Smart method get only header and footer overwritten,
+    /// the rest of their blocks is released by punching a hole (deallocated sparse range on Windows)
+    static bool discard_erase;
+
+    /// Discard blocks released by discarded files after the drive is erased (FITRIM, Linux only, needs CAP_SYS_ADMIN),
+    /// bounded to the released ranges, so free space of the rest of the filesystem is not trimmed
+    static bool discard_trim;
+
+    /// Overwrite passes of every file (single random pass, zero/one/random, DoD 5220.22-M, N random passes),
+    /// patterns are generated once per erasure job
+    static ErasureScheme::Type erasure_scheme;
+
+    /// Number of passes of ErasureScheme::Type::RandomPasses
+    static unsigned erasure_passes;
+
+    /// Read every overwritten file back by direct I/O and compare with the last pass pattern (POSIX only).
+    /// The file is flushed before its node is removed, verification overlaps overwriting of the next file
+    static bool verify_erase;
+
+    /// Journal progress of the erasure job in the database: files overwritten before the group commit
+    /// and offsets of full overwrite, so that the job interrupted by the process exit resumes where it stopped
+    static bool resumable_erase;
+
+    /// Full overwrite of the file is flushed and its offset is journaled every that many bytes
+    static uintmax_t erase_checkpoint_interval;
 };
 
 static FileShredderSettings default_settings;
@@ -63,6 +153,42 @@ public:
     /// @brief Erase NTFS file journal
     static bool is_ntfs_erase();
 
+    /// @brief Overwrite files by direct I/O
+    static bool is_direct_io_erase();
+
+    /// @brief Back direct I/O buffers by huge pages
+    static bool is_direct_io_huge_pages();
+
+    /// @brief Keep many writes in flight by io_uring
+    static bool is_async_erase();
+
+    /// @brief Number of writes in flight per drive
+    static unsigned erase_queue_depth();
+
+    /// @brief When overwritten data is forced to the drive
+    static DurabilityPolicy durability_policy();
+
+    /// @brief Release blocks of files on SSD drives instead of overwriting them
+    static bool is_discard_erase();
+
+    /// @brief Discard free blocks of the filesystem after files are discarded
+    static bool is_discard_trim();
+
+    /// @brief Overwrite passes of every file
+    static ErasureScheme::Type erasure_scheme();
+
+    /// @brief Number of random passes
+    static unsigned erasure_passes();
+
+    /// @brief Read overwritten files back
+    static bool is_verify_erase();
+
+    /// @brief Journal progress of the erasure job
+    static bool is_resumable_erase();
+
+    /// @brief Bytes of full overwrite between journaled checkpoints
+    static uintmax_t erase_checkpoint_interval();
+
     /// @brief Submit file path for erasure
     /// @param file_path: Unicode path
     /// @param system_added: true if added by application, false is explicitly by the user
@@ -71,10 +197,14 @@ public:
     /// @return: true if success, false otherwise
     bool submit(const std::wstring& file_path, bool system_added, bool no_insert = false, IShredderCallback* callback = nullptr);
 
-    /// @brief Remove file path from erasure list
+    /// @brief Remove file path from erasure list, entropy check of the file is cancelled
     /// @return: true if success, false otherwise
     bool remove(const std::wstring& file_path);
 
+    /// @brief Cancel entropy check of one submitted file, other checks go on
+    /// @return: true if the check was pending or running
+    bool cancel_check(const std::wstring& file_path);
+
     /// @brief Cleanup user-added 
     /// @return: true if success, false otherwise
     bool clean_user_files();
@@ -83,11 +213,15 @@ public:
     /// @return: true if success, false otherwise
     bool clean();
 
-    /// @brief Erase files
-    void erase_files();
+    /// @brief Erase files, once running entropy checks have stopped
+    /// @return paths of erased files whose overwrite is not proven by the read-back verification,
+    /// empty if every file is verified or verification is off
+    std::vector<std::wstring> erase_files();
 
-    /// @brief Interrupt all encryption checks and empty the tasks queue
-    void interrupt_checks();
+    /// @brief Cancel all encryption checks, empty the tasks queue
+    /// and wait until running checks stop, but not longer than CANCELLATION_TIMEOUT_MS
+    /// @return: true if all checks stopped in time
+    bool interrupt_checks();
 
     /// @brief Read from database table to shredder
     bool read_table(std::vector<ShredderFileInfo>& ret_table);
@@ -115,11 +249,43 @@ private:
     /// param hash:
     /// param file_path:
     /// param callback:
-    void update_entropy(std::string hash, std::wstring file_path, IShredderCallback* callback);
+    void update_entropy(std::string hash, std::wstring file_path, IShredderCallback* callback,
+        std::shared_ptr<CancellationToken> cancellation_token);
+
+    /// @brief Histogram or statistics of one file split between calculation workers
+    struct RangeEntropyJob;
+
+    /// @brief Split the big file into ranges for idle workers, the first range is counted by the calling worker
+    /// @return false if the file is too small to be split, nothing is started then
+    bool split_entropy_check(const std::string& hash, const std::wstring& file_path, uintmax_t file_size,
+        const ShredderFileIdentity& identity, IShredderCallback* callback, const std::shared_ptr<CancellationToken>& cancellation_token);
+
+    /// @brief Count one range of the split file, the worker finishing the last range stores entropy.
+    /// Workers never wait for each other, so the pool can not deadlock
+    void update_entropy_range(std::shared_ptr<RangeEntropyJob> job, uintmax_t offset, uintmax_t length);
+
+    /// @brief Set the scan mode of the settings, the same for whole files and ranges
+    static void set_scan_mode(ShannonEncryptionChecker& checker);
+
+    /// @brief Forget cancellation token of the finished check, unless the file has been resubmitted
+    void finish_check(const std::string& hash, const std::shared_ptr<CancellationToken>& cancellation_token);
+
+    /// @brief Save calculated entropy to the database, finish observing the progress
+    /// If the identity is valid and the file has not changed since, entropy is also saved to the entropy cache
+    /// param compressed: high entropy of the file is not ciphertext, see ShannonEncryptionChecker::ContentClassification
+    /// param entropy_map: saved with the entropy, along with the cache entry, unless empty
+    void store_entropy(const std::string& hash, const std::wstring& file_path, double entropy, bool compressed,
+        const EntropyMap& entropy_map, const ShredderFileIdentity& identity, IShredderCallback* callback);
 
     /// @brief Reset cache
     void reset_cache();
 
+    /// @brief Counts running check while alive, so that interrupt_checks() could wait for it
+    class RunningCheck;
+
+    /// @brief Wait until running checks stop, without time limit
+    void wait_checks();
+
     //////////////////////////////////////////////////////////////////////////
 
     /// Lock complete re-read operation and reset cache
@@ -134,11 +300,98 @@ private:
     /// Thread pool created only for entropy calculation (interrupted upon panic)
     helpers::thread_pool calculation_pool;
 
+    /// Lock checks registry
+    std::mutex checks_lock_;
+
+    /// Notified every time a running check finishes
+    std::condition_variable checks_finished_;
+
+    /// Cancellation token of every pending or running check, by path hash
+    std::map<std::string, std::shared_ptr<CancellationToken>> check_tokens_;
+
+    /// Number of checks running this moment (split file counts once per range)
+    size_t running_checks_ = 0;
+
     /// Use all possible cores for file erase
     static bool multithreaded_erase_;
 
     /// Erase NTFS file journal
     static bool ntfs_erase_;
+
+    /// Scan big files for entropy by memory-mapped windows
+    static bool mapped_entropy_scan_;
+
+    /// Scan entropy with reads in flight
+    static bool async_entropy_scan_;
+
+    /// Blocks in flight of the asynchronous scan
+    static unsigned entropy_queue_depth_;
+
+    /// Look up and save entropy of unchanged files
+    static bool persistent_entropy_cache_;
+
+    /// Classify completely scanned files by randomness statistics
+    static bool statistical_classification_;
+
+    /// Estimate entropy of files bigger than that from a sample
+    static uintmax_t sampled_entropy_threshold_;
+
+    /// Stop entropy scan as soon as the file class is settled
+    static bool early_entropy_classification_;
+
+    /// Split files bigger than that between calculation workers
+    static uintmax_t parallel_entropy_threshold_;
+
+    /// Size of the entropy map region of completely scanned files, 0 if disabled
+    static uintmax_t entropy_map_region_size_;
+
+    /// Classify known containers by signature
+    static bool signature_classification_;
+
+    /// Sample confirming the signature
+    static size_t signature_confirmation_blocks_;
+
+    /// Overwrite files bypassing the page cache
+    static bool direct_io_erase_;
+
+    /// Huge pages for direct I/O buffers
+    static bool direct_io_huge_pages_;
+
+    /// Erase files by io_uring
+    static bool async_erase_;
+
+    /// Writes in flight of the asynchronous erasure
+    static unsigned erase_queue_depth_;
+
+    /// Sync written data per write, per file or per filesystem
+    static DurabilityPolicy durability_policy_;
+
+    /// Punch holes in files on SSD drives
+    static bool discard_erase_;
+
+    /// Trim filesystems after discard
+    static bool discard_trim_;
+
+    /// Multi-pass erasure scheme
+    static ErasureScheme::Type erasure_scheme_;
+
+    /// Passes of the random multi-pass scheme
+    static unsigned erasure_passes_;
+
+    /// Verify overwritten files
+    static bool verify_erase_;
+
+    /// Journal progress of the erasure job
+    static bool resumable_erase_;
+
+    /// Bytes between checkpoints of full overwrite
+    static uintmax_t erase_checkpoint_interval_;
+
+    /// Max time interrupt_checks() waits for running checks, every check stops within one read block
+    static constexpr unsigned CANCELLATION_TIMEOUT_MS = 2000;
+
+    /// Ranges of the split file are at least that big
+    static constexpr uintmax_t MIN_ENTROPY_RANGE_SIZE = 1024 * 1024 * 64;
 };
 
 } // namespace shredder
@@ -0,0 +1,50 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace shredder {
+
+/// Number of interleaved partial tables filled by every kernel
+constexpr size_t HISTOGRAM_TABLES_COUNT = 4;
+
+/// Interleaved 32-bit partial counters, the caller sums them up
+using HistogramTables = uint32_t[HISTOGRAM_TABLES_COUNT][256];
+
+/// @brief Count bytes of the block into partial tables
+/// Caller is responsible for the block size, so that 32-bit counters do not overflow
+using HistogramKernel = void (*)(const uint8_t* block_start, size_t block_size, HistogramTables& tables);
+
+/// @brief Named histogram kernel
+struct HistogramKernelInfo
+{
+    const char* name;
+    HistogramKernel kernel;
+};
+
+/// Bytes at the start of the block compared by starts_with_run()
+constexpr size_t RUN_PROBE_SIZE = 32;
+
+/// @brief All kernels supported by the current CPU, scalar kernel is always the first,
+/// followed by SSE4.2/AVX2/AVX-512 run-skipping variants. The variants count a register made of one byte
+/// by a single add and fall back to the scalar counting of its words otherwise, so they are much faster
+/// on zero-filled and sparse regions, but slower than the scalar kernel on random data
+std::vector<HistogramKernelInfo> supported_histogram_kernels();
+
+/// @brief The kernel for data of any kind, the scalar one, chosen once.
+/// Byte histograms do not vectorize by compares, scattered increments of interleaved tables are the fastest
+const HistogramKernelInfo& best_histogram_kernel();
+
+/// @brief The widest run-skipping variant supported by the current CPU (chosen once from cpuid),
+/// the scalar kernel if there is none
+const HistogramKernelInfo& best_runs_histogram_kernel();
+
+/// @brief True if the first RUN_PROBE_SIZE bytes of the block are the same, the block is likely a run
+bool starts_with_run(const uint8_t* block_start, size_t block_size);
+
+/// @brief Shannon entropy in bits per byte straight from byte counters
+/// Same result as shannon_entropy() over probabilities, but without per-bin division
+/// @return value from 0.0 (absolute order) to 8.0 (absolute chaos), 0.0 for empty histogram
+double histogram_entropy(const uint64_t* counters, size_t bins_count, uintmax_t total);
+
+} // namespace shredder
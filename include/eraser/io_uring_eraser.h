@@ -0,0 +1,149 @@
+#if defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdint>
+#include <cstddef>
+#include <eraser/aligned_buffer_pool.h>
+#include <eraser/io_uring_queue.h>
+
+namespace shredder {
+
+/// @brief Overwrite engine keeping many writes in flight, across chunks of one file and across files (Linux io_uring).
+/// One engine per drive, so that the drive queue depth is configured once.
+/// NativeFileEraser queues writes of the file and hands its descriptors over on close, the engine syncs the file
+/// and unlinks it by the linked fdatasync -> unlinkat operations, then closes descriptors.
+/// If init() fails, erasers should use synchronous writes. Not thread-safe
+class IoUringEraser {
+public:
+
+    /// Default number of writes in flight
+    static constexpr unsigned DEFAULT_QUEUE_DEPTH = 32;
+
+    /// Default size of one write
+    static constexpr size_t DEFAULT_BLOCK_SIZE = 1024 * 1024;
+
+    IoUringEraser() = default;
+
+    IoUringEraser(const IoUringEraser&) = delete;
+    IoUringEraser& operator=(const IoUringEraser&) = delete;
+
+    /// @brief Wait for all files, close their descriptors
+    ~IoUringEraser();
+
+    /// @brief Create the queue and the pattern buffer
+    /// @param huge_pages: back the pattern buffer by huge pages if available
+    /// @return false if io_uring is not available
+    bool init(unsigned queue_depth = DEFAULT_QUEUE_DEPTH, size_t block_size = DEFAULT_BLOCK_SIZE, bool huge_pages = false);
+
+    /// @brief True if writes could be queued
+    bool is_ready() const { return queue_.is_ready(); }
+
+    /// @brief Queue write of the buffer, the buffer should stay valid until the file is finished
+    /// @param main_fd: main descriptor of the file if fd is its O_DIRECT descriptor, -1 otherwise.
+    /// Writes refused by the direct descriptor are retried by the main one
+    bool write(int fd, uint64_t offset, const uint8_t* buffer, size_t length, int main_fd = -1);
+
+    /// @brief Queue overwrite of the range by the repeated mask in big blocks,
+    /// blocks are page-aligned and suitable for O_DIRECT descriptors
+    bool write_pattern(int fd, uint64_t offset, uint64_t length, const uint8_t* mask, size_t mask_length, int main_fd = -1);
+
+    /// @brief Take descriptors of the file over. As soon as its writes complete, the file is synced and,
+    /// if unlink_path is not empty, unlinked. Descriptors are closed by the engine
+    /// @param direct_fd: the second descriptor of the file, -1 if none
+    /// @param sync: fdatasync the file before unlink, false if it is written through or synced by the caller
+    bool finish_file(int fd, int direct_fd, const std::string& unlink_path, bool sync = true);
+
+    /// @brief Wait until queued writes of the file complete, so that buffered and direct writes
+    /// of the same pages never race (the kernel fails page cache invalidation otherwise)
+    bool wait_file(int fd);
+
+    /// @brief Wait until all queued writes complete and all finished files are closed
+    /// @return false if any operation has failed since the last call
+    bool wait_all();
+
+    /// @brief Size of pattern writes, the mask restarts every block
+    size_t block_size() const { return pattern_.buffer_size(); }
+
+    /// @brief Number of failed operations since the last wait_all()
+    size_t failed_operations() const { return failed_operations_; }
+
+private:
+
+    /// Operation in flight
+    struct Operation
+    {
+        enum Type { Write, Sync, Unlink };
+
+        Type type = Write;
+        int fd = -1;
+        int file_fd = -1;
+        const uint8_t* buffer = nullptr;
+        size_t length = 0;
+        uint64_t offset = 0;
+        bool fixed = false;
+    };
+
+    /// File with writes in flight
+    struct FileState
+    {
+        int direct_fd = -1;
+        unsigned writes_in_flight = 0;
+        bool finished = false;
+        bool sync = true;
+        std::string unlink_path;
+    };
+
+    /// Queue one write, wait for a free slot if all are busy
+    bool queue_write(const Operation& operation);
+
+    /// Put operation into the submission queue, the slot is already reserved
+    bool prepare(const Operation& operation, unsigned slot);
+
+    /// Queue fdatasync -> unlinkat (or only one of them) of files with completed writes while there are free slots
+    void queue_finished_files();
+
+    /// Take a free slot, handle completions until any slot is free
+    bool reserve_slot(unsigned& slot);
+
+    /// Submit queued operations and handle at least one completion
+    bool handle_completions();
+
+    /// Handle result of the operation
+    void complete(unsigned slot, int32_t result);
+
+    /// Close descriptors of the file, forget it
+    void close_file(int fd);
+
+private:
+
+    // Submission and completion queues
+    IoUringQueue queue_;
+
+    // Block filled by the repeated mask, registered as the fixed buffer
+    AlignedBufferPool pattern_;
+
+    // Mask the pattern is filled with
+    const uint8_t* pattern_mask_ = nullptr;
+    size_t pattern_mask_length_ = 0;
+
+    // Operations by slot, slot is user_data of the submission
+    std::vector<Operation> operations_;
+
+    // Free slots
+    std::vector<unsigned> free_slots_;
+
+    // Files with writes in flight or not yet closed, by the main descriptor
+    std::map<int, FileState> files_;
+
+    // Finished files with completed writes, waiting for free slots to be synced
+    std::vector<int> finished_files_;
+
+    // Failed operations since the last wait_all()
+    size_t failed_operations_ = 0;
+};
+
+} // namespace shredder
+
+#endif // defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
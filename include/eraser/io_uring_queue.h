@@ -0,0 +1,134 @@
+#pragma once
+#include <deque>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace shredder {
+
+/// @brief Result of one asynchronous operation
+struct IoUringCompletion
+{
+    /// Value passed on submission
+    uint64_t user_data = 0;
+
+    /// Bytes transferred or negative errno
+    int32_t result = 0;
+};
+
+/// @brief Minimal io_uring submission/completion queue on raw system calls (Linux)
+/// Available when the project is built with ERASER_HAS_IO_URING and the kernel supports io_uring,
+/// otherwise init() returns false and the caller should use synchronous I/O.
+/// Not thread-safe, one queue per thread
+class IoUringQueue {
+public:
+
+    IoUringQueue() = default;
+
+    IoUringQueue(const IoUringQueue&) = delete;
+    IoUringQueue& operator=(const IoUringQueue&) = delete;
+
+    /// @brief Unmap rings and close the queue
+    ~IoUringQueue();
+
+    /// @brief Create the queue with the given number of submission entries. Does not throw
+    bool init(unsigned queue_depth);
+
+    /// @brief True if the queue has been created
+    bool is_ready() const { return ring_fd_ >= 0; }
+
+    /// @brief Number of submission entries
+    unsigned queue_depth() const { return sq_entries_; }
+
+    /// @brief Register buffers for *_fixed operations, buffer index is the position in the vector
+    bool register_buffers(const std::vector<std::pair<void*, size_t>>& buffers);
+
+    /// @brief Queue read into the registered buffer
+    bool prepare_read_fixed(int fd, void* buffer, unsigned length, uint64_t offset, unsigned buffer_index, uint64_t user_data);
+
+    /// @brief Queue read into any buffer
+    bool prepare_read(int fd, void* buffer, unsigned length, uint64_t offset, uint64_t user_data);
+
+    /// @brief Queue write from the registered buffer
+    bool prepare_write_fixed(int fd, const void* buffer, unsigned length, uint64_t offset, unsigned buffer_index, uint64_t user_data);
+
+    /// @brief Queue write from any buffer
+    bool prepare_write(int fd, const void* buffer, unsigned length, uint64_t offset, uint64_t user_data);
+
+    /// @brief Queue fsync, or fdatasync if data_only
+    bool prepare_fsync(int fd, bool data_only, uint64_t user_data);
+
+    /// @brief Queue unlink of the path, the path should stay valid until completion
+    bool prepare_unlink(const char* path, uint64_t user_data);
+
+    /// @brief Link the last queued operation with the next one, so that the next one starts
+    /// after the last one succeeds, and is cancelled otherwise (-ECANCELED)
+    bool link_last();
+
+    /// @brief Submit queued operations to the kernel, until the kernel consumes all of them
+    /// @param wait_count: wait for that many completions
+    /// @return false on submission error
+    bool submit(unsigned wait_count = 0);
+
+    /// @brief Take one completion if available, does not block
+    bool peek_completion(IoUringCompletion& completion);
+
+    /// @brief Take one completion, block until it is available
+    bool wait_completion(IoUringCompletion& completion);
+
+    /// @brief Operations submitted or queued, but not completed yet
+    unsigned in_flight() const { return in_flight_; }
+
+private:
+
+    /// Next free submission entry, nullptr if the ring is full
+    void* next_sqe();
+
+    /// Move completions from the ring to reaped_, so that the kernel can accept more entries.
+    /// Waits for one completion if the ring is empty
+    bool reap_completions();
+
+    /// Unmap rings, close descriptor
+    void close();
+
+private:
+
+    // io_uring descriptor
+    int ring_fd_ = -1;
+
+    // Submission and completion ring mappings
+    void* sq_ring_ = nullptr;
+    size_t sq_ring_size_ = 0;
+    void* cq_ring_ = nullptr;
+    size_t cq_ring_size_ = 0;
+    void* sqes_ = nullptr;
+    size_t sqes_size_ = 0;
+
+    // Pointers inside ring mappings, shared with the kernel
+    unsigned* sq_head_ = nullptr;
+    unsigned* sq_tail_ = nullptr;
+    unsigned* sq_array_ = nullptr;
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    void* cqes_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned cq_mask_ = 0;
+    unsigned sq_entries_ = 0;
+
+    // Local tail of queued, but not yet submitted entries
+    unsigned sqe_tail_ = 0;
+
+    // The last queued entry, nullptr if already submitted
+    void* last_sqe_ = nullptr;
+
+    // Operations without completion returned to the caller
+    unsigned in_flight_ = 0;
+
+    // Completions taken from the ring while submitting, not returned to the caller yet
+    std::deque<IoUringCompletion> reaped_;
+
+    // True if buffers have been registered
+    bool buffers_registered_ = false;
+};
+
+} // namespace shredder
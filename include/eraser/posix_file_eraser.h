@@ -2,100 +2,292 @@
 #pragma once
 #include <string>
 #include <random>
-#include <Windows.h>
+#include <memory>
+#include <vector>
+#include <functional>
+#include <cstdint>
+#include <eraser/aligned_buffer_pool.h>
+#include <eraser/durability_policy.h>
+#include <eraser/encryption_checker.h>
+#include <eraser/entropy_map.h>
+#include <eraser/erase_range.h>
+#include <eraser/readback_verifier.h>
+#include <winapi-helpers/partition_information.h>
 
-namespace boost{
-namespace filesystem {
-class path;
-}
-}
+namespace shredder {
 
+class IoUringEraser;
 
+/// @brief Wrapper for whole or partial (smart) erase of the file under POSIX systems
+/// Mirrors the Windows NativeFileEraser, writes by pwrite() with 64-bit offsets in big blocks
+/// Single file eraser is not thread-safe, strongly advice using it in a single thread
 class NativeFileEraser {
 
-    enum class ErasureMethod {
-        Strong,
-        Weak,
-        Random,
-        BeginEnd
-    };
+public:
 
-    enum class FileSpecific {
-        Plain,
-        Binary,
-        Encrypted,
-        Unknown
-    };
+    using EntropyEstimation = shredder::ShannonEncryptionChecker::InformationEntropyEstimation;
+    using DiskType = helpers::PartititonInformation::DiskType;
 
-public:
+    /// Default size of one write in erase_full()
+    static constexpr size_t DEFAULT_BLOCK_SIZE = 1024 * 1024;
+
+    NativeFileEraser(const NativeFileEraser&) = delete;
+    NativeFileEraser& operator=(const NativeFileEraser&) = delete;
+
+    /// @brief Open file for write only
+    // @param estimation: means encryption level.
+    /// If plain - strong erasure methods applied,
+    /// If encrypted - smart erasure methods
+    /// @param disk_type: SSD or HDD, optimization of erasure process
+    /// @param durability: when written data is forced to the drive, with GroupCommit the caller
+    /// should sync_filesystem() before the file node is removed
+    NativeFileEraser(const std::wstring& filename, EntropyEstimation estimation, DiskType disk_type,
+                     DurabilityPolicy durability = DurabilityPolicy::PerFile);
 
-    NativeFileEraser() = default;
+    // erase, close
+    ~NativeFileEraser();
 
-    // call open
-    // if plain - strong erasure methods
-    // if encrypted - restrict erasure methods
-    NativeFileEraser(const std::wstring& filename, FileSpecific attributes = FileSpecific::Unknown);
+    /// @brief No filesystem journal is cleaned on POSIX systems, for compatibility with Windows eraser
+    static bool clean_ntfs_journal(const std::wstring& drive_root);
 
-    // @brief erase, close (change attributes)
-    ~NativeFileEraser() = default;
+    /// @brief Flush all cached writes of the filesystem the path belongs to (syncfs on Linux, sync otherwise)
+    static bool sync_filesystem(const std::wstring& path);
 
-    /// @brief
-    // open file (try twice)
-    // get size
-    // if big - restrict erasure methods
+    /// @brief Flush cached writes of one closed file, fallback if the filesystem could not be synced
+    static bool flush_file(const std::wstring& filename);
+
+    /// @brief Discard free blocks of the filesystem the path belongs to inside the ranges (FITRIM, Linux only,
+    /// needs CAP_SYS_ADMIN), so that blocks released by erase_discard() are trimmed on drives not mounted with discard.
+    /// Free space outside the ranges is not touched, one FITRIM per range
+    /// @param ranges: filesystem byte ranges, see released_extents()
+    static bool trim_filesystem(const std::wstring& path, std::vector<EraseRange> ranges);
+
+    /// @brief Open file (try twice), get size and allocated extents
     bool open(const std::wstring& filename);
 
-    /// @brief
+    /// @brief Flush written data according to the durability policy and close file (should be dome before file node erasure)
     void close();
 
-    /// @brief
-    // erase full
-    bool erase_full(BYTE* start_mask, size_t mask_length = 65536);
+    /// @brief Force written data to the drive regardless of the durability policy, the barrier between
+    /// overwrite passes, so that the page cache does not merge them. Waits for queued asynchronous writes
+    bool flush();
+
+    /// @brief Record ranges written by the last pass, so that they could be read back. Should be set before erasure
+    void set_verification(bool verification);
+
+    /// @brief Flush the last pass, open the file for reading back and pass ranges written by the last pass to the job.
+    /// Should be called before the file node is removed
+    /// @return false if verification is off, nothing is written or the file could not be opened
+    bool verification_job(VerificationJob& job);
+
+    /// @brief Flush written data, unlink the path (usually the renamed file node) and close file.
+    /// With the asynchronous engine it happens as soon as queued writes complete, by linked operations
+    bool close_and_unlink(const std::wstring& unlink_path);
+
+    /// @brief Set size of one write in erase_full(), the mask is repeated to fill the block
+    void set_block_size(size_t block_size);
+
+    /// @brief Overwrite ranges by O_DIRECT writes from page-aligned buffers, bypassing the page cache.
+    /// Unaligned head and tail of the range, scattered small writes go through the page cache.
+    /// Should be called after open()
+    /// @param huge_pages: back write buffers by huge pages if available
+    /// @return false if the filesystem does not support direct I/O, erasure stays buffered
+    bool set_direct_io(bool direct_io, bool huge_pages = false);
+
+    /// @brief Queue writes to the asynchronous engine of the drive instead of blocking ones,
+    /// erasure methods return as soon as writes are queued. The mask should stay valid until
+    /// the engine finishes the file. Should be set before erasure, nullptr for blocking writes
+    void set_io_uring_eraser(IoUringEraser* io_uring_eraser);
+
+    /// @brief Start the next erase_full() pass at the offset, the bytes before it have been overwritten
+    /// by the interrupted job. Other erasure methods start from the beginning
+    void set_resume_offset(uint64_t offset);
 
-    /// @brief
-    // erase random
-    bool erase_random(BYTE* start_mask, size_t mask_length, size_t areas = 0);
+    /// @brief Flush the file and report progress of erase_full() every interval bytes, so that the interrupted job
+    /// could resume from the last checkpoint. Should be set before erasure, empty function for no checkpoints
+    /// @param checkpoint: called with the offset all bytes before which are on the drive
+    void set_checkpoint(uint64_t interval, std::function<void(uint64_t)> checkpoint);
 
-    /// @brief
-    // erase begin and end
-    bool erase_begin_end(BYTE* start_mask, size_t mask_length);
+    /// @brief Erase the whole file from first to last byte (from the resume offset, if set)
+    bool erase_full(uint8_t* start_mask, size_t mask_length);
 
-    /// @brief
-    // erase smart (choose better way)
-    bool erase_smart(BYTE* start_mask, size_t mask_length);
+    /// @brief Erase beginning, end and random parts of the file
+    bool erase_random(uint8_t* start_mask, size_t mask_length);
+
+    /// @brief Erase begin and end only
+    bool erase_begin_end(uint8_t* start_mask, size_t mask_length);
+
+    /// @brief Overwrite header and footer, release blocks in between by punching a hole (SSD, thin-provisioned storage).
+    /// If the filesystem does not support hole punching, the middle is overwritten
+    bool erase_discard(uint8_t* start_mask, size_t mask_length);
+
+    /// @brief Smart erase (choose better way depending on file and drive type)
+    bool erase_smart(uint8_t* start_mask, size_t mask_length);
+
+    /// @brief Set entropy of file regions, so that smart erasure overwrites
+    /// plain regions fully and high-entropy regions only at their beginning
+    void set_entropy_map(std::shared_ptr<const EntropyMap> entropy_map);
+
+    /// @brief True if the file has holes, every erasure method overwrites only its allocated extents
+    bool is_sparse() const { return sparse_; }
+
+    /// @brief Filesystem byte ranges (FIEMAP physical offsets, Linux only) released by erase_discard(),
+    /// empty if the filesystem does not report them
+    const std::vector<EraseRange>& released_extents() const { return released_extents_; }
 
 private:
 
-    /// mark file anchor points
-    bool prepare();
+    /// Erase regions according to the entropy map, then begin and end of the file
+    bool erase_regions(uint8_t* start_mask, size_t mask_length);
+
+    /// mark file anchor points, it would increase probability of writing to the same blocks
+    /// @param overwritten: sorted, not overlapping ranges the following overwrite covers, their anchors are skipped
+    bool prepare(const std::vector<EraseRange>& overwritten);
 
-    /// do not throw, it's time-critical class
+    /// Try opening file. Does not throw, it's time-critical class
     bool try_open(const std::string& filename);
 
+    /// Deallocate the range, the file size stays the same
+    bool punch_hole(uint64_t offset, uint64_t length);
+
+    /// Append filesystem byte ranges of allocated parts of the file range by FIEMAP (Linux)
+    /// @return false if the filesystem does not report them
+    bool find_physical_extents(uint64_t offset, uint64_t length, std::vector<EraseRange>& extents) const;
+
+    /// Find allocated extents of the file by SEEK_DATA/SEEK_HOLE
+    /// @return false if the filesystem does not report holes, the file is treated as fully allocated
+    bool find_data_extents();
+
+    /// Split the range of the sparse file into its allocated parts
+    /// @return false if the range is allocated entirely or the file is not sparse, parts are not filled then
+    bool split_by_extents(uint64_t offset, uint64_t length, std::vector<EraseRange>& parts) const;
+
+    /// Remember the range written by the mask for verification, the mask restarts every period bytes
+    void record_write(uint64_t offset, uint64_t length, const uint8_t* start_mask, size_t mask_length, uint64_t period);
+
+    /// Open flags of the durability policy
+    int sync_flags() const;
+
+    /// Write the whole buffer at the offset, retry short and interrupted writes
+    bool write_at(uint64_t offset, const uint8_t* buffer, size_t length);
+
+    /// Write the one-byte anchor at every point, a queue depth of them by one system call if io_uring is available
+    bool write_anchors(const std::vector<uint64_t>& anchor_points, const uint8_t* anchor);
+
+    /// Overwrite the range by the mask repeated from its beginning, by pwritev() with all vectors pointing to the mask
+    bool write_repeated(uint64_t offset, uint64_t length, const uint8_t* start_mask, size_t mask_length);
+
+    /// Overwrite allocated parts of the range, aligned part of them by direct I/O if enabled
+    bool write_range(uint64_t offset, uint64_t length, const uint8_t* start_mask, size_t mask_length);
+
+    /// Overwrite the range by the mask repeated in write blocks through the page cache
+    bool write_blocks(uint64_t offset, uint64_t length, const uint8_t* start_mask, size_t mask_length);
+
+    /// Overwrite the aligned range by direct I/O, fall back to write_blocks() if the filesystem refuses it
+    bool write_direct(uint64_t offset, uint64_t length, const uint8_t* start_mask, size_t mask_length);
+
+    /// Close direct I/O descriptor
+    void close_direct();
+
 private:
 
-    std::wstring initial_filepath_;
+    // Canonical file path
+    std::string initial_filepath_;
 
+    // HDD/SSD/Unknown
+    DiskType disk_type_ = helpers::PartititonInformation::UnknownType;
+
+    // When written data is forced to the drive
+    DurabilityPolicy durability_ = DurabilityPolicy::PerFile;
+
+    // Make sure we performed some tricks that allows filesystem driver write to the same blocks (just probability)
     bool prepared_to_erase_ = false;
 
-    bool big_file_ = false;
+    // Anything has been written since open, flushed on close
+    bool written_ = false;
+
+    // Type of information. Plain/Binary/Encrypted/Unknown
+    shredder::ShannonEncryptionChecker::InformationEntropyEstimation information_estimation_ =
+        shredder::ShannonEncryptionChecker::Unknown;
+
+    // Size of the file in a moment of eraser creation
+    uint64_t file_size_ = 0;
+
+    // File has holes, writes are clipped to data_extents_, so that holes are never allocated
+    bool sparse_ = false;
+
+    // Allocated extents of the sparse file, coalesced
+    std::vector<EraseRange> data_extents_;
 
-    bool is_file_compressed_;
+    // Filesystem ranges released by punching holes
+    std::vector<EraseRange> released_extents_;
 
-    FileSpecific information_estimation_ = FileSpecific::Unknown;
+    // File descriptor
+    int file_descriptor_ = -1;
 
-    LONGLONG file_size_ = 0;
+    // The same file opened by O_DIRECT, -1 if direct I/O is off
+    int direct_descriptor_ = -1;
 
-    DWORD last_pointer_ = 0;
+    // Back direct I/O buffers by huge pages
+    bool huge_pages_ = false;
 
-    DWORD file_attributes_ = INVALID_FILE_ATTRIBUTES;
+    // Size of one write in erase_full()
+    size_t block_size_ = DEFAULT_BLOCK_SIZE;
 
-    HANDLE file_handle_ = INVALID_HANDLE_VALUE;
+    // Block filled by the repeated mask, allocated on the first full erasure
+    // The mask is expected to stay the same during the file erasure
+    std::vector<uint8_t> write_block_;
+    const uint8_t* write_block_mask_ = nullptr;
 
+    // Aligned blocks for direct I/O, filled the same way as write_block_
+    AlignedBufferPool direct_buffers_;
+    const uint8_t* direct_buffers_mask_ = nullptr;
+
+    // The next full erasure pass starts here
+    uint64_t resume_offset_ = 0;
+
+    // Progress of the full erasure is reported every checkpoint_interval_ bytes, if checkpoint_ is set
+    uint64_t checkpoint_interval_ = 0;
+    std::function<void(uint64_t)> checkpoint_;
+
+    // Areas of the random erasure, the same for all passes
+    std::vector<EraseRange> random_ranges_;
+
+    // Record written ranges for verification
+    bool verification_ = false;
+
+    // Ranges written by the mask of the last pass
+    WrittenRanges written_ranges_;
+    const uint8_t* written_mask_ = nullptr;
+    size_t written_mask_length_ = 0;
+
+    // Entropy of file regions, optional
+    std::shared_ptr<const EntropyMap> entropy_map_;
+
+    // Asynchronous engine of the drive, optional
+    IoUringEraser* io_uring_eraser_ = nullptr;
+
+    // Asynchronous scattered buffered writes or direct writes are queued since the last wait,
+    // they may share pages and should never be in flight together
+    bool buffered_in_flight_ = false;
+    bool direct_in_flight_ = false;
+
+    // Just not to calculate every time
     static constexpr size_t megabyte_ = 1024 * 1024;
 
-    static std::vector<std::wstring> fake_extensions;
+    // Distance between anchor points on SSD
+    static constexpr uint64_t anchor_step_ = 0xFFFF;
+
+    // Anchors in flight of the short-lived queue of prepare() without the erase engine
+    static constexpr unsigned anchor_queue_depth_ = 64;
 
-    static std::default_random_engine generator;
+    // Vectors of one pwritev() call, IOV_MAX is at least 1024 on Linux and macOS
+    static constexpr size_t max_vectors_ = 1024;
+
+    // Choose random areas in a big file to erase
+    static std::default_random_engine generator_;
 };
+
+} // namespace shredder
+
 #endif // defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
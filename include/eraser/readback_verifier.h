@@ -0,0 +1,132 @@
+#if defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+
+namespace shredder {
+
+/// @brief Range overwritten by the repeated mask. Byte at the position p is
+/// mask[((p - origin) % period) % mask_length], the mask restarts every period bytes (write block),
+/// period is 0 if the mask never restarts
+struct WrittenRange
+{
+    uint64_t offset = 0;
+    uint64_t length = 0;
+    uint64_t origin = 0;
+    uint64_t period = 0;
+
+    /// @brief First byte after the range
+    uint64_t end() const { return offset + length; }
+};
+
+/// @brief Ranges overwritten by one mask, not overlapping. A later range replaces overlapped parts of earlier ones,
+/// as the later write does on the drive
+class WrittenRanges {
+public:
+
+    /// @brief Add the range, parts of earlier ranges it overlaps are forgotten
+    void add(const WrittenRange& range);
+
+    /// @brief Forget all ranges
+    void clear() { ranges_.clear(); }
+
+    /// @brief True if nothing is written
+    bool empty() const { return ranges_.empty(); }
+
+    /// @brief Ranges sorted by offset
+    std::vector<WrittenRange> ranges() const;
+
+private:
+
+    // Ranges by offset
+    std::map<uint64_t, WrittenRange> ranges_;
+};
+
+/// @brief Overwritten file to read back
+struct VerificationJob
+{
+    /// File path, for the report only
+    std::string path;
+
+    /// Read-write descriptor opened before the file node is removed, closed by the verifier
+    int fd = -1;
+
+    /// Truncate the file after it is read back, the node may be renamed and unlinked meanwhile
+    bool truncate = true;
+
+    /// Mask of the last pass
+    std::vector<uint8_t> mask;
+
+    /// Ranges of the last pass, sorted by offset
+    std::vector<WrittenRange> ranges;
+};
+
+/// @brief Reads overwritten files back by direct I/O and compares them with the expected pattern
+/// in a worker thread, so that verification of one file overlaps overwriting of the next one
+class ReadBackVerifier {
+public:
+
+    /// Size of one read
+    static constexpr size_t READ_BLOCK_SIZE = 1024 * 1024;
+
+    /// @brief Start the worker thread
+    ReadBackVerifier();
+
+    /// @brief Verify submitted files, stop the worker thread
+    ~ReadBackVerifier();
+
+    ReadBackVerifier(const ReadBackVerifier&) = delete;
+    ReadBackVerifier& operator=(const ReadBackVerifier&) = delete;
+
+    /// @brief Queue verification of the file, returns immediately
+    void submit(VerificationJob job);
+
+    /// @brief Wait until all submitted files are verified
+    /// @return paths of files not matching the expected pattern since the last call
+    std::vector<std::string> wait();
+
+private:
+
+    /// Verify files while not stopped
+    void run();
+
+    /// Read ranges back and compare, page cache is bypassed if the descriptor allows
+    static bool verify(const VerificationJob& job, uint8_t* buffer, size_t buffer_size);
+
+private:
+
+    // Lock of the queue and the report
+    std::mutex lock_;
+
+    // Signalled on submit and stop
+    std::condition_variable job_submitted_;
+
+    // Signalled when the queue is empty
+    std::condition_variable jobs_done_;
+
+    // Files waiting for verification
+    std::deque<VerificationJob> jobs_;
+
+    // Files not matching the pattern
+    std::vector<std::string> failed_files_;
+
+    // A file is being verified
+    bool busy_ = false;
+
+    // Stop the worker
+    bool stopping_ = false;
+
+    // Worker thread, started last
+    std::thread worker_;
+};
+
+} // namespace shredder
+
+#endif // defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
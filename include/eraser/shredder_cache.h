@@ -18,6 +18,8 @@ namespace filesystem {
 
 namespace shredder {
 
+class ShredderDatabaseWrapper;
+
 /// @brief File Shredder Cache
 /// Warning: the cache itself is not thread-safe, thread-safety should be provided by the user class
 /// (FileShredder in our case). If the cache is not consistent, it should be re-filled
@@ -37,8 +39,9 @@ public:
 
     /// @brief Submit file path for erasure
     /// @param file_path: Unicode path
-    /// @param system_added: true if added by application, false is explicitly by the user
-    void submit(const std::wstring& file_path, double entropy);
+    /// @param flags: file properties as stored in the database (ShredderFileProperties)
+    void submit(const std::wstring& file_path, double entropy, int64_t flags = 0,
+                std::shared_ptr<const EntropyMap> entropy_map = nullptr);
 
     /// @brief Remove file path from cache
     void remove(const std::wstring& file_path);
@@ -51,7 +54,10 @@ public:
     bool already_exist(const std::wstring& file_path);
 
     /// @brief Shred files if it's ready
-    void erase_files();
+    /// @param erasure_scheme: overwrite passes shared by all drives, a single random pass if nullptr
+    /// @param journal: database journaling progress of the job, so that the interrupted one resumes, nullptr for no journal
+    /// @return paths of files whose overwrite is not verified by the read-back, on all drives
+    std::vector<std::wstring> erase_files(std::shared_ptr<const ErasureScheme> erasure_scheme = nullptr, ShredderDatabaseWrapper* journal = nullptr);
 
     /// @brief Set the flag of cache coherence to the database
     void set_cache_ready(bool cache_ready);
@@ -67,6 +73,9 @@ public:
 
 private:
 
+    /// Root of the partition the file belongs to, the longest mount point on POSIX systems
+    std::wstring partition_root(const std::wstring& file_path) const;
+
     //////////////////////////////////////////////////////////////////////////
 
     /// Flag set if the data in file cache is coherent the data in database
@@ -1,11 +1,15 @@
 #pragma once
 #include <eraser/shredder_file_info.h>
+#include <eraser/shredder_file_identity.h>
+#include <eraser/erasure_checkpoint.h>
+#include <eraser/erasure_scheme.h>
 #include <winapi-helpers/sqlite3_helper.h>
 
 #include <cstdint>
 #include <utility>
 #include <vector>
 #include <string>
+#include <mutex>
 
 namespace shredder {
 
@@ -18,7 +22,9 @@ class ShredderDatabaseWrapper {
     {
         PathColumn = 0,
         EntropyColumn = 1,
-        FlagsColumn = 2
+        FlagsColumn = 2,
+        RegionSizeColumn = 3,
+        EntropyMapColumn = 4
     };
 
 public:
@@ -44,12 +50,53 @@ public:
     /// @brief Update entropy value
     bool update_record(const std::string& hash, double entropy);
 
+    /// @brief Update entropy value and Compressed flag
+    bool update_record(const std::string& hash, double entropy, bool compressed);
+
     /// @brief Drop table with all records
     bool drop_table();
 
+    /// @brief Save entropy map of the file, replacing the previous one
+    bool update_entropy_map(const std::string& hash, const EntropyMap& entropy_map);
+
+    /// @brief Find entropy calculated for the file with exactly the same identity
+    /// @param entropy_map: entropy map saved with the entry, empty if there is none
+    /// @return false if the file is not in the entropy cache or has been changed since
+    bool find_cached_entropy(const ShredderFileIdentity& identity, double& entropy, bool& compressed, EntropyMap& entropy_map);
+
+    /// @brief Save calculated entropy of the file, replacing entry of the previous file version
+    /// @param entropy_map: entropy map of the file, not saved if empty
+    bool update_cached_entropy(const ShredderFileIdentity& identity, double entropy, bool compressed, const EntropyMap& entropy_map);
+
+    /// @brief Remove entropy cache entries of the files by one transaction, e.g. erased files
+    bool remove_cached_entropy(const std::vector<ShredderFileIdentity>& identities);
+
+    /// @brief Remove all entropy cache entries
+    bool clean_entropy_cache();
+
     /// @brief Clean user-added files only
     bool clean_user_files();
 
+    /// @brief Find progress of the file in the erase job journal
+    /// @return false if the file is not in the journal or has been replaced since
+    bool find_erasure_checkpoint(const ShredderFileIdentity& identity, ErasureCheckpoint& checkpoint);
+
+    /// @brief Save progress of the file, replacing the previous checkpoint
+    bool update_erasure_checkpoint(const ShredderFileIdentity& identity, const ErasureCheckpoint& checkpoint);
+
+    /// @brief Save progress of many files by one transaction, e.g. files of the group commit
+    bool update_erasure_checkpoints(const std::vector<std::pair<ShredderFileIdentity, ErasureCheckpoint>>& checkpoints);
+
+    /// @brief Find patterns of the journaled erase job
+    /// @return false if no job is journaled
+    bool find_erasure_job(ErasureScheme::Type& type, unsigned& passes_count, uint32_t& seed);
+
+    /// @brief Save patterns of the erase job, replacing the previous job
+    bool update_erasure_job(const ErasureScheme& scheme);
+
+    /// @brief Remove all erase job journal entries and the job patterns, the job is finished or abandoned
+    bool clean_erasure_journal();
+
     /// Check error code and log if != SQLITE_OK
     bool check_sqlite_error() const;
 
@@ -61,14 +108,44 @@ private:
     /// SELECT callback called for every receiver row
     static int select_callback(void *raw_data, int column_count, char **column_values, char **column_name);
 
+    /// SELECT callback for the entropy cache lookup
+    static int cache_select_callback(void *raw_data, int column_count, char **column_values, char **column_name);
+
+    /// SELECT callback for the erase job journal lookup
+    static int journal_select_callback(void *raw_data, int column_count, char **column_values, char **column_name);
+
+    /// SELECT callback for the erase job patterns lookup
+    static int job_select_callback(void *raw_data, int column_count, char **column_values, char **column_name);
+
     /// Save record from database to memory
-    void read_db_row(std::wstring&& path, double entropy, int64_t flags);
+    void read_db_row(std::wstring&& path, double entropy, int64_t flags, std::shared_ptr<const EntropyMap> entropy_map);
 
     //////////////////////////////////////////////////////////////////////////
 
     /// Temporary storage for 'filetable' (swapped in read_table() method)
     mutable std::vector<ShredderFileInfo> tmp_table_;
 
+    /// Entropy found by the last entropy cache lookup (set in cache_select_callback() method)
+    double tmp_cached_entropy_ = -1.0;
+    bool tmp_cached_compressed_ = false;
+    EntropyMap tmp_cached_entropy_map_;
+
+    /// Entropy cache is looked up from calculation workers concurrently
+    std::mutex cache_lookup_mutex_;
+
+    /// Checkpoint found by the last journal lookup (set in journal_select_callback() method)
+    ErasureCheckpoint tmp_checkpoint_;
+    bool tmp_checkpoint_found_ = false;
+
+    /// Patterns found by the last job lookup (set in job_select_callback() method)
+    ErasureScheme::Type tmp_job_type_ = ErasureScheme::Type::SinglePass;
+    unsigned tmp_job_passes_ = 0;
+    uint32_t tmp_job_seed_ = 0;
+    bool tmp_job_found_ = false;
+
+    /// Journal is looked up by erasers of different drives
+    std::mutex journal_lookup_mutex_;
+
     /// Database
     helpers::sqlite3_helper eraser_db_;
 };
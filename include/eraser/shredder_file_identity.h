@@ -0,0 +1,37 @@
+#pragma once
+#include <string>
+#include <cstdint>
+
+namespace shredder {
+
+/// @brief Identity of the file content as seen by the file system
+/// Equal identity means the same file, not modified since the identity was read,
+/// so that its entropy does not need to be calculated again
+struct ShredderFileIdentity
+{
+    /// Device (volume serial number on Windows)
+    uint64_t device = 0;
+
+    /// Inode (file index on Windows)
+    uint64_t inode = 0;
+
+    /// File size in bytes
+    uint64_t size = 0;
+
+    /// Last modification time, nanoseconds
+    int64_t mtime_ns = 0;
+
+    /// Last metadata change time, nanoseconds
+    int64_t ctime_ns = 0;
+
+    /// False if the identity could not be read
+    bool valid = false;
+
+    /// @brief Read identity of the regular file. Does not throw
+    static ShredderFileIdentity read(const std::wstring& file_path);
+
+    bool operator==(const ShredderFileIdentity& other) const;
+    bool operator!=(const ShredderFileIdentity& other) const { return !(*this == other); }
+};
+
+} // namespace shredder
@@ -1,7 +1,9 @@
 #pragma once
 #include <string>
+#include <memory>
 #include <cstdint>
 #include <eraser/shredder_file_properties.h>
+#include <eraser/entropy_map.h>
 
 
 namespace shredder {
@@ -9,8 +11,8 @@ namespace shredder {
 struct ShredderFileInfo
 {
     /// @brief Construct 
-    ShredderFileInfo(const std::wstring& p, double ent, int64_t flg) : 
-        path(p), entropy(ent)
+    ShredderFileInfo(const std::wstring& p, double ent, int64_t flg, std::shared_ptr<const EntropyMap> map = nullptr) : 
+        path(p), entropy(ent), entropy_map(std::move(map))
     {
         flags.set_flags(flg);
     }
@@ -18,6 +20,9 @@ struct ShredderFileInfo
     std::wstring path;
     double entropy;
     ShredderFileProperties flags;
+
+    /// Entropy of file regions, nullptr if not calculated
+    std::shared_ptr<const EntropyMap> entropy_map;
 };
 
 } // namespace shredder
@@ -18,7 +18,7 @@ public:
     {
         SystemAdded = 0x01LL,
         IsFile = 0x02LL,
-        Reserved1 = 0x04LL,
+        Compressed = 0x04LL,
         Reserved2 = 0x08LL
     };
 
@@ -28,9 +28,15 @@ public:
     /// @brief: If the file is regular (not directory, symlink etc)
     void set_is_file(bool is_file);
 
+    /// @brief: If the file content is compressed data, high entropy of which is not ciphertext
+    void set_compressed(bool compressed);
+
     /// @brief: If the file is regular (not directory, symlink etc)
     bool is_file() const;
 
+    /// @brief: If the file content is compressed data
+    bool is_compressed() const;
+
     /// @brief: If the file was added by application (browser or OS-related), not by user
     bool is_system_added() const;
 
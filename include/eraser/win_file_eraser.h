@@ -2,8 +2,14 @@
 #pragma once
 #include <string>
 #include <random>
+#include <memory>
+#include <vector>
+#include <functional>
 #include <Windows.h>
+#include <eraser/durability_policy.h>
 #include <eraser/encryption_checker.h>
+#include <eraser/entropy_map.h>
+#include <eraser/erase_range.h>
 #include <winapi-helpers/partition_information.h>
 
 namespace shredder {
@@ -25,7 +31,10 @@ public:
     /// If plain - strong erasure methods applied,
     /// If encrypted - smart erasure methods
     /// @param disk_type: SSD or HDD, optimization of erasure process
-    NativeFileEraser(const std::wstring& filename, EntropyEstimation estimation, DiskType disk_type);
+    /// @param durability: when written data is forced to the drive, with GroupCommit the caller
+    /// should sync_filesystem() before the file node is removed
+    NativeFileEraser(const std::wstring& filename, EntropyEstimation estimation, DiskType disk_type,
+                     DurabilityPolicy durability = DurabilityPolicy::PerFile);
 
     // erase, close (change attributes)
     ~NativeFileEraser();
@@ -39,13 +48,34 @@ public:
     /// @brief Clean journal after all files are erased (Wide string version)
     static bool clean_ntfs_journal(const std::wstring& drive_root);
 
-    /// @brief Open file (try twice), get size, if file is big (> 4 Gb) - set smart erasure method
+    /// @brief Flush all cached writes of the volume (needs administrator rights)
+    static bool sync_filesystem(const std::wstring& drive_root);
+
+    /// @brief Flush cached writes of one closed file, does not need administrator rights
+    static bool flush_file(const std::wstring& filename);
+
+    /// @brief Not needed on Windows, for compatibility with POSIX eraser
+    static bool trim_filesystem(const std::wstring& drive_root);
+
+    /// @brief Open file (try twice), get size
     bool open(const std::wstring& filename);
 
-    /// @brief Close file (should be dome before file node erasure)
+    /// @brief Flush written data according to the durability policy and close file (should be dome before file node erasure)
     void close();
 
-    /// @brief Erase the whole file from first to last byte
+    /// @brief Force written data to the drive regardless of the durability policy, the barrier between overwrite passes
+    bool flush();
+
+    /// @brief Start the next erase_full() pass at the offset, the bytes before it have been overwritten
+    /// by the interrupted job. Other erasure methods start from the beginning
+    void set_resume_offset(uint64_t offset);
+
+    /// @brief Flush the file and report progress of erase_full() every interval bytes, so that the interrupted job
+    /// could resume from the last checkpoint. Should be set before erasure, empty function for no checkpoints
+    /// @param checkpoint: called with the offset all bytes before which are on the drive
+    void set_checkpoint(uint64_t interval, std::function<void(uint64_t)> checkpoint);
+
+    /// @brief Erase the whole file from first to last byte (from the resume offset, if set)
     bool erase_full(uint8_t* start_mask, size_t mask_length);
 
     /// @brief Erase beginning, end and random parts of the file
@@ -54,13 +84,28 @@ public:
     /// @brief Erase begin and end only
     bool erase_begin_end(uint8_t* start_mask, size_t mask_length);
 
+    /// @brief Overwrite begin and end, deallocate the middle of the file by marking it sparse and zeroing (SSD, thin-provisioned storage).
+    /// If the filesystem does not support sparse files, the middle is overwritten
+    bool erase_discard(uint8_t* start_mask, size_t mask_length);
+
     /// @brief Smart erase (choose better way depending on file and drive type)
     bool erase_smart(uint8_t* start_mask, size_t mask_length);
 
+    /// @brief Set entropy of file regions, so that smart erase overwrites
+    /// plain regions fully and high-entropy regions only at their beginning
+    void set_entropy_map(std::shared_ptr<const EntropyMap> entropy_map);
+
 private:
 
+    /// Erase regions according to the entropy map, then begin and end of the file
+    bool erase_regions(uint8_t* start_mask, size_t mask_length);
+
     /// mark file anchor points, it would increase probability of writing to the same blocks
-    bool prepare();
+    /// @param overwritten: sorted, not overlapping ranges the following overwrite covers, their anchors are skipped
+    bool prepare(const std::vector<EraseRange>& overwritten);
+
+    /// Write one-byte anchors by batches of overlapped writes through the second handle of the file
+    bool write_anchors(const std::vector<uint64_t>& anchor_points);
 
     /// compressed, windows-encrypted or sparse file
     bool is_file_compressed(DWORD file_attributes) const;
@@ -85,12 +130,12 @@ private:
     // HDD/SSD/Unknown
     DiskType disk_type_ = helpers::PartititonInformation::UnknownType;
 
+    // When written data is forced to the drive
+    DurabilityPolicy durability_ = DurabilityPolicy::PerFile;
+
     // Make sure we performed some tricks that allows filesystem driver write to the same blocks (just probability)
     bool prepared_to_erase_ = false;
 
-    // File > 4Gb
-    bool big_file_ = false;
-
     // File is compressed of encrypted using NTFS encryption
     bool is_file_compressed_ = false;
 
@@ -110,9 +155,28 @@ private:
     // Windows file handle
     HANDLE file_handle_ = INVALID_HANDLE_VALUE;
 
+    // The next full erasure pass starts here
+    uint64_t resume_offset_ = 0;
+
+    // Progress of the full erasure is reported every checkpoint_interval_ bytes, if checkpoint_ is set
+    uint64_t checkpoint_interval_ = 0;
+    std::function<void(uint64_t)> checkpoint_;
+
+    // Areas of the random erasure, the same for all passes
+    std::vector<EraseRange> random_ranges_;
+
+    // Entropy of file regions, optional
+    std::shared_ptr<const EntropyMap> entropy_map_;
+
     // Just not to calculate every time
     static constexpr size_t megabyte_ = 1024 * 1024;
 
+    // Distance between anchor points on SSD
+    static constexpr uint64_t anchor_step_ = 0xFFFF;
+
+    // Overlapped anchor writes in flight
+    static constexpr size_t anchor_batch_size_ = 64;
+
     // Choose random areas in a big file to erase
     static std::default_random_engine generator_;
 };
@@ -52,7 +52,40 @@ def main():
             "filename TEXT NOT NULL,"
             "entropy REAL NOT NULL,"
             "flags INT8 NOT NULL)")
-        logger.info("Created table")
+        cur.execute(
+            "CREATE TABLE IF NOT EXISTS entropycache("
+            "device INT8 NOT NULL,"
+            "inode INT8 NOT NULL,"
+            "size INT8 NOT NULL,"
+            "mtime INT8 NOT NULL,"
+            "ctime INT8 NOT NULL,"
+            "entropy REAL NOT NULL,"
+            "compressed INT8 NOT NULL,"
+            "regionsize INT8,"
+            "map TEXT,"
+            "PRIMARY KEY(device, inode))")
+        cur.execute(
+            "CREATE TABLE IF NOT EXISTS entropymap("
+            "hash TEXT PRIMARY KEY,"
+            "regionsize INT8 NOT NULL,"
+            "map TEXT NOT NULL)")
+        cur.execute(
+            "CREATE TABLE IF NOT EXISTS erasejournal("
+            "device INT8 NOT NULL,"
+            "inode INT8 NOT NULL,"
+            "size INT8 NOT NULL,"
+            "pass INT8 NOT NULL,"
+            "offset INT8 NOT NULL,"
+            "overwritten INT8 NOT NULL,"
+            "probe INT8 NOT NULL,"
+            "PRIMARY KEY(device, inode))")
+        cur.execute(
+            "CREATE TABLE IF NOT EXISTS erasejob("
+            "id INTEGER PRIMARY KEY CHECK (id = 0),"
+            "type INT8 NOT NULL,"
+            "passes INT8 NOT NULL,"
+            "seed INT8 NOT NULL)")
+        logger.info("Created tables")
 
         # create hash which is key
         file_name = 'C:/Temp/my.dll'
@@ -0,0 +1,33 @@
+#!/bin/sh
+# Loop-mount the ext4 image for PosixFileEraserTests (ERASER_TEST_EXT4_DIR), requires root
+# Usage: ext4_test_image.sh mount|umount <directory>
+set -e
+
+action="$1"
+directory="$2"
+image="${directory}.img"
+
+case "${action}" in
+mount)
+    mkdir -p "${directory}"
+    if mountpoint -q "${directory}"; then
+        umount "${directory}"
+    fi
+    rm -f "${image}"
+    truncate -s 256M "${image}"
+    mkfs.ext4 -q -F "${image}"
+    mount -o loop "${image}" "${directory}"
+    chmod 1777 "${directory}"
+    ;;
+umount)
+    if mountpoint -q "${directory}"; then
+        umount "${directory}"
+    fi
+    rm -f "${image}"
+    rmdir "${directory}" 2>/dev/null || true
+    ;;
+*)
+    echo "Usage: $0 mount|umount <directory>" >&2
+    exit 2
+    ;;
+esac
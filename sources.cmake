@@ -1,21 +1,50 @@
 set(ERASER_SOURCES
+        ${CMAKE_CURRENT_SOURCE_DIR}/src/aligned_buffer_pool.cpp
+        ${CMAKE_CURRENT_SOURCE_DIR}/src/byte_histogram.cpp
+        ${CMAKE_CURRENT_SOURCE_DIR}/src/content_signature.cpp
+        ${CMAKE_CURRENT_SOURCE_DIR}/src/content_statistics.cpp
         ${CMAKE_CURRENT_SOURCE_DIR}/src/drive_eraser.cpp
         ${CMAKE_CURRENT_SOURCE_DIR}/src/encryption_checker.cpp
+        ${CMAKE_CURRENT_SOURCE_DIR}/src/erase_range.cpp
+        ${CMAKE_CURRENT_SOURCE_DIR}/src/erasure_scheme.cpp
+        ${CMAKE_CURRENT_SOURCE_DIR}/src/entropy_file_reader.cpp
+        ${CMAKE_CURRENT_SOURCE_DIR}/src/entropy_map.cpp
         ${CMAKE_CURRENT_SOURCE_DIR}/src/file_shredder.cpp
+        ${CMAKE_CURRENT_SOURCE_DIR}/src/histogram_kernels.cpp
+        ${CMAKE_CURRENT_SOURCE_DIR}/src/io_uring_eraser.cpp
+        ${CMAKE_CURRENT_SOURCE_DIR}/src/io_uring_queue.cpp
         ${CMAKE_CURRENT_SOURCE_DIR}/src/posix_file_eraser.cpp
         ${CMAKE_CURRENT_SOURCE_DIR}/src/random_generator.cpp
+        ${CMAKE_CURRENT_SOURCE_DIR}/src/readback_verifier.cpp
         ${CMAKE_CURRENT_SOURCE_DIR}/src/shredder_cache.cpp
         ${CMAKE_CURRENT_SOURCE_DIR}/src/shredder_datatbase.cpp
+        ${CMAKE_CURRENT_SOURCE_DIR}/src/shredder_file_identity.cpp
         ${CMAKE_CURRENT_SOURCE_DIR}/src/shredder_file_properties.cpp
         ${CMAKE_CURRENT_SOURCE_DIR}/src/win_file_eraser.cpp
+        ${CMAKE_CURRENT_SOURCE_DIR}/include/eraser/aligned_buffer_pool.h
+        ${CMAKE_CURRENT_SOURCE_DIR}/include/eraser/byte_histogram.h
+        ${CMAKE_CURRENT_SOURCE_DIR}/include/eraser/cancellation_token.h
+        ${CMAKE_CURRENT_SOURCE_DIR}/include/eraser/content_signature.h
+        ${CMAKE_CURRENT_SOURCE_DIR}/include/eraser/content_statistics.h
         ${CMAKE_CURRENT_SOURCE_DIR}/include/eraser/drive_eraser.h
+        ${CMAKE_CURRENT_SOURCE_DIR}/include/eraser/durability_policy.h
         ${CMAKE_CURRENT_SOURCE_DIR}/include/eraser/encryption_checker.h
+        ${CMAKE_CURRENT_SOURCE_DIR}/include/eraser/erase_range.h
+        ${CMAKE_CURRENT_SOURCE_DIR}/include/eraser/erasure_checkpoint.h
+        ${CMAKE_CURRENT_SOURCE_DIR}/include/eraser/erasure_scheme.h
+        ${CMAKE_CURRENT_SOURCE_DIR}/include/eraser/entropy_file_reader.h
+        ${CMAKE_CURRENT_SOURCE_DIR}/include/eraser/entropy_map.h
         ${CMAKE_CURRENT_SOURCE_DIR}/include/eraser/file_shredder.h
+        ${CMAKE_CURRENT_SOURCE_DIR}/include/eraser/histogram_kernels.h
+        ${CMAKE_CURRENT_SOURCE_DIR}/include/eraser/io_uring_eraser.h
+        ${CMAKE_CURRENT_SOURCE_DIR}/include/eraser/io_uring_queue.h
         ${CMAKE_CURRENT_SOURCE_DIR}/include/eraser/posix_file_eraser.h
         ${CMAKE_CURRENT_SOURCE_DIR}/include/eraser/random_generator.h
+        ${CMAKE_CURRENT_SOURCE_DIR}/include/eraser/readback_verifier.h
         ${CMAKE_CURRENT_SOURCE_DIR}/include/eraser/shredder_cache.h
         ${CMAKE_CURRENT_SOURCE_DIR}/include/eraser/shredder_callback_interface.h
         ${CMAKE_CURRENT_SOURCE_DIR}/include/eraser/shredder_datatbase.h
+        ${CMAKE_CURRENT_SOURCE_DIR}/include/eraser/shredder_file_identity.h
         ${CMAKE_CURRENT_SOURCE_DIR}/include/eraser/shredder_file_info.h
         ${CMAKE_CURRENT_SOURCE_DIR}/include/eraser/shredder_file_properties.h
         ${CMAKE_CURRENT_SOURCE_DIR}/include/eraser/win_file_eraser.h
@@ -0,0 +1,79 @@
+#if defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
+#include <eraser/aligned_buffer_pool.h>
+
+#include <algorithm>
+#include <cassert>
+
+#include <sys/mman.h>
+
+using namespace shredder;
+
+AlignedBufferPool::~AlignedBufferPool()
+{
+    release();
+}
+
+bool AlignedBufferPool::init(size_t buffers_count, size_t buffer_size, bool huge_pages)
+{
+    release();
+    if (0 == buffers_count || 0 == buffer_size) {
+        return false;
+    }
+
+    const size_t alignment = huge_pages ? HUGE_PAGE_SIZE : IO_ALIGNMENT;
+    buffer_size = (buffer_size + IO_ALIGNMENT - 1) / IO_ALIGNMENT * IO_ALIGNMENT;
+    const size_t memory_size = (buffer_size * buffers_count + alignment - 1) / alignment * alignment;
+
+    void* memory = MAP_FAILED;
+#if defined(MAP_HUGETLB)
+    if (huge_pages) {
+        // fails unless huge pages are reserved (vm.nr_hugepages)
+        memory = ::mmap(nullptr, memory_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        huge_pages_ = (MAP_FAILED != memory);
+    }
+#endif
+    if (MAP_FAILED == memory) {
+        memory = ::mmap(nullptr, memory_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (MAP_FAILED == memory) {
+            return false;
+        }
+#if defined(MADV_HUGEPAGE)
+        if (huge_pages) {
+            ::madvise(memory, memory_size, MADV_HUGEPAGE);
+        }
+#endif
+    }
+
+    memory_ = static_cast<uint8_t*>(memory);
+    memory_size_ = memory_size;
+    buffer_size_ = buffer_size;
+    buffers_count_ = buffers_count;
+    return true;
+}
+
+void AlignedBufferPool::release()
+{
+    if (memory_) {
+        ::munmap(memory_, memory_size_);
+    }
+    memory_ = nullptr;
+    memory_size_ = buffer_size_ = buffers_count_ = 0;
+    huge_pages_ = false;
+}
+
+void AlignedBufferPool::fill(const uint8_t* mask, size_t mask_length)
+{
+    assert(mask_length > 0);
+    const size_t pool_size = buffer_size_ * buffers_count_;
+    for (size_t filled = 0; filled < pool_size; filled += mask_length) {
+        std::copy_n(mask, std::min(mask_length, pool_size - filled), memory_ + filled);
+    }
+}
+
+uint8_t* AlignedBufferPool::buffer(size_t index) const
+{
+    assert(index < buffers_count_);
+    return memory_ + index * buffer_size_;
+}
+
+#endif // defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
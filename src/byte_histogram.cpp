@@ -0,0 +1,58 @@
+#include <eraser/byte_histogram.h>
+#include <eraser/histogram_kernels.h>
+
+#include <algorithm>
+
+using namespace shredder;
+
+void ByteHistogram::update(const uint8_t* block_start, size_t block_size)
+{
+    while (block_size > 0) {
+        size_t pass_size = std::min(block_size, MAX_PASS_SIZE);
+        update_pass(block_start, pass_size);
+        block_start += pass_size;
+        block_size -= pass_size;
+    }
+}
+
+void ByteHistogram::update_pass(const uint8_t* block_start, size_t block_size)
+{
+    // every next byte goes to the next table, pages starting with a run of one byte (zero-filled, sparse)
+    // are counted by the run-skipping kernel, other pages by the scalar one
+    HistogramTables tables = {};
+    const HistogramKernel kernel = best_histogram_kernel().kernel;
+    const HistogramKernel runs_kernel = best_runs_histogram_kernel().kernel;
+    for (size_t offset = 0; offset < block_size; offset += KERNEL_PAGE_SIZE) {
+        const size_t page_size = std::min(block_size - offset, KERNEL_PAGE_SIZE);
+        (starts_with_run(block_start + offset, page_size) ? runs_kernel : kernel)(block_start + offset, page_size, tables);
+    }
+
+    for (size_t b = 0; b < BINS_COUNT; ++b) {
+        counters_[b] += static_cast<uint64_t>(tables[0][b]) + tables[1][b] + tables[2][b] + tables[3][b];
+    }
+    total_ += block_size;
+}
+
+void ByteHistogram::merge(const ByteHistogram& other)
+{
+    for (size_t b = 0; b < BINS_COUNT; ++b) {
+        counters_[b] += other.counters_[b];
+    }
+    total_ += other.total_;
+}
+
+void ByteHistogram::clear()
+{
+    counters_.fill(0);
+    total_ = 0;
+}
+
+double ByteHistogram::entropy() const
+{
+    return histogram_entropy(counters_.data(), counters_.size(), total_);
+}
+
+std::vector<size_t> ByteHistogram::distribution() const
+{
+    return std::vector<size_t>(counters_.begin(), counters_.end());
+}
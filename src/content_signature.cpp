@@ -0,0 +1,121 @@
+#include <eraser/content_signature.h>
+
+#include <cstring>
+#include <iterator>
+
+using namespace shredder;
+
+namespace {
+
+/// Magic number at the fixed offset
+struct MagicNumber
+{
+    ContentSignature::ContainerType container;
+    size_t offset;
+    const char* bytes;
+    size_t size;
+};
+
+// zip also starts docx/xlsx/odt/jar/apk, 'ftyp' box is the first one of mp4/mov/3gp/heic
+const MagicNumber magic_numbers[] = {
+    { ContentSignature::Zip, 0, "PK\x03\x04", 4 },
+    { ContentSignature::Zip, 0, "PK\x07\x08", 4 },
+    { ContentSignature::Gzip, 0, "\x1F\x8B\x08", 3 },
+    { ContentSignature::Zstd, 0, "\x28\xB5\x2F\xFD", 4 },
+    { ContentSignature::Xz, 0, "\xFD" "7zXZ\x00", 6 },
+    { ContentSignature::SevenZip, 0, "7z\xBC\xAF\x27\x1C", 6 },
+    { ContentSignature::Jpeg, 0, "\xFF\xD8\xFF", 3 },
+    { ContentSignature::Png, 0, "\x89PNG\r\n\x1A\n", 8 },
+    { ContentSignature::Mp4, 4, "ftyp", 4 },
+    { ContentSignature::Luks, 0, "LUKS\xBA\xBE", 6 },
+    { ContentSignature::Age, 0, "age-encryption.org/v1\n", 22 }
+};
+
+/// OpenPGP binary message starts with public-key or symmetric-key encrypted session key packet
+/// (RFC 4880, 4.2 and 5.1, 5.3), recognized by the packet tag and the version of the packet
+bool is_gpg_message(const uint8_t* header, size_t header_size)
+{
+    if (header_size < 4) {
+        return false;
+    }
+
+    const uint8_t tag_byte = header[0];
+    if (0 == (tag_byte & 0x80)) {
+        return false;
+    }
+
+    unsigned tag{};
+    size_t body_offset{};
+    if (tag_byte & 0x40) {
+        // new format, one-octet length is enough for session key packets
+        tag = tag_byte & 0x3F;
+        if (header[1] >= 192) {
+            return false;
+        }
+        body_offset = 2;
+    }
+    else {
+        // old format, length type in two lower bits
+        tag = (tag_byte >> 2) & 0x0F;
+        static const size_t length_sizes[] = { 1, 2, 4, 0 };
+        if (0 == length_sizes[tag_byte & 0x03]) {
+            return false;
+        }
+        body_offset = 1 + length_sizes[tag_byte & 0x03];
+    }
+
+    if (body_offset >= header_size) {
+        return false;
+    }
+    const uint8_t version = header[body_offset];
+
+    constexpr unsigned public_key_session_tag = 1;
+    constexpr unsigned symmetric_key_session_tag = 3;
+    if (tag == public_key_session_tag) {
+        return version == 3 || version == 6;
+    }
+    if (tag == symmetric_key_session_tag) {
+        return version == 4 || version == 5 || version == 6;
+    }
+    return false;
+}
+
+} // namespace
+
+// static
+ContentSignature::ContainerType ContentSignature::detect(const uint8_t* header, size_t header_size)
+{
+    for (const MagicNumber& magic : magic_numbers) {
+        if (magic.offset + magic.size <= header_size &&
+            0 == std::memcmp(header + magic.offset, magic.bytes, magic.size)) {
+            return magic.container;
+        }
+    }
+
+    if (is_gpg_message(header, header_size)) {
+        return Gpg;
+    }
+    return Unknown;
+}
+
+// static
+bool ContentSignature::is_encrypted(ContainerType container)
+{
+    return container == Luks || container == Age || container == Gpg;
+}
+
+// static
+bool ContentSignature::is_weak(ContainerType container)
+{
+    // 3-byte magic numbers and OpenPGP packet headers
+    return container == Gzip || container == Jpeg || container == Gpg;
+}
+
+// static
+std::string ContentSignature::name(ContainerType container)
+{
+    static const char* names[] = { "Unknown", "Zip", "Gzip", "Zstd", "Xz", "7z",
+                                   "JPEG", "PNG", "MP4", "LUKS", "age", "GPG" };
+    static_assert(std::size(names) == Gpg + 1, "Every container must have a name");
+    return names[container];
+}
@@ -0,0 +1,159 @@
+#include <eraser/content_statistics.h>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace shredder;
+
+namespace {
+
+/// Both coordinates are 24-bit, point is inside if x^2 + y^2 <= (2^24 - 1)^2
+constexpr uint64_t MONTE_CARLO_RADIUS = (1u << 24) - 1;
+
+inline bool monte_carlo_inside(const uint8_t* point)
+{
+    uint64_t x = (uint64_t(point[0]) << 16) | (uint64_t(point[1]) << 8) | point[2];
+    uint64_t y = (uint64_t(point[3]) << 16) | (uint64_t(point[4]) << 8) | point[5];
+    return (x * x + y * y) <= MONTE_CARLO_RADIUS * MONTE_CARLO_RADIUS;
+}
+
+} // namespace
+
+void ContentStatistics::update(const uint8_t* block_start, size_t block_size)
+{
+    // the part is counted twice while it is still in cache, the file is read once
+    while (block_size > 0) {
+        size_t pass_size = std::min(block_size, CACHE_PASS_SIZE);
+        update_pass(block_start, pass_size);
+        histogram_.update(block_start, pass_size);
+        block_start += pass_size;
+        block_size -= pass_size;
+    }
+}
+
+void ContentStatistics::append(const ContentStatistics& next)
+{
+    if (0 == next.total()) {
+        return;
+    }
+    if (0 == total()) {
+        *this = next;
+        return;
+    }
+
+    // the pair of bytes at the boundary is the only one neither sequence has seen
+    serial_products_ += uint64_t(last_byte_) * next.first_byte_ + next.serial_products_;
+    last_byte_ = next.last_byte_;
+    histogram_.merge(next.histogram_);
+
+    monte_carlo_points_ += next.monte_carlo_points_;
+    monte_carlo_inside_ += next.monte_carlo_inside_;
+    std::copy(next.point_bytes_, next.point_bytes_ + next.point_bytes_size_, point_bytes_);
+    point_bytes_size_ = next.point_bytes_size_;
+}
+
+void ContentStatistics::update_pass(const uint8_t* block_start, size_t block_size)
+{
+    if (0 == histogram_.total()) {
+        first_byte_ = block_start[0];
+    }
+    else {
+        serial_products_ += uint64_t(last_byte_) * block_start[0];
+    }
+
+    // 32-bit partial sums do not overflow within the pass (65025 * 64K < 2^32)
+    uint32_t serial_products{};
+    for (size_t i = 1; i < block_size; ++i) {
+        serial_products += uint32_t(block_start[i - 1]) * block_start[i];
+    }
+    serial_products_ += serial_products;
+    last_byte_ = block_start[block_size - 1];
+
+    // complete the point left from the previous block
+    size_t offset = 0;
+    if (point_bytes_size_ > 0) {
+        while (point_bytes_size_ < MONTE_CARLO_POINT_SIZE && offset < block_size) {
+            point_bytes_[point_bytes_size_++] = block_start[offset++];
+        }
+        if (point_bytes_size_ < MONTE_CARLO_POINT_SIZE) {
+            return;
+        }
+        monte_carlo_inside_ += monte_carlo_inside(point_bytes_);
+        ++monte_carlo_points_;
+        point_bytes_size_ = 0;
+    }
+
+    uint64_t inside{};
+    uint64_t points{};
+    for (; offset + MONTE_CARLO_POINT_SIZE <= block_size; offset += MONTE_CARLO_POINT_SIZE) {
+        inside += monte_carlo_inside(block_start + offset);
+        ++points;
+    }
+    monte_carlo_inside_ += inside;
+    monte_carlo_points_ += points;
+
+    while (offset < block_size) {
+        point_bytes_[point_bytes_size_++] = block_start[offset++];
+    }
+}
+
+double ContentStatistics::chi_square() const
+{
+    if (0 == total()) {
+        return 0.0;
+    }
+
+    const double expected = static_cast<double>(total()) / ByteHistogram::BINS_COUNT;
+    double chi_square{};
+    for (size_t b = 0; b < ByteHistogram::BINS_COUNT; ++b) {
+        double difference = static_cast<double>(histogram_.count(static_cast<uint8_t>(b))) - expected;
+        chi_square += difference * difference / expected;
+    }
+    return chi_square;
+}
+
+double ContentStatistics::mean() const
+{
+    if (0 == total()) {
+        return 0.0;
+    }
+
+    double sum{};
+    for (size_t b = 0; b < ByteHistogram::BINS_COUNT; ++b) {
+        sum += static_cast<double>(b) * static_cast<double>(histogram_.count(static_cast<uint8_t>(b)));
+    }
+    return sum / static_cast<double>(total());
+}
+
+double ContentStatistics::serial_correlation() const
+{
+    if (total() < 2) {
+        return 0.0;
+    }
+
+    // sums of bytes and squares come from the histogram
+    double sum{};
+    double squares{};
+    for (size_t b = 0; b < ByteHistogram::BINS_COUNT; ++b) {
+        double count = static_cast<double>(histogram_.count(static_cast<uint8_t>(b)));
+        sum += static_cast<double>(b) * count;
+        squares += static_cast<double>(b * b) * count;
+    }
+
+    const double n = static_cast<double>(total());
+    const double products = static_cast<double>(serial_products_) + double(last_byte_) * first_byte_;
+    const double denominator = n * squares - sum * sum;
+    if (0.0 == denominator) {
+        // all bytes are equal, correlation is undefined, ent reports it as perfectly correlated
+        return 1.0;
+    }
+    return (n * products - sum * sum) / denominator;
+}
+
+double ContentStatistics::monte_carlo_pi() const
+{
+    if (0 == monte_carlo_points_) {
+        return 0.0;
+    }
+    return 4.0 * static_cast<double>(monte_carlo_inside_) / static_cast<double>(monte_carlo_points_);
+}
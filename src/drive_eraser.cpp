@@ -1,20 +1,25 @@
 #include <eraser/drive_eraser.h>
 #include <eraser/file_shredder.h>
+#include <eraser/shredder_datatbase.h>
 
 #if defined(_WIN32) || defined(_WIN64)
 #include <eraser/win_file_eraser.h>
 #elif defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
-#include <file_eraser/posix_file_eraser.h>
+#include <eraser/posix_file_eraser.h>
+#include <eraser/io_uring_eraser.h>
+#include <eraser/readback_verifier.h>
 #endif
 
 #include <plog/Log.h>
 #include <winapi-helpers/utilities.h>
 #include <eraser/encryption_checker.h>
+#include <eraser/entropy_file_reader.h>
 
 #include <boost/filesystem.hpp>
 #include <boost/system/error_code.hpp>
 
 #include <algorithm>
+#include <atomic>
 #include <vector>
 #include <string>
 #include <cassert>
@@ -32,7 +37,39 @@ namespace bs = boost::system;
 using std::string;
 using std::wstring;
 using helpers::thread_pool;
-using encryption::ShannonEncryptionChecker;
+
+namespace {
+
+/// Names tried before the file is left with its current name
+constexpr int MAX_RENAME_ATTEMPTS = 16;
+
+/// Sequence of renamed nodes in the process
+std::atomic<uint64_t> renamed_nodes{ 0 };
+
+/// Name of the given length filled by the character, ending with the sequence number,
+/// longer only if the number does not fit
+std::string unique_node_name(char c, size_t length)
+{
+    std::ostringstream sequence;
+    sequence << std::hex << renamed_nodes.fetch_add(1, std::memory_order_relaxed);
+    const std::string suffix = sequence.str();
+    if (length <= suffix.size()) {
+        return c + suffix;
+    }
+    return std::string(length - suffix.size(), c) + suffix;
+}
+
+/// FNV-1a, the probe only tells whether the bytes are the same as the journaled ones
+uint64_t probe_hash(const uint8_t* data, size_t size)
+{
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ data[i]) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+} // namespace
 
 DriveEraser::DriveEraser(ErasureMethod erasure_method, 
     DiskType disk_type,
@@ -46,6 +83,7 @@ DriveEraser::DriveEraser(ErasureMethod erasure_method,
         (ErasureMethod::Full, &NativeFileEraser::erase_full)
         (ErasureMethod::Random, &NativeFileEraser::erase_random)
         (ErasureMethod::BeginEnd, &NativeFileEraser::erase_begin_end)
+        (ErasureMethod::Discard, &NativeFileEraser::erase_discard)
         ;
 }
 
@@ -59,7 +97,8 @@ DriveEraser::DriveEraser(
 {
 }
 
-void DriveEraser::submit(const std::wstring& root, const std::wstring& file_path, double entropy)
+void DriveEraser::submit(const std::wstring& root, const std::wstring& file_path, double entropy, int64_t flags /*= 0*/,
+                         std::shared_ptr<const EntropyMap> entropy_map /*= nullptr*/)
 {
     std::lock_guard<std::mutex> l(files_lock_);
     fs::path fs_path(file_path);
@@ -89,8 +128,8 @@ void DriveEraser::submit(const std::wstring& root, const std::wstring& file_path
         return;
     }
 
-    // Flags (3rd param) are not important for cache, so pass 0LL
-    ShredderFileInfo erase_file(file_path, entropy, 0LL);
+    // Flags and entropy map are needed for the erasure strategy
+    ShredderFileInfo erase_file(file_path, entropy, flags, std::move(entropy_map));
     shredded_files_.emplace(std::make_pair(root, std::move(erase_file)));
 }
 
@@ -133,11 +172,18 @@ void DriveEraser::clean()
     shredded_directories_.clear();
 }
 
-void DriveEraser::erase_file(std::wstring file_path, double entropy)
+void DriveEraser::erase_file(ShredderFileInfo erase_info)
 {
+    const std::wstring& file_path = erase_info.path;
     uintmax_t file_size = fs::file_size(file_path);
     ShannonEncryptionChecker::InformationEntropyEstimation file_specific = 
-        ShannonEncryptionChecker::information_entropy_estimation(entropy, file_size);
+        ShannonEncryptionChecker::information_entropy_estimation(erase_info.entropy, file_size);
+
+    // compressed data has entropy of ciphertext, but is not encrypted
+    const bool compressed = erase_info.flags.is_compressed();
+    if (compressed && file_specific == ShannonEncryptionChecker::Encrypted) {
+        file_specific = ShannonEncryptionChecker::Binary;
+    }
 
     // nothing to hide in zero-sized file
     if (file_size == 0) {
@@ -145,13 +191,204 @@ void DriveEraser::erase_file(std::wstring file_path, double entropy)
         return;
     }
 
-    NativeFileEraser native_file_eraser(file_path, file_specific, disk_type_);
-    erasure_type_handler_.call(erasure_method_, &native_file_eraser, gen_.random_sequence(), gen_.random_length());
+    // file overwritten by the interrupted job is only removed, partially overwritten one is resumed
+    ShredderFileIdentity identity;
+    ErasureCheckpoint checkpoint;
+    if (journal_) {
+        identity = ShredderFileIdentity::read(file_path);
+        if (journal_->find_erasure_checkpoint(identity, checkpoint)) {
+            // the node may be reused by another file of the same size, or the file rewritten in place since.
+            // Passes of the job without the scheme are random, they are not resumed either
+            uint64_t probe = 0;
+            if (!erasure_scheme_ || !read_checkpoint_probe(file_path, checkpoint, probe) || probe != checkpoint.probe) {
+                LOG_DEBUG << "Journaled progress does not match the file, erasing from the beginning "
+                          << helpers::wstring_to_utf8(file_path);
+                checkpoint = ErasureCheckpoint();
+            }
+            else if (checkpoint.overwritten) {
+                LOG_DEBUG << "Overwritten by the interrupted job " << helpers::wstring_to_utf8(file_path);
+                cheat_file_node(file_path);
+                return;
+            }
+        }
+    }
+
+    // overwriting SSD does not guarantee much because of remapping, releasing blocks is much faster
+    ErasureMethod erasure_method = erasure_method_;
+    if (erasure_method == ErasureMethod::Smart && disk_type_ == helpers::PartititonInformation::SSD &&
+        FileShredder::is_discard_erase()) {
+        erasure_method = ErasureMethod::Discard;
+    }
+
+    const DurabilityPolicy durability = FileShredder::durability_policy();
+    NativeFileEraser native_file_eraser(file_path, file_specific, disk_type_, durability);
+    if (!compressed) {
+        // high-entropy regions of compressed file are not encrypted either
+        native_file_eraser.set_entropy_map(erase_info.entropy_map);
+    }
+#if defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
+    if (FileShredder::is_direct_io_erase() &&
+        !native_file_eraser.set_direct_io(true, FileShredder::is_direct_io_huge_pages())) {
+        LOG_DEBUG << "Direct I/O is not supported, erasing through the page cache";
+    }
+    if (io_uring_eraser_ && durability != DurabilityPolicy::GroupCommit) {
+        // writes are in flight, the node is renamed meanwhile and unlinked as soon as they complete
+        native_file_eraser.set_io_uring_eraser(io_uring_eraser_);
+        overwrite_passes(native_file_eraser, erasure_method, file_path, identity, checkpoint);
+        fs::path renamed_path;
+        if (rename_file_node(file_path, renamed_path)) {
+            native_file_eraser.close_and_unlink(renamed_path.wstring());
+        }
+        return;
+    }
+    // group commit keeps writes in flight across files, nodes are removed after the filesystem is synced
+    native_file_eraser.set_io_uring_eraser(io_uring_eraser_);
+#endif
+    overwrite_passes(native_file_eraser, erasure_method, file_path, identity, checkpoint);
     native_file_eraser.close();
 
+    if (durability == DurabilityPolicy::GroupCommit) {
+        // removed after the filesystem is synced
+        uncommitted_files_.push_back(file_path);
+        return;
+    }
     cheat_file_node(file_path);
 }
 
+void DriveEraser::overwrite_passes(NativeFileEraser& native_file_eraser, ErasureMethod erasure_method,
+                                   const std::wstring& file_path, const ShredderFileIdentity& identity,
+                                   const ErasureCheckpoint& checkpoint)
+{
+#if defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
+    native_file_eraser.set_verification(nullptr != readback_verifier_);
+#endif
+
+    // the interrupted pass is resumed, unless the scheme has fewer passes since then
+    const unsigned passes_count = erasure_scheme_ ? erasure_scheme_->passes_count() : 1;
+    const unsigned first_pass = (checkpoint.pass < passes_count) ? checkpoint.pass : 0;
+    native_file_eraser.set_resume_offset((checkpoint.pass < passes_count) ? checkpoint.offset : 0);
+
+    // small files are overwritten again rather than journaled, every checkpoint is a database transaction
+    unsigned pass = first_pass;
+    const bool journaled = journal_ && identity.valid && identity.size >= FileShredder::erase_checkpoint_interval();
+    if (journaled) {
+        native_file_eraser.set_checkpoint(FileShredder::erase_checkpoint_interval(), [this, &file_path, &identity, &pass](uint64_t offset) {
+            journal_checkpoint(file_path, identity, { pass, offset, false });
+        });
+    }
+
+    // the file stays open, its extents and buffers are reused by every pass
+    for (; pass < passes_count; ++pass) {
+        if (pass > first_pass) {
+            // otherwise the page cache merges passes, and only the last one reaches the drive
+            if (!native_file_eraser.flush()) {
+                LOG_WARNING << "Unable to flush pass " << pass;
+            }
+            else if (journaled) {
+                journal_checkpoint(file_path, identity, { pass, 0, false });
+            }
+        }
+
+        if (!erasure_scheme_) {
+            erasure_type_handler_.call(erasure_method, &native_file_eraser, gen_.random_sequence(), gen_.random_length());
+        }
+        else {
+            erasure_type_handler_.call(erasure_method, &native_file_eraser,
+                                       erasure_scheme_->pattern(pass), erasure_scheme_->pattern_length());
+        }
+    }
+
+#if defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
+    // read back while the next file is overwritten
+    VerificationJob verification_job;
+    if (readback_verifier_ && native_file_eraser.verification_job(verification_job)) {
+        readback_verifier_->submit(std::move(verification_job));
+    }
+
+    // blocks released by punching holes are trimmed after the drive is erased
+    if (FileShredder::is_discard_trim()) {
+        const std::vector<EraseRange>& released = native_file_eraser.released_extents();
+        released_extents_.insert(released_extents_.end(), released.begin(), released.end());
+    }
+#endif
+}
+
+void DriveEraser::journal_checkpoint(const std::wstring& file_path, const ShredderFileIdentity& identity,
+                                     ErasureCheckpoint checkpoint)
+{
+    // the checkpoint is saved after the flush, the bytes read back are the ones on the drive
+    if (!read_checkpoint_probe(file_path, checkpoint, checkpoint.probe)) {
+        LOG_DEBUG << "Unable to read back the checkpoint of " << helpers::wstring_to_utf8(file_path);
+        return;
+    }
+    journal_->update_erasure_checkpoint(identity, checkpoint);
+}
+
+// static
+bool DriveEraser::read_checkpoint_probe(const std::wstring& file_path, const ErasureCheckpoint& checkpoint, uint64_t& probe)
+{
+    EntropyFileReader reader;
+    if (!reader.open(file_path)) {
+        return false;
+    }
+
+    uint8_t buffer[ErasureCheckpoint::PROBE_SIZE];
+    const uint64_t begin = (checkpoint.offset > ErasureCheckpoint::PROBE_SIZE) ?
+        checkpoint.offset - ErasureCheckpoint::PROBE_SIZE : 0;
+    const size_t length = (checkpoint.offset > 0) ?
+        static_cast<size_t>(checkpoint.offset - begin) : ErasureCheckpoint::PROBE_SIZE;
+    size_t bytes_read = 0;
+    if (!reader.read_at(begin, buffer, length, bytes_read) || (checkpoint.offset > 0 && bytes_read != length)) {
+        return false;
+    }
+    probe = probe_hash(buffer, bytes_read);
+    return true;
+}
+
+void DriveEraser::commit_group(const std::wstring& root)
+{
+#if defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
+    if (io_uring_eraser_ && !io_uring_eraser_->wait_all()) {
+        LOG_WARNING << "Some asynchronous writes have failed";
+    }
+#endif
+    if (!uncommitted_files_.empty() && !NativeFileEraser::sync_filesystem(root)) {
+        // syncing the volume needs administrator rights on Windows, files are flushed one by one then,
+        // and the node of the file that could not be flushed is kept, its old content may be on the drive still
+        LOG_DEBUG << "Unable to sync filesystem " << helpers::wstring_to_utf8(root) << ", flushing files";
+        std::vector<std::wstring> flushed_files;
+        for (const std::wstring& file_path : uncommitted_files_) {
+            if (NativeFileEraser::flush_file(file_path)) {
+                flushed_files.push_back(file_path);
+            }
+            else {
+                LOG_WARNING << "Unable to flush overwritten file, it is not removed " << helpers::wstring_to_utf8(file_path);
+            }
+        }
+        uncommitted_files_.swap(flushed_files);
+    }
+
+    if (journal_ && !uncommitted_files_.empty()) {
+        // the whole group is on the drive, the interrupted job would only remove its nodes
+        std::vector<std::pair<ShredderFileIdentity, ErasureCheckpoint>> checkpoints;
+        for (const std::wstring& file_path : uncommitted_files_) {
+            ErasureCheckpoint overwritten;
+            overwritten.overwritten = true;
+            if (read_checkpoint_probe(file_path, overwritten, overwritten.probe)) {
+                checkpoints.emplace_back(ShredderFileIdentity::read(file_path), overwritten);
+            }
+        }
+        if (!journal_->update_erasure_checkpoints(checkpoints)) {
+            LOG_DEBUG << "Unable to journal overwritten files of " << helpers::wstring_to_utf8(root);
+        }
+    }
+
+    for (const std::wstring& file_path : uncommitted_files_) {
+        cheat_file_node(file_path);
+    }
+    uncommitted_files_.clear();
+}
+
 bool DriveEraser::already_exist(const std::wstring& root, const std::wstring& file_path)
 {
     fs::path fs_path(file_path);
@@ -179,32 +416,101 @@ bool DriveEraser::already_exist(const std::wstring& root, const std::wstring& fi
     return false;
 }
 
-void DriveEraser::shred_files()
+std::vector<std::wstring> DriveEraser::shred_files(std::shared_ptr<const ErasureScheme> erasure_scheme /*= nullptr*/,
+                                                   ShredderDatabaseWrapper* journal /*= nullptr*/)
 {
+    std::vector<std::wstring> unverified_files;
     std::lock_guard<std::mutex> l(files_lock_);
+    erasure_scheme_ = std::move(erasure_scheme);
+    journal_ = journal;
+
+#if defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
+    // writes of all files on the drive share one queue
+    IoUringEraser io_uring_eraser;
+    if (FileShredder::is_async_erase() &&
+        io_uring_eraser.init(FileShredder::erase_queue_depth(), IoUringEraser::DEFAULT_BLOCK_SIZE,
+                             FileShredder::is_direct_io_huge_pages())) {
+        io_uring_eraser_ = &io_uring_eraser;
+    }
+
+    // files are read back in a separate thread
+    std::unique_ptr<ReadBackVerifier> readback_verifier;
+    if (FileShredder::is_verify_erase()) {
+        readback_verifier = std::make_unique<ReadBackVerifier>();
+        readback_verifier_ = readback_verifier.get();
+    }
 
-    std::for_each(shredded_files_.begin(), shredded_files_.end(),
-        [this](std::pair<const std::wstring, shredder::ShredderFileInfo>& erase_info) {
+    // ranges released on every partition, pair is <root, ranges>
+    std::map<std::wstring, std::vector<EraseRange>> released_extents;
+#endif
 
-        helpers::thread_pool eraser;
-        // debug switch between multi-thread and single-thread erasure
-#ifdef DEBUG_MULTITHREAD_ERASE
-        if (FileShredder::is_multithreaded_erase()) {
+    // files are grouped by partition root, so that the group commit syncs every filesystem once
+    for (auto group = shredded_files_.begin(); group != shredded_files_.end(); ) {
+        auto group_end = shredded_files_.upper_bound(group->first);
+        std::for_each(group, group_end,
+            [this](std::pair<const std::wstring, shredder::ShredderFileInfo>& erase_info) {
 
-            if (disk_type_ == helpers::PartititonInformation::SSD) {
-                eraser.enqueue(&DriveEraser::erase_file, this, erase_info.second.path, erase_info.second.entropy);
+            helpers::thread_pool eraser;
+            // debug switch between multi-thread and single-thread erasure
+#ifdef DEBUG_MULTITHREAD_ERASE
+            if (FileShredder::is_multithreaded_erase()) {
+
+                if (disk_type_ == helpers::PartititonInformation::SSD) {
+                    eraser.enqueue(&DriveEraser::erase_file, this, erase_info.second);
+                }
+                else {
+                    erase_file(erase_info.second);
+                }
             }
             else {
-                erase_file(erase_info.second.path, erase_info.second.entropy);
+                erase_file(erase_info.second);
             }
+#else
+            erase_file(erase_info.second);
+#endif
+        });
+
+        if (FileShredder::durability_policy() == DurabilityPolicy::GroupCommit) {
+            commit_group(group->first);
         }
-        else {
-            erase_file(erase_info.second.path, erase_info.second.entropy);
+#if defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
+        if (!released_extents_.empty()) {
+            released_extents[group->first] = std::move(released_extents_);
+            released_extents_.clear();
         }
-#else
-        erase_file(erase_info.second.path, erase_info.second.entropy);
 #endif
-    });
+        group = group_end;
+    }
+
+#if defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
+    // directories are removed after files are unlinked
+    if (io_uring_eraser_ && !io_uring_eraser.wait_all()) {
+        LOG_WARNING << "Some asynchronous writes have failed";
+    }
+    io_uring_eraser_ = nullptr;
+
+    if (readback_verifier_) {
+        for (const std::string& failed_file : readback_verifier_->wait()) {
+            LOG_WARNING << "Overwrite is not verified: " << failed_file;
+            unverified_files.push_back(helpers::utf8_to_wstring(failed_file));
+        }
+    }
+    readback_verifier_ = nullptr;
+#endif
+
+#if defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
+    // released blocks are trimmed now, filesystems mounted with discard have done it already
+    for (const auto& root_extents : released_extents) {
+        if (!NativeFileEraser::trim_filesystem(root_extents.first, root_extents.second)) {
+            LOG_DEBUG << "Unable to trim filesystem " << helpers::wstring_to_utf8(root_extents.first);
+        }
+    }
+    released_extents_.clear();
+#endif
+
+    // patterns are not used by writes in flight anymore
+    erasure_scheme_.reset();
+    journal_ = nullptr;
 
 
     std::for_each(shredded_directories_.begin(), shredded_directories_.end(),
@@ -250,9 +556,47 @@ void DriveEraser::shred_files()
             NativeFileEraser::clean_ntfs_journal(c); 
         });
     }
+    return unverified_files;
 }
 
 bool shredder::DriveEraser::cheat_file_node(const std::wstring& file_path)
+{
+    fs::path old_path;
+    if (!rename_file_node(file_path, old_path)) {
+        return false;
+    }
+
+#if defined(_WIN32) || defined(_WIN64)
+    fs::path recycle_bin = old_path.root_path() / "$Recycle.Bin";
+    fs::path final_path = recycle_bin / "892F575F-DE37-4A0F-8A3E-427618C7D64C.tmp";
+    bs::error_code ec;
+    fs::rename(old_path, final_path, ec);
+    if (ec) {
+        LOG_DEBUG << "fs::rename returned err = " << ec.value() << " [" << ec.message() << "]";
+        return false;
+    }
+
+    if (!fs::remove(final_path, ec)) {
+        LOG_DEBUG << "fs::rename returned err = " << ec.value() << " [" << ec.message() << "]";
+        return false;
+    }
+#else
+    // no recycle bin, the renamed and truncated node is unlinked in place,
+    // a file being read back is truncated by the verifier after it is verified
+    bs::error_code ec;
+    if (!readback_verifier_) {
+        fs::resize_file(old_path, 0, ec);
+    }
+    if (!fs::remove(old_path, ec)) {
+        LOG_DEBUG << "fs::remove returned err = " << ec.value() << " [" << ec.message() << "]";
+        return false;
+    }
+#endif
+
+    return true;
+}
+
+bool shredder::DriveEraser::rename_file_node(const std::wstring& file_path, boost::filesystem::path& renamed_path)
 {
     fs::path old_path = file_path;
     fs::path directory_path = old_path.parent_path();
@@ -261,9 +605,21 @@ bool shredder::DriveEraser::cheat_file_node(const std::wstring& file_path)
     size_t name_length = file_name.size();
 
     for (char c : pattern) {
-        string new_name(name_length, c);
-        fs::path new_path = directory_path / new_name;
+        // renamed nodes of several files may wait for the asynchronous unlink in one directory at once
+        fs::path new_path;
         bs::error_code ec;
+        for (int attempt = 0; attempt < MAX_RENAME_ATTEMPTS; ++attempt) {
+            new_path = directory_path / unique_node_name(c, name_length);
+            if (fs::symlink_status(new_path, ec).type() == fs::file_not_found) {
+                break;
+            }
+            new_path.clear();
+        }
+        if (new_path.empty()) {
+            LOG_DEBUG << "No free name to rename " << helpers::wstring_to_utf8(file_path);
+            return false;
+        }
+
         fs::rename(old_path, new_path, ec);
         if (ec) {
             LOG_DEBUG << "fs::rename returned err = " << ec.value() << " [" << ec.message() << "]";
@@ -273,21 +629,7 @@ bool shredder::DriveEraser::cheat_file_node(const std::wstring& file_path)
         old_path = new_path;
     }
 
-
-    fs::path recycle_bin = old_path.root_path() / "$Recycle.Bin";
-    fs::path final_path = recycle_bin / "892F575F-DE37-4A0F-8A3E-427618C7D64C.tmp";
-    bs::error_code ec;
-    fs::rename(old_path, final_path, ec);
-    if (ec) {
-        LOG_DEBUG << "fs::rename returned err = " << ec.value() << " [" << ec.message() << "]";
-        return false;
-    }
-
-    if (!fs::remove(final_path, ec)) {
-        LOG_DEBUG << "fs::rename returned err = " << ec.value() << " [" << ec.message() << "]";
-        return false;
-    }
-
+    renamed_path = old_path;
     return true;
 }
 
@@ -1,18 +1,310 @@
 #include <eraser/encryption_checker.h>
+#include <eraser/byte_histogram.h>
+#include <eraser/cancellation_token.h>
+#include <eraser/content_signature.h>
+#include <eraser/content_statistics.h>
+#include <eraser/entropy_file_reader.h>
+#include <eraser/entropy_map.h>
+#include <eraser/histogram_kernels.h>
+#include <eraser/io_uring_queue.h>
 #include <winapi-helpers/uint8_codecvt.h>
 #include <sstream>
-#include <fstream>
+#include <algorithm>
 #include <cassert>
 #include <stdexcept>
 #include <filesystem>
+#include <random>
+#include <array>
+#include <map>
+#include <numeric>
+#include <chrono>
+#include <type_traits>
 
 using namespace std;
 using namespace shredder;
 
 namespace fs = std::filesystem;
 
+namespace {
+
+/// Miller-Madow bias correction, plug-in estimate is lower by (m - 1) / (2 * N * ln(2)),
+/// where m is the number of non-empty bins
+double corrected_entropy(const uint64_t* counters, uintmax_t total)
+{
+    if (0 == total) {
+        return 0.0;
+    }
+
+    size_t nonzero_bins = std::count_if(counters, counters + ByteHistogram::BINS_COUNT, [](uint64_t c) { return c > 0; });
+    double entropy = histogram_entropy(counters, ByteHistogram::BINS_COUNT, total);
+    return entropy + static_cast<double>(nonzero_bins - 1) / (2.0 * static_cast<double>(total) * std::log(2.0));
+}
+
+/// Progress sink of the scan without callback, compiles to nothing
+struct NoProgress
+{
+    void update(uintmax_t) {}
+    void finish(uintmax_t) {}
+};
+
+/// Progress sink calling the callback once per percent of bytes or per time interval,
+/// so that the virtual call and the UI update do not depend on the block size
+class ThrottledProgress
+{
+public:
+
+    using clock = std::chrono::steady_clock;
+
+    ThrottledProgress(IShredderCallback* callback, uintmax_t total_size, uintmax_t steps_count, clock::duration interval) :
+        callback_(callback),
+        bytes_step_(std::max<uintmax_t>(total_size / steps_count, 1)),
+        next_bytes_(bytes_step_),
+        interval_(interval),
+        next_time_(clock::now() + interval)
+    {
+        callback_->init(total_size);
+    }
+
+    void update(uintmax_t bytes_done)
+    {
+        if (bytes_done >= next_bytes_ || clock::now() >= next_time_) {
+            report(bytes_done);
+        }
+    }
+
+    void finish(uintmax_t bytes_done)
+    {
+        if (bytes_done != reported_) {
+            report(bytes_done);
+        }
+    }
+
+private:
+
+    void report(uintmax_t bytes_done)
+    {
+        callback_->set_value(bytes_done);
+        reported_ = bytes_done;
+        next_bytes_ = bytes_done + bytes_step_;
+        next_time_ = clock::now() + interval_;
+    }
+
+    IShredderCallback* callback_;
+    uintmax_t bytes_step_;
+    uintmax_t next_bytes_;
+    uintmax_t reported_{};
+    clock::duration interval_;
+    clock::time_point next_time_;
+};
+
+/// Sequential blocks of the file range read into the heap buffer
+class BufferedBlocks
+{
+public:
+
+    BufferedBlocks(EntropyFileReader& file, uintmax_t offset, uintmax_t length, size_t block_size) :
+        file_(file),
+        offset_(offset),
+        range_end_(offset + length),
+        buffer_(block_size)
+    {
+    }
+
+    bool next_block(const uint8_t*& block_start, size_t& block_size)
+    {
+        block_start = buffer_.data();
+        block_size = 0;
+        if (offset_ >= range_end_) {
+            return true;
+        }
+
+        // file became shorter during the scan, the block is shorter or empty
+        size_t read_size = static_cast<size_t>(std::min<uintmax_t>(range_end_ - offset_, buffer_.size()));
+        if (!file_.read_at(offset_, buffer_.data(), read_size, block_size)) {
+            return false;
+        }
+        offset_ = (block_size < read_size) ? range_end_ : offset_ + block_size;
+        return true;
+    }
+
+private:
+
+    EntropyFileReader& file_;
+    uintmax_t offset_;
+    uintmax_t range_end_;
+    std::vector<uint8_t> buffer_;
+};
+
+/// Blocks of the file read asynchronously, in completion or file order as the reading was started
+class AsyncBlocks
+{
+public:
+
+    explicit AsyncBlocks(EntropyFileReader& file) :
+        file_(file)
+    {
+    }
+
+    bool next_block(const uint8_t*& block_start, size_t& block_size)
+    {
+        return file_.next_async_block(block_start, block_size);
+    }
+
+private:
+
+    EntropyFileReader& file_;
+};
+
+/// Blocks of the file range mapped by windows, only one window is mapped at a time.
+/// The range offset must be multiple of the page size
+class MappedBlocks
+{
+public:
+
+    MappedBlocks(EntropyFileReader& file, uintmax_t offset, uintmax_t length, size_t window_size, size_t block_size) :
+        file_(file),
+        range_end_(offset + length),
+        max_window_size_(window_size),
+        block_size_(block_size),
+        window_offset_(offset)
+    {
+    }
+
+    ~MappedBlocks()
+    {
+        file_.unmap_window(window_start_, window_size_);
+    }
+
+    MappedBlocks(const MappedBlocks&) = delete;
+    MappedBlocks& operator=(const MappedBlocks&) = delete;
+
+    bool next_block(const uint8_t*& block_start, size_t& block_size)
+    {
+        block_size = 0;
+        if (block_offset_ >= window_size_) {
+            // unmap as we go, address space stays bounded by one window
+            file_.unmap_window(window_start_, window_size_);
+            window_start_ = nullptr;
+            window_offset_ += window_size_;
+            window_size_ = 0;
+            block_offset_ = 0;
+            if (window_offset_ >= range_end_) {
+                return true;
+            }
+
+            size_t window_size = static_cast<size_t>(std::min<uintmax_t>(range_end_ - window_offset_, max_window_size_));
+            window_start_ = file_.map_window(window_offset_, window_size);
+            if (nullptr == window_start_) {
+                return false;
+            }
+            window_size_ = window_size;
+        }
+
+        // walk the window by blocks, so that interruption and progress work as in buffered mode
+        block_start = window_start_ + block_offset_;
+        block_size = std::min(window_size_ - block_offset_, block_size_);
+        block_offset_ += block_size;
+        return true;
+    }
+
+private:
+
+    EntropyFileReader& file_;
+    uintmax_t range_end_;
+    size_t max_window_size_;
+    size_t block_size_;
+    const uint8_t* window_start_{};
+    uintmax_t window_offset_;
+    size_t window_size_{};
+    size_t block_offset_{};
+};
+
+/// Counter building the entropy map of consecutive regions along with the whole sequence counter
+template <typename BlockCounter>
+class EntropyMapCounter
+{
+public:
+
+    EntropyMapCounter(BlockCounter& counter, EntropyMap& entropy_map) :
+        counter_(counter),
+        entropy_map_(entropy_map)
+    {
+    }
+
+    void update(const uint8_t* block_start, size_t block_size)
+    {
+        while (block_size > 0) {
+            size_t part_size = static_cast<size_t>(std::min<uint64_t>(block_size, entropy_map_.region_size() - region_.total()));
+            region_.update(block_start, part_size);
+            if constexpr (!std::is_same_v<BlockCounter, ByteHistogram>) {
+                counter_.update(block_start, part_size);
+            }
+            block_start += part_size;
+            block_size -= part_size;
+
+            if (region_.total() == entropy_map_.region_size()) {
+                flush();
+            }
+        }
+    }
+
+    /// Incomplete region at the end of the sequence
+    void finish()
+    {
+        if (region_.total() > 0) {
+            flush();
+        }
+    }
+
+private:
+
+    void flush()
+    {
+        entropy_map_.push_back(region_.entropy());
+        // bytes are not counted twice, region histogram is simply added to the whole one
+        if constexpr (std::is_same_v<BlockCounter, ByteHistogram>) {
+            counter_.merge(region_);
+        }
+        region_.clear();
+    }
+
+    BlockCounter& counter_;
+    EntropyMap& entropy_map_;
+    ByteHistogram region_;
+};
+
+/// Blocks of the sequence in memory
+class SequenceBlocks
+{
+public:
+
+    SequenceBlocks(const uint8_t* sequence_start, uintmax_t sequence_size, size_t block_size) :
+        sequence_start_(sequence_start),
+        sequence_size_(sequence_size),
+        block_size_(block_size)
+    {
+    }
+
+    bool next_block(const uint8_t*& block_start, size_t& block_size)
+    {
+        block_start = sequence_start_ + offset_;
+        block_size = static_cast<size_t>(std::min<uintmax_t>(sequence_size_ - offset_, block_size_));
+        offset_ += block_size;
+        return true;
+    }
+
+private:
+
+    const uint8_t* sequence_start_;
+    uintmax_t sequence_size_;
+    size_t block_size_;
+    uintmax_t offset_{};
+};
+
+} // namespace
+
 bool ShannonEncryptionChecker::load_uint8_codecvt_;
-bool ShannonEncryptionChecker::interrupt_all_ = false;
+std::atomic<bool> ShannonEncryptionChecker::interrupt_all_{ false };
 
 
 std::map<ShannonEncryptionChecker::InformationEntropyEstimation, std::string>
@@ -37,23 +329,403 @@ void ShannonEncryptionChecker::set_callback(IShredderCallback* callback)
     callback_ = callback;
 }
 
+void ShannonEncryptionChecker::set_scan_mode(FileScanMode scan_mode)
+{
+    scan_mode_ = scan_mode;
+}
+
+void ShannonEncryptionChecker::set_async_queue_depth(unsigned queue_depth)
+{
+    assert(queue_depth > 0);
+    async_queue_depth_ = std::max(queue_depth, 1u);
+}
+
+void ShannonEncryptionChecker::set_entropy_map(EntropyMap* entropy_map)
+{
+    entropy_map_ = entropy_map;
+}
+
+void ShannonEncryptionChecker::set_cancellation_token(std::shared_ptr<const CancellationToken> cancellation_token)
+{
+    cancellation_token_ = std::move(cancellation_token);
+}
+
 double ShannonEncryptionChecker::get_file_entropy(std::wstring file_path) const
 {
     uintmax_t file_size = fs::file_size(file_path);
-    std::vector<double> byte_probabilities = read_file_probabilities(file_path, file_size);
-    if (byte_probabilities.empty()) {
+
+    // entropy of zero-sized file is 0
+    if (0 == file_size) {
+        return 0.0;
+    }
+
+    ByteHistogram histogram;
+    if (!file_probabilities(file_path, 0, file_size, histogram)) {
         return -1.0;
     }
-    return shannon_entropy(byte_probabilities.begin(), byte_probabilities.end());
+    return histogram.entropy();
+}
+
+ShannonEncryptionChecker::ContentClassification ShannonEncryptionChecker::get_file_classification(std::wstring file_path) const
+{
+    ContentClassification classification;
+    uintmax_t file_size = fs::file_size(file_path);
+    if (0 == file_size) {
+        classification.entropy = 0.0;
+        classification.estimation = Plain;
+        return classification;
+    }
+
+    ContentStatistics statistics;
+    if (!file_probabilities(file_path, 0, file_size, statistics)) {
+        return classification;
+    }
+    classify_statistics(statistics, file_size, classification);
+    return classification;
+}
+
+void ShannonEncryptionChecker::set_sampling(size_t blocks_count, size_t block_size)
+{
+    assert(blocks_count > 1 && block_size > 0);
+    sample_blocks_count_ = std::max<size_t>(blocks_count, 2);
+    sample_block_size_ = std::max<size_t>(block_size, 1);
+}
+
+void ShannonEncryptionChecker::set_signature_confirmation(size_t blocks_count)
+{
+    signature_confirmation_blocks_ = blocks_count;
+}
+
+bool ShannonEncryptionChecker::get_signature_classification(std::wstring file_path, ContentClassification& classification) const
+{
+    EntropyFileReader file;
+    if (!file.open(file_path)) {
+        return false;
+    }
+
+    uint8_t header[ContentSignature::HEADER_SIZE]{};
+    size_t header_size{};
+    if (!file.read_at(0, header, sizeof(header), header_size)) {
+        return false;
+    }
+    file.close();
+
+    const ContentSignature::ContainerType container = ContentSignature::detect(header, header_size);
+    if (ContentSignature::Unknown == container) {
+        return false;
+    }
+
+    // Nominal entropy of the strong archive or media signature, so that the stored value leads erasure to the same class.
+    // Encrypted containers and weak signatures are always confirmed by the sample, e.g. the GPG packet header
+    // matches a random binary now and then, and only the sampled entropy is stored for them
+    const bool encrypted = ContentSignature::is_encrypted(container);
+    double entropy = 8.0;
+    uintmax_t sample_size = header_size;
+
+    size_t confirmation_blocks = signature_confirmation_blocks_;
+    if (0 == confirmation_blocks && (encrypted || ContentSignature::is_weak(container))) {
+        confirmation_blocks = SIGNATURE_CONFIRMATION_BLOCKS;
+    }
+    if (confirmation_blocks) {
+        ShannonEncryptionChecker sampler;
+        sampler.set_cancellation_token(cancellation_token_);
+        sampler.set_sampling(std::max<size_t>(confirmation_blocks, 2), SAMPLE_BLOCK_SIZE);
+        EntropyEstimate estimate = sampler.get_sampled_file_entropy(file_path);
+        if (estimate.entropy < 0.0 || Plain == estimate.estimation) {
+            return false;
+        }
+        // ciphertext is not told by the header, the file goes to the regular scan
+        if (encrypted && Encrypted != estimate.estimation) {
+            return false;
+        }
+        entropy = estimate.entropy;
+        sample_size = estimate.sample_size;
+    }
+
+    classification = ContentClassification();
+    classification.entropy = entropy;
+    classification.sample_size = sample_size;
+    classification.random = encrypted;
+    classification.compressed = !encrypted;
+    classification.estimation = encrypted ? Encrypted : Binary;
+    return true;
+}
+
+ShannonEncryptionChecker::EntropyEstimate ShannonEncryptionChecker::get_sampled_file_entropy(std::wstring file_path) const
+{
+    EntropyEstimate estimate;
+    estimate.file_size = fs::file_size(file_path);
+
+    // small file, sample would cover it anyway
+    const uintmax_t sample_budget = static_cast<uintmax_t>(sample_blocks_count_) * sample_block_size_;
+    if (estimate.file_size <= sample_budget) {
+        estimate.entropy = get_file_entropy(file_path);
+        estimate.lower_bound = estimate.upper_bound = estimate.entropy;
+        estimate.sample_size = estimate.file_size;
+        estimate.estimation = information_entropy_estimation(estimate.entropy, estimate.file_size);
+        return estimate;
+    }
+
+    return sample_file_entropy(file_path, nullptr);
+}
+
+ShannonEncryptionChecker::ContentClassification ShannonEncryptionChecker::get_sampled_file_classification(std::wstring file_path) const
+{
+    const uintmax_t sample_budget = static_cast<uintmax_t>(sample_blocks_count_) * sample_block_size_;
+    if (fs::file_size(file_path) <= sample_budget) {
+        return get_file_classification(file_path);
+    }
+
+    ContentClassification classification;
+    ContentStatistics statistics;
+    EntropyEstimate estimate = sample_file_entropy(file_path, &statistics);
+    if (estimate.entropy < 0.0) {
+        return classification;
+    }
+
+    // randomness tests of the sample, entropy and its class are those of the whole file estimate
+    classify_statistics(statistics, estimate.sample_size, classification);
+    classification.entropy = estimate.entropy;
+    classification.compressed = false;
+    classification.estimation = estimate.estimation;
+    if (classification.estimation == Encrypted && !classification.random) {
+        classification.estimation = Binary;
+        classification.compressed = true;
+    }
+    return classification;
+}
+
+ShannonEncryptionChecker::EntropyEstimate ShannonEncryptionChecker::sample_file_entropy(const std::wstring& file_path, ContentStatistics* statistics) const
+{
+    EntropyEstimate estimate;
+    estimate.file_size = fs::file_size(file_path);
+    const uintmax_t sample_budget = static_cast<uintmax_t>(sample_blocks_count_) * sample_block_size_;
+
+    EntropyFileReader file;
+    if (!file.open(file_path)) {
+        return estimate;
+    }
+
+    if (callback_) {
+        callback_->init(sample_budget);
+    }
+
+    // stratified sample: one block at random aligned position inside every stratum,
+    // so that the whole file is covered evenly
+    std::mt19937_64 generator(std::random_device{}());
+    const uintmax_t stratum_size = estimate.file_size / sample_blocks_count_;
+    std::uniform_int_distribution<uintmax_t> position(0, stratum_size - sample_block_size_);
+
+    std::vector<uint8_t> read_buffer(sample_block_size_);
+    std::vector<ByteHistogram> block_histograms(sample_blocks_count_);
+    std::map<uintmax_t, ByteHistogram> region_histograms;
+    uintmax_t bytes_sampled{};
+    for (size_t block = 0; block < sample_blocks_count_; ++block) {
+        if (is_interrupted()) {
+            return estimate;
+        }
+
+        uintmax_t offset = block * stratum_size + position(generator);
+        offset -= offset % SAMPLE_BLOCK_ALIGNMENT;
+
+        size_t bytes_read{};
+        if (!file.read_at(offset, read_buffer.data(), read_buffer.size(), bytes_read)) {
+            return estimate;
+        }
+        block_histograms[block].update(read_buffer.data(), bytes_read);
+        if (statistics) {
+            statistics->update(read_buffer.data(), bytes_read);
+        }
+        if (entropy_map_) {
+            // the block may cross the region boundary
+            const uint64_t region_size = entropy_map_->region_size();
+            for (size_t part = 0; part < bytes_read; ) {
+                uintmax_t region = (offset + part) / region_size;
+                size_t part_size = static_cast<size_t>(std::min<uintmax_t>(bytes_read - part, (region + 1) * region_size - offset - part));
+                region_histograms[region].update(read_buffer.data() + part, part_size);
+                part += part_size;
+            }
+        }
+        bytes_sampled += bytes_read;
+
+        if (callback_) {
+            callback_->set_value(bytes_sampled);
+        }
+    }
+
+    // blocks are the independent units of the sample (bytes inside one block are correlated)
+    jackknife_estimate(block_histograms, estimate);
+    estimate.sample_size = bytes_sampled;
+    estimate.sampled = true;
+
+    // classified as the whole file, the same way erasure does using stored entropy
+    estimate.estimation = information_entropy_estimation(estimate.entropy, estimate.file_size);
+
+    // regions never sampled are as good as the whole file estimate
+    if (entropy_map_) {
+        entropy_map_->clear();
+        const uintmax_t regions_count = (estimate.file_size + entropy_map_->region_size() - 1) / entropy_map_->region_size();
+        for (uintmax_t region = 0; region < regions_count; ++region) {
+            auto it = region_histograms.find(region);
+            entropy_map_->push_back(it != region_histograms.end() ? it->second.entropy() : estimate.entropy);
+        }
+    }
+    return estimate;
+}
+
+ShannonEncryptionChecker::EntropyEstimate ShannonEncryptionChecker::classify_file_entropy(std::wstring file_path) const
+{
+    EntropyEstimate estimate;
+    estimate.file_size = fs::file_size(file_path);
+
+    EntropyFileReader file;
+    if (!file.open(file_path)) {
+        return estimate;
+    }
+
+    if (callback_) {
+        callback_->init(estimate.file_size);
+    }
+
+    // Blocks are visited in bit-reversed order (van der Corput sequence), so that every prefix
+    // of the scan is spread evenly over the file, and a plain header of an encrypted container
+    // can not stop the scan early. Without early stop every block is read exactly once.
+    const uintmax_t blocks_count = (estimate.file_size + CLASSIFY_BLOCK_SIZE - 1) / CLASSIFY_BLOCK_SIZE;
+    unsigned order_bits = 0;
+    while ((uintmax_t(1) << order_bits) < blocks_count) {
+        ++order_bits;
+    }
+    auto sequence_block = [order_bits](uintmax_t sequence) {
+        uintmax_t block = 0;
+        for (unsigned bit = 0; bit < order_bits; ++bit) {
+            block |= ((sequence >> bit) & 1) << (order_bits - 1 - bit);
+        }
+        return block;
+    };
+
+    // scattered blocks are not read ahead one by one, blocks up to the next check are requested at once,
+    // so that the drive reads them in the file order instead of seeking for every block
+    file.advise_random();
+    uintmax_t prefetched_sequence{};
+
+    std::vector<uint8_t> read_buffer(CLASSIFY_BLOCK_SIZE);
+    std::vector<ByteHistogram> groups(CLASSIFY_GROUPS_COUNT);
+    uintmax_t bytes_scanned{};
+    uintmax_t next_check = CLASSIFY_MIN_SIZE;
+    uintmax_t blocks_visited{};
+
+    for (uintmax_t sequence = 0; sequence < (uintmax_t(1) << order_bits); ++sequence) {
+        if (is_interrupted()) {
+            return estimate;
+        }
+
+        if (sequence == prefetched_sequence) {
+            const uintmax_t blocks_to_check = (next_check > bytes_scanned) ?
+                (next_check - bytes_scanned + CLASSIFY_BLOCK_SIZE - 1) / CLASSIFY_BLOCK_SIZE : 1;
+            const uintmax_t prefetch_blocks = std::min(blocks_to_check, CLASSIFY_PREFETCH_BLOCKS);
+            for (uintmax_t requested = 0; requested < prefetch_blocks && prefetched_sequence < (uintmax_t(1) << order_bits); ++prefetched_sequence) {
+                uintmax_t prefetched_block = sequence_block(prefetched_sequence);
+                if (prefetched_block < blocks_count) {
+                    file.prefetch(prefetched_block * CLASSIFY_BLOCK_SIZE, CLASSIFY_BLOCK_SIZE);
+                    ++requested;
+                }
+            }
+        }
+
+        uintmax_t block = sequence_block(sequence);
+        if (block >= blocks_count) {
+            continue;
+        }
+
+        size_t bytes_read{};
+        if (!file.read_at(block * CLASSIFY_BLOCK_SIZE, read_buffer.data(), read_buffer.size(), bytes_read)) {
+            return estimate;
+        }
+
+        // consecutive blocks are far from each other in the file, so groups are nearly independent
+        groups[blocks_visited % groups.size()].update(read_buffer.data(), bytes_read);
+        bytes_scanned += bytes_read;
+        ++blocks_visited;
+
+        if (callback_) {
+            callback_->set_value(bytes_scanned);
+        }
+
+        if (bytes_scanned >= next_check && blocks_visited < blocks_count) {
+            // check points become rarer as the sample grows, jackknife cost stays negligible
+            next_check = bytes_scanned + std::min(bytes_scanned, CLASSIFY_MAX_CHECK_INTERVAL);
+            jackknife_estimate(groups, estimate);
+            if (classification_settled(estimate)) {
+                estimate.sample_size = bytes_scanned;
+                estimate.sampled = true;
+                estimate.estimation = information_entropy_estimation(estimate.entropy, estimate.file_size);
+                return estimate;
+            }
+        }
+    }
+
+    // the whole file has been read, exact value
+    ByteHistogram pooled;
+    for (const ByteHistogram& group : groups) {
+        pooled.merge(group);
+    }
+    estimate.entropy = estimate.lower_bound = estimate.upper_bound = pooled.entropy();
+    estimate.sample_size = bytes_scanned;
+    estimate.sampled = false;
+    estimate.estimation = information_entropy_estimation(estimate.entropy, estimate.file_size);
+    return estimate;
+}
+
+bool ShannonEncryptionChecker::get_file_range_histogram(const std::wstring& file_path, uintmax_t offset, uintmax_t length, ByteHistogram& histogram) const
+{
+    return file_probabilities(file_path, offset, length, histogram);
+}
+
+bool ShannonEncryptionChecker::get_file_range_statistics(const std::wstring& file_path, uintmax_t offset, uintmax_t length, ContentStatistics& statistics) const
+{
+    return file_probabilities(file_path, offset, length, statistics);
+}
+
+ShannonEncryptionChecker::ContentClassification ShannonEncryptionChecker::get_statistics_classification(const ContentStatistics& statistics)
+{
+    ContentClassification classification;
+    if (0 == statistics.total()) {
+        classification.entropy = 0.0;
+        classification.estimation = Plain;
+        return classification;
+    }
+    classify_statistics(statistics, statistics.total(), classification);
+    return classification;
 }
 
 double ShannonEncryptionChecker::get_sequence_entropy(const uint8_t* sequence_start, size_t sequence_size) const
 {
-    std::vector<double> byte_probabilities = read_stream_probabilities(sequence_start, sequence_size);
-    if(byte_probabilities.empty()) {
+    if (0 == sequence_size) {
+        return 0.0;
+    }
+
+    ByteHistogram histogram;
+    if (!stream_probabilities(sequence_start, sequence_size, histogram)) {
         return -1.0;
     }
-    return shannon_entropy(byte_probabilities.begin(), byte_probabilities.end());
+    return histogram.entropy();
+}
+
+ShannonEncryptionChecker::ContentClassification ShannonEncryptionChecker::get_sequence_classification(const uint8_t* sequence_start, size_t sequence_size) const
+{
+    ContentClassification classification;
+    if (0 == sequence_size) {
+        classification.entropy = 0.0;
+        classification.estimation = Plain;
+        return classification;
+    }
+
+    ContentStatistics statistics;
+    if (!stream_probabilities(sequence_start, sequence_size, statistics)) {
+        return classification;
+    }
+    classify_statistics(statistics, sequence_size, classification);
+    return classification;
 }
 
 ShannonEncryptionChecker::InformationEntropyEstimation
@@ -95,176 +767,237 @@ std::string ShannonEncryptionChecker::get_information_description(InformationEnt
 
 void ShannonEncryptionChecker::interrupt(bool interrupt_flag)
 {
-    interrupt_all_ = interrupt_flag;
+    interrupt_all_.store(interrupt_flag, std::memory_order_relaxed);
 }
 
-std::vector<double> ShannonEncryptionChecker::read_file_probabilities(const std::wstring& file_path, uintmax_t file_size) const
+bool ShannonEncryptionChecker::is_interrupted() const
 {
-    // probability of every byte of zero-sized file is 0
-    if (0 == file_size) {
-        return std::vector<double>(256);
-    }
-
-    std::vector<double> bytes_frequencies(256);
-    std::vector<size_t> bytes_distribution;
-    if (callback_) {
-        bytes_distribution = file_probabilities_observed(file_path, file_size);
-    }
-    else {
-        bytes_distribution = file_probabilities_fast(file_path, file_size);
-    }
+    return interrupt_all_.load(std::memory_order_relaxed) || (cancellation_token_ && cancellation_token_->is_cancelled());
+}
 
-    for (size_t i = 0; i != 256; ++i) {
-        if (interrupt_all_) {
-            return std::vector<double>{};
+template <typename BlockSource, typename BlockCounter, typename ProgressSink>
+bool ShannonEncryptionChecker::count_blocks(BlockSource& source, BlockCounter& counter, ProgressSink& progress) const
+{
+    const uint8_t* block_start{};
+    size_t block_size{};
+    uintmax_t bytes_done{};
+    for (;;) {
+        if (is_interrupted()) {
+            return false;
         }
 
-        bytes_frequencies[i] = static_cast<double>(bytes_distribution[i]) / file_size;
+        if (!source.next_block(block_start, block_size)) {
+            return false;
+        }
+        if (0 == block_size) {
+            break;
+        }
+        counter.update(block_start, block_size);
+        bytes_done += block_size;
+        progress.update(bytes_done);
     }
-
-    return std::move(bytes_frequencies);
+    progress.finish(bytes_done);
+    return true;
 }
 
-std::vector<size_t> ShannonEncryptionChecker::file_probabilities_fast(const std::wstring& file_path, uintmax_t file_size) const
+template <typename BlockSource, typename BlockCounter>
+bool ShannonEncryptionChecker::scan_blocks(BlockSource& source, uintmax_t total_size, BlockCounter& counter) const
 {
-    assert(callback_ == nullptr);
-#if defined(_WIN32) || defined(_WIN64)
-    std::basic_ifstream<uint8_t, std::char_traits<uint8_t>> file(file_path, std::ios::in | std::ios::binary);
-#else
-    std::basic_ifstream<uint8_t, std::char_traits<uint8_t>> file(helpers::wstring_to_string(file_path), std::ios::in | std::ios::binary);
-#endif
-    if (!file.is_open()) {
-        return std::vector<size_t>{};
+    if (callback_) {
+        ThrottledProgress progress(callback_, total_size, PROGRESS_STEPS_COUNT, std::chrono::milliseconds(PROGRESS_INTERVAL_MS));
+        return count_blocks(source, counter, progress);
     }
+    NoProgress progress;
+    return count_blocks(source, counter, progress);
+}
 
-    std::vector<size_t> bytes_distribution(256);
-    uint8_t read_ahead_buffer[MAX_BUFFER_SIZE];
-    file.rdbuf()->pubsetbuf(read_ahead_buffer, MAX_BUFFER_SIZE);
-
-    uint8_t b{};
-    while (file.good()) {
+template <typename BlockCounter>
+bool ShannonEncryptionChecker::file_probabilities(const std::wstring& file_path, uintmax_t offset, uintmax_t length, BlockCounter& counter) const
+{
+    // the range ends at the end of file, mapped windows never go beyond it
+    std::error_code ec;
+    const uintmax_t file_size = fs::file_size(file_path, ec);
+    if (ec) {
+        return false;
+    }
+    length = (offset < file_size) ? std::min(length, file_size - offset) : 0;
 
-        if (interrupt_all_) {
-            return std::vector<size_t>{};
+    // the same scan mode whether the entropy map is built or not
+    auto scan = [this, &file_path, offset, length](auto& block_counter) {
+        if (scan_mode_ == MappedScan && length >= MIN_MAPPED_FILE_SIZE) {
+            return file_probabilities_mapped(file_path, offset, length, block_counter);
         }
-
-        file.read(reinterpret_cast<uint8_t*>(&b), sizeof(uint8_t));
-        ++bytes_distribution[b];
+        if (scan_mode_ == AsyncScan && length > READ_BLOCK_SIZE) {
+            return file_probabilities_async(file_path, offset, length, block_counter);
+        }
+        return file_probabilities_buffered(file_path, offset, length, block_counter);
+    };
+
+    if (entropy_map_) {
+        entropy_map_->clear();
+        EntropyMapCounter<BlockCounter> map_counter(counter, *entropy_map_);
+        bool completed = scan(map_counter);
+        map_counter.finish();
+        return completed;
     }
-    return std::move(bytes_distribution);
-
+    return scan(counter);
 }
 
-std::vector<size_t> ShannonEncryptionChecker::file_probabilities_observed(const std::wstring& file_path, uintmax_t file_size) const
+template <typename BlockCounter>
+bool ShannonEncryptionChecker::file_probabilities_buffered(const std::wstring& file_path, uintmax_t offset, uintmax_t length, BlockCounter& counter) const
 {
-    assert(callback_);
-#if defined(_WIN32) || defined(_WIN64)
-    std::basic_ifstream<uint8_t, std::char_traits<uint8_t>> file(file_path, std::ios::in | std::ios::binary);
-#else
-    std::basic_ifstream<uint8_t, std::char_traits<uint8_t>> file(helpers::wstring_to_string(file_path), std::ios::in | std::ios::binary);
-#endif
-    if (!file.is_open()) {
-        return std::vector<size_t>{};
+    EntropyFileReader file;
+    if (!file.open(file_path)) {
+        return false;
     }
 
-    std::vector<size_t> bytes_distribution(256);
-    uint8_t read_ahead_buffer[MAX_BUFFER_SIZE];
-    file.rdbuf()->pubsetbuf(read_ahead_buffer, MAX_BUFFER_SIZE);
+    BufferedBlocks source(file, offset, length, READ_BLOCK_SIZE);
+    return scan_blocks(source, length, counter);
+}
 
-    uintmax_t precent_size = 10;
-    uintmax_t precent_counter = 0;
-    if (file_size > 1024) {
-        precent_size = file_size / 100;
+template <typename BlockCounter>
+bool ShannonEncryptionChecker::file_probabilities_mapped(const std::wstring& file_path, uintmax_t offset, uintmax_t length, BlockCounter& counter) const
+{
+    EntropyFileReader file;
+    if (!file.open(file_path)) {
+        return false;
     }
-    
-    callback_->init(file_size);
-
-
-    uint8_t b{};
-    uintmax_t counter{};
-    while (file.good()) {
-
-        if (interrupt_all_) {
-            return std::vector<size_t>{};
-        }
-
-        file.read(reinterpret_cast<uint8_t*>(&b), sizeof(uint8_t));
-
-        ++counter;
-        ++precent_counter;
-        if (callback_ && precent_counter == precent_size) {
-            callback_->set_value(counter);
-            precent_counter = 0;
-        }
 
-        ++bytes_distribution[b];
+    if (!file.can_map()) {
+        file.close();
+        return file_probabilities_buffered(file_path, offset, length, counter);
     }
-    return std::move(bytes_distribution);
+
+    MappedBlocks source(file, offset, length, MAP_WINDOW_SIZE, READ_BLOCK_SIZE);
+    return scan_blocks(source, length, counter);
 }
 
-std::vector<double> ShannonEncryptionChecker::read_stream_probabilities(const uint8_t* sequence_start, uintmax_t sequence_size) const
+template <typename BlockCounter>
+bool ShannonEncryptionChecker::file_probabilities_async(const std::wstring& file_path, uintmax_t offset, uintmax_t length, BlockCounter& counter) const
 {
-    if (0 == sequence_size) {
-        return std::move(std::vector<double>(256));
-    }
-    
-    std::vector<double> bytes_frequencies(256);
-    std::vector<size_t> bytes_distribution;
-    if (callback_) {
-        bytes_distribution = stream_probabilities_observed(sequence_start, sequence_size);
+    EntropyFileReader file;
+    if (!file.open(file_path)) {
+        return false;
     }
-    else {
-        bytes_distribution = stream_probabilities_fast(sequence_start, sequence_size);
-    }
-
-    for (size_t i = 0; i != 256; ++i) {
-        if (interrupt_all_) {
-            return std::vector<double>{};
-        }
 
-        bytes_frequencies[i] = static_cast<double>(bytes_distribution[i]) / sequence_size;
+    // only the histogram does not depend on the order of blocks, statistics and regions are counted in the file order
+    const bool ordered = !std::is_same_v<BlockCounter, ByteHistogram>;
+    if (!file.start_async(READ_BLOCK_SIZE, async_queue_depth_, offset, length, ordered)) {
+        file.close();
+        return file_probabilities_buffered(file_path, offset, length, counter);
     }
 
-    return std::move(bytes_frequencies);
+    AsyncBlocks source(file);
+    return scan_blocks(source, length, counter);
 }
 
-std::vector<size_t> ShannonEncryptionChecker::stream_probabilities_fast(const uint8_t* sequence_start, uintmax_t sequence_size) const
+bool ShannonEncryptionChecker::is_async_scan_supported()
 {
-    assert(callback_ == nullptr);
-    std::vector<size_t> bytes_distribution(256);
+    // io_uring may be missing or disabled by sysctl or seccomp, probed once
+    static const bool supported = IoUringQueue().init(1);
+    return supported;
+}
 
-    for (size_t i = 0; i < sequence_size; ++i) {
-        if (interrupt_all_) {
-            return std::vector<size_t>{};
-        }
+template <typename BlockCounter>
+bool ShannonEncryptionChecker::stream_probabilities(const uint8_t* sequence_start, uintmax_t sequence_size, BlockCounter& counter) const
+{
+    // count by blocks, so that interruption is still possible on huge sequences
+    SequenceBlocks source(sequence_start, sequence_size, READ_BLOCK_SIZE);
+    return scan_blocks(source, sequence_size, counter);
+}
 
-        ++bytes_distribution[sequence_start[i]];
+void ShannonEncryptionChecker::classify_statistics(const ContentStatistics& statistics, uintmax_t sequence_size, ContentClassification& classification)
+{
+    const double n = static_cast<double>(statistics.total());
+    classification.entropy = statistics.histogram().entropy();
+    classification.chi_square = statistics.chi_square();
+    classification.mean = statistics.mean();
+    classification.serial_correlation = statistics.serial_correlation();
+    classification.monte_carlo_pi = statistics.monte_carlo_pi();
+    classification.sample_size = statistics.total();
+
+    // Wilson-Hilferty approximation of chi-square with k degrees of freedom by the normal distribution,
+    // only too big values mean non-uniform bytes
+    const double k = static_cast<double>(ByteHistogram::BINS_COUNT - 1);
+    const double chi_square_variance = 2.0 / (9.0 * k);
+    classification.chi_square_z = (std::cbrt(classification.chi_square / k) - (1.0 - chi_square_variance)) / std::sqrt(chi_square_variance);
+
+    // standard deviations of the other statistics of uniformly random bytes
+    const double mean_deviation = std::sqrt((256.0 * 256.0 - 1.0) / 12.0 / n);
+    const double correlation_deviation = 1.0 / std::sqrt(n);
+    const double pi_quarter = std::atan(1.0);
+    const double points = static_cast<double>(std::max<uint64_t>(statistics.monte_carlo_points(), 1));
+    const double pi_deviation = 4.0 * std::sqrt(pi_quarter * (1.0 - pi_quarter) / points);
+
+    classification.random =
+        classification.chi_square_z < RANDOMNESS_MAX_Z &&
+        std::abs(classification.mean - 127.5) < RANDOMNESS_MAX_Z * mean_deviation &&
+        std::abs(classification.serial_correlation) < RANDOMNESS_MAX_Z * correlation_deviation &&
+        std::abs(classification.monte_carlo_pi - 4.0 * pi_quarter) < RANDOMNESS_MAX_Z * pi_deviation;
+
+    classification.estimation = information_entropy_estimation(classification.entropy, sequence_size);
+    if (classification.estimation == Encrypted && !classification.random) {
+        classification.estimation = Binary;
+        classification.compressed = true;
     }
-    return std::move(bytes_distribution);
 }
 
-std::vector<size_t> ShannonEncryptionChecker::stream_probabilities_observed(const uint8_t* sequence_start, uintmax_t sequence_size) const
+void ShannonEncryptionChecker::jackknife_estimate(const std::vector<ByteHistogram>& groups, EntropyEstimate& estimate)
 {
-    assert(callback_);
-    std::vector<size_t> bytes_distribution(256);
-
-    if (callback_) {
-        callback_->init(sequence_size);
+    std::array<uint64_t, ByteHistogram::BINS_COUNT> counters{};
+    uintmax_t total{};
+    for (const ByteHistogram& group : groups) {
+        for (size_t b = 0; b < counters.size(); ++b) {
+            counters[b] += group.count(static_cast<uint8_t>(b));
+        }
+        total += group.total();
     }
+    double entropy = corrected_entropy(counters.data(), total);
+
+    // delete-one-group jackknife, empty groups do not take part
+    std::vector<double> partial_estimates;
+    partial_estimates.reserve(groups.size());
+    for (const ByteHistogram& group : groups) {
+        if (0 == group.total() || total == group.total()) {
+            continue;
+        }
 
-    uintmax_t counter{};
-    for (size_t i = 0; i < sequence_size; ++i) {
-        if (interrupt_all_) {
-            return std::vector<size_t>{};
+        std::array<uint64_t, ByteHistogram::BINS_COUNT> rest{};
+        for (size_t b = 0; b < rest.size(); ++b) {
+            rest[b] = counters[b] - group.count(static_cast<uint8_t>(b));
         }
+        partial_estimates.push_back(corrected_entropy(rest.data(), total - group.total()));
+    }
 
-        if (callback_) {
-            callback_->set_value(++counter);
+    double standard_error{};
+    if (partial_estimates.size() > 1) {
+        const double k = static_cast<double>(partial_estimates.size());
+        double partial_mean = std::accumulate(partial_estimates.begin(), partial_estimates.end(), 0.0) / k;
+        double squares{};
+        for (double partial : partial_estimates) {
+            squares += (partial - partial_mean) * (partial - partial_mean);
         }
+        standard_error = std::sqrt(squares * (k - 1) / k);
+    }
 
-        ++bytes_distribution[sequence_start[i]];
+    // corrected values may slightly exceed absolute chaos, clamp only the reported numbers
+    estimate.lower_bound = std::clamp(entropy - SAMPLE_CONFIDENCE_Z * standard_error, 0.0, 8.0);
+    estimate.upper_bound = std::clamp(entropy + SAMPLE_CONFIDENCE_Z * standard_error, 0.0, 8.0);
+    estimate.entropy = std::min(entropy, 8.0);
+}
+
+bool ShannonEncryptionChecker::classification_settled(const EntropyEstimate& estimate)
+{
+    // the whole confidence interval has to be inside one class,
+    // using the same thresholds as information_entropy_estimation() for the whole file
+    const double encrypted_threshold = 8.0 - estimated_epsilon(estimate.file_size);
+    if (estimate.upper_bound <= 6.0) {
+        return true;
+    }
+    if (estimate.lower_bound > 6.0 && estimate.upper_bound <= encrypted_threshold) {
+        return true;
     }
-    return std::move(bytes_distribution);
+    return (estimate.lower_bound > encrypted_threshold);
 }
 
 double ShannonEncryptionChecker::estimated_epsilon(uintmax_t sample_size)
@@ -0,0 +1,452 @@
+#if defined(_WIN32) || defined(_WIN64)
+#define NOMINMAX
+#endif
+#include <eraser/entropy_file_reader.h>
+#include <winapi-helpers/utilities.h>
+
+#include <algorithm>
+
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+using namespace shredder;
+
+EntropyFileReader::~EntropyFileReader()
+{
+    close();
+}
+
+#if defined(_WIN32) || defined(_WIN64)
+
+bool EntropyFileReader::open(const std::wstring& file_path)
+{
+    close();
+    file_handle_ = CreateFileW(file_path.c_str(), GENERIC_READ,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        NULL,
+        OPEN_EXISTING,
+        FILE_FLAG_SEQUENTIAL_SCAN,
+        NULL);
+    return (file_handle_ != INVALID_HANDLE_VALUE);
+}
+
+void EntropyFileReader::close()
+{
+    stop_async();
+    if (INVALID_HANDLE_VALUE != file_handle_) {
+        ::CloseHandle(file_handle_);
+    }
+    file_handle_ = INVALID_HANDLE_VALUE;
+}
+
+bool EntropyFileReader::is_open() const
+{
+    return (file_handle_ != INVALID_HANDLE_VALUE);
+}
+
+bool EntropyFileReader::read_at(uintmax_t offset, uint8_t* buffer, size_t buffer_size, size_t& bytes_read)
+{
+    bytes_read = 0;
+    while (bytes_read < buffer_size) {
+        // offset in OVERLAPPED makes synchronous ReadFile positional
+        OVERLAPPED overlapped{};
+        ULARGE_INTEGER position{};
+        position.QuadPart = offset + bytes_read;
+        overlapped.Offset = position.LowPart;
+        overlapped.OffsetHigh = position.HighPart;
+
+        DWORD chunk = static_cast<DWORD>(std::min<size_t>(buffer_size - bytes_read, MAXDWORD));
+        DWORD chunk_read{};
+        if (!ReadFile(file_handle_, buffer + bytes_read, chunk, &chunk_read, &overlapped)) {
+            return (GetLastError() == ERROR_HANDLE_EOF);
+        }
+        if (0 == chunk_read) {
+            break;
+        }
+        bytes_read += chunk_read;
+    }
+    return true;
+}
+
+void EntropyFileReader::advise_random()
+{
+    // the access pattern is set by FILE_FLAG_SEQUENTIAL_SCAN on open only
+}
+
+void EntropyFileReader::prefetch(uintmax_t offset, size_t length)
+{
+}
+
+bool EntropyFileReader::can_map() const
+{
+    // only buffered reads on Windows
+    return false;
+}
+
+const uint8_t* EntropyFileReader::map_window(uintmax_t offset, size_t window_size)
+{
+    return nullptr;
+}
+
+void EntropyFileReader::unmap_window(const uint8_t* window_start, size_t window_size)
+{
+}
+
+bool EntropyFileReader::read(uint8_t* buffer, size_t buffer_size, size_t& bytes_read)
+{
+    // ReadFile accepts 32-bit size only
+    DWORD chunk = static_cast<DWORD>(std::min<size_t>(buffer_size, MAXDWORD));
+    DWORD chunk_read{};
+    bytes_read = 0;
+    if (!ReadFile(file_handle_, buffer, chunk, &chunk_read, NULL)) {
+        return false;
+    }
+    bytes_read = chunk_read;
+    return true;
+}
+
+#else
+
+bool EntropyFileReader::open(const std::wstring& file_path)
+{
+    close();
+    file_descriptor_ = ::open(helpers::wstring_to_string(file_path).c_str(), O_RDONLY | O_CLOEXEC);
+    if (file_descriptor_ < 0) {
+        return false;
+    }
+#if defined(POSIX_FADV_SEQUENTIAL)
+    // let the kernel double the read-ahead window
+    ::posix_fadvise(file_descriptor_, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    return true;
+}
+
+void EntropyFileReader::close()
+{
+    stop_async();
+    if (file_descriptor_ >= 0) {
+        ::close(file_descriptor_);
+    }
+    file_descriptor_ = -1;
+}
+
+bool EntropyFileReader::is_open() const
+{
+    return (file_descriptor_ >= 0);
+}
+
+bool EntropyFileReader::read(uint8_t* buffer, size_t buffer_size, size_t& bytes_read)
+{
+    bytes_read = 0;
+    // fill the whole buffer unless end of file, short reads are possible on pipes and network volumes
+    while (bytes_read < buffer_size) {
+        ssize_t chunk_read = ::read(file_descriptor_, buffer + bytes_read, buffer_size - bytes_read);
+        if (chunk_read < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        if (0 == chunk_read) {
+            break;
+        }
+        bytes_read += static_cast<size_t>(chunk_read);
+    }
+    return true;
+}
+
+void EntropyFileReader::advise_random()
+{
+#if defined(POSIX_FADV_RANDOM)
+    ::posix_fadvise(file_descriptor_, 0, 0, POSIX_FADV_RANDOM);
+#endif
+}
+
+void EntropyFileReader::prefetch(uintmax_t offset, size_t length)
+{
+#if defined(POSIX_FADV_WILLNEED)
+    ::posix_fadvise(file_descriptor_, static_cast<off_t>(offset), static_cast<off_t>(length), POSIX_FADV_WILLNEED);
+#elif defined(F_RDADVISE)
+    radvisory advisory{};
+    advisory.ra_offset = static_cast<off_t>(offset);
+    advisory.ra_count = static_cast<int>(length);
+    ::fcntl(file_descriptor_, F_RDADVISE, &advisory);
+#endif
+}
+
+bool EntropyFileReader::read_at(uintmax_t offset, uint8_t* buffer, size_t buffer_size, size_t& bytes_read)
+{
+    bytes_read = 0;
+    while (bytes_read < buffer_size) {
+        ssize_t chunk_read = ::pread(file_descriptor_, buffer + bytes_read, buffer_size - bytes_read,
+            static_cast<off_t>(offset + bytes_read));
+        if (chunk_read < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        if (0 == chunk_read) {
+            break;
+        }
+        bytes_read += static_cast<size_t>(chunk_read);
+    }
+    return true;
+}
+
+#if defined(__linux__)
+
+bool EntropyFileReader::can_map() const
+{
+    // character devices, pipes and procfs-like files are read by buffers
+    struct stat file_stat{};
+    if (!is_open() || ::fstat(file_descriptor_, &file_stat) != 0) {
+        return false;
+    }
+    return S_ISREG(file_stat.st_mode) && (file_stat.st_size > 0);
+}
+
+const uint8_t* EntropyFileReader::map_window(uintmax_t offset, size_t window_size)
+{
+    void* window_start = ::mmap(nullptr, window_size, PROT_READ, MAP_PRIVATE, file_descriptor_, static_cast<off_t>(offset));
+    if (MAP_FAILED == window_start) {
+        return nullptr;
+    }
+
+    // advice is just a hint, errors do not matter
+    ::madvise(window_start, window_size, MADV_SEQUENTIAL);
+#if defined(MADV_HUGEPAGE)
+    ::madvise(window_start, window_size, MADV_HUGEPAGE);
+#endif
+    return static_cast<const uint8_t*>(window_start);
+}
+
+void EntropyFileReader::unmap_window(const uint8_t* window_start, size_t window_size)
+{
+    if (window_start) {
+        ::munmap(const_cast<uint8_t*>(window_start), window_size);
+    }
+}
+
+#else
+
+bool EntropyFileReader::can_map() const
+{
+    return false;
+}
+
+const uint8_t* EntropyFileReader::map_window(uintmax_t offset, size_t window_size)
+{
+    return nullptr;
+}
+
+void EntropyFileReader::unmap_window(const uint8_t* window_start, size_t window_size)
+{
+}
+
+#endif // defined(__linux__)
+
+#endif // defined(_WIN32) || defined(_WIN64)
+
+#if defined(ERASER_HAS_IO_URING)
+
+bool EntropyFileReader::start_async(size_t block_size, unsigned queue_depth, uintmax_t offset, uintmax_t length,
+                                    bool ordered)
+{
+    stop_async();
+    struct stat file_stat{};
+    if (!is_open() || ::fstat(file_descriptor_, &file_stat) != 0 || !S_ISREG(file_stat.st_mode)) {
+        return false;
+    }
+
+    auto queue = std::make_unique<IoUringQueue>();
+    if (0 == block_size || 0 == queue_depth || !queue->init(queue_depth)) {
+        return false;
+    }
+
+    // kernel may round the depth up, buffers are needed only for requested blocks
+    async_queue_ = std::move(queue);
+    async_block_size_ = block_size;
+    async_end_ = static_cast<uintmax_t>(file_stat.st_size);
+    if (offset < async_end_ && length < async_end_ - offset) {
+        async_end_ = offset + length;
+    }
+    async_offset_ = std::min(offset, async_end_);
+    async_held_ = -1;
+    async_ordered_ = ordered;
+    async_next_offset_ = async_offset_;
+    async_buffer_.resize(block_size * queue_depth);
+    async_blocks_.assign(queue_depth, AsyncBlock{});
+
+    // registered buffers save page pinning on every read, plain reads are used if registration fails
+    std::vector<std::pair<void*, size_t>> buffers;
+    for (size_t slot = 0; slot < queue_depth; ++slot) {
+        buffers.emplace_back(async_buffer_.data() + slot * block_size, block_size);
+    }
+    async_queue_->register_buffers(buffers);
+
+    for (size_t slot = 0; slot < queue_depth && async_offset_ < async_end_; ++slot) {
+        if (!queue_async_block(slot)) {
+            stop_async();
+            return false;
+        }
+    }
+    if (!async_queue_->submit()) {
+        stop_async();
+        return false;
+    }
+    return true;
+}
+
+bool EntropyFileReader::queue_async_block(size_t slot)
+{
+    AsyncBlock& block = async_blocks_[slot];
+    block.offset = async_offset_;
+    block.size = static_cast<size_t>(std::min<uintmax_t>(async_end_ - async_offset_, async_block_size_));
+    block.filled = 0;
+    block.completed = false;
+    async_offset_ += block.size;
+    return async_queue_->prepare_read_fixed(file_descriptor_, async_buffer_.data() + slot * async_block_size_,
+        static_cast<unsigned>(block.size), block.offset, static_cast<unsigned>(slot), slot);
+}
+
+bool EntropyFileReader::next_async_block(const uint8_t*& block_start, size_t& block_size)
+{
+    block_start = nullptr;
+    block_size = 0;
+    if (!async_queue_) {
+        return false;
+    }
+
+    // the caller is done with the previous block, its buffer reads ahead again
+    if (async_held_ >= 0) {
+        size_t slot = static_cast<size_t>(async_held_);
+        async_held_ = -1;
+        if (async_offset_ < async_end_) {
+            if (!queue_async_block(slot) || !async_queue_->submit()) {
+                return false;
+            }
+        }
+    }
+
+    for (;;) {
+        if (async_ordered_) {
+            // blocks are queued in the file order, so the next one is either completed or in flight
+            auto next = std::find_if(async_blocks_.begin(), async_blocks_.end(), [this](const AsyncBlock& block) {
+                return block.completed && block.offset == async_next_offset_;
+            });
+            if (next != async_blocks_.end()) {
+                next->completed = false;
+                async_next_offset_ = next->offset + next->size;
+                if (0 == next->filled) {
+                    // beyond the end of the file shortened during the scan
+                    continue;
+                }
+
+                size_t slot = static_cast<size_t>(next - async_blocks_.begin());
+                async_held_ = static_cast<int>(slot);
+                block_start = async_buffer_.data() + slot * async_block_size_;
+                block_size = next->filled;
+                return true;
+            }
+        }
+        if (0 == async_queue_->in_flight()) {
+            break;
+        }
+
+        IoUringCompletion completion;
+        if (!async_queue_->wait_completion(completion)) {
+            return false;
+        }
+
+        size_t slot = static_cast<size_t>(completion.user_data);
+        AsyncBlock& block = async_blocks_[slot];
+        uint8_t* buffer = async_buffer_.data() + slot * async_block_size_;
+        if (completion.result < 0 && completion.result != -EINTR && completion.result != -EAGAIN) {
+            return false;
+        }
+
+        // file became shorter during the scan, deliver what has been read
+        bool file_end = (0 == completion.result);
+        if (completion.result > 0) {
+            block.filled += static_cast<size_t>(completion.result);
+        }
+
+        if (!file_end && block.filled < block.size) {
+            // short or interrupted read, resubmit the rest of the block
+            if (!async_queue_->prepare_read_fixed(file_descriptor_, buffer + block.filled,
+                    static_cast<unsigned>(block.size - block.filled), block.offset + block.filled,
+                    static_cast<unsigned>(slot), slot) ||
+                !async_queue_->submit()) {
+                return false;
+            }
+            continue;
+        }
+
+        if (async_ordered_) {
+            block.completed = true;
+            continue;
+        }
+        if (0 == block.filled) {
+            continue;
+        }
+
+        async_held_ = static_cast<int>(slot);
+        block_start = buffer;
+        block_size = block.filled;
+        return true;
+    }
+
+    // end of file
+    return true;
+}
+
+void EntropyFileReader::stop_async()
+{
+    if (!async_queue_) {
+        return;
+    }
+
+    // kernel writes into the buffers until completion, they can not be released earlier
+    async_queue_->submit();
+    IoUringCompletion completion;
+    while (async_queue_->in_flight() > 0 && async_queue_->wait_completion(completion)) {
+    }
+    async_queue_.reset();
+    async_buffer_.clear();
+    async_buffer_.shrink_to_fit();
+    async_blocks_.clear();
+    async_held_ = -1;
+}
+
+#else
+
+bool EntropyFileReader::start_async(size_t block_size, unsigned queue_depth, uintmax_t offset, uintmax_t length,
+                                    bool ordered)
+{
+    return false;
+}
+
+bool EntropyFileReader::queue_async_block(size_t slot)
+{
+    return false;
+}
+
+bool EntropyFileReader::next_async_block(const uint8_t*& block_start, size_t& block_size)
+{
+    return false;
+}
+
+void EntropyFileReader::stop_async()
+{
+}
+
+#endif // defined(ERASER_HAS_IO_URING)
@@ -0,0 +1,88 @@
+#include <eraser/entropy_map.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+using namespace shredder;
+
+namespace {
+
+constexpr double MAX_ENTROPY = 8.0;
+constexpr double QUANTIZATION_STEPS = 255.0;
+constexpr char HEX_DIGITS[] = "0123456789abcdef";
+
+int hex_digit_value(char digit)
+{
+    if (digit >= '0' && digit <= '9') {
+        return digit - '0';
+    }
+    if (digit >= 'a' && digit <= 'f') {
+        return digit - 'a' + 10;
+    }
+    if (digit >= 'A' && digit <= 'F') {
+        return digit - 'A' + 10;
+    }
+    return -1;
+}
+
+} // namespace
+
+EntropyMap::EntropyMap(uint64_t region_size /*= DEFAULT_REGION_SIZE*/)
+    : region_size_(std::max<uint64_t>(region_size, 1))
+{
+}
+
+void EntropyMap::push_back(double entropy)
+{
+    double clamped = std::clamp(entropy, 0.0, MAX_ENTROPY);
+    regions_.push_back(static_cast<uint8_t>(std::lround(clamped / MAX_ENTROPY * QUANTIZATION_STEPS)));
+}
+
+void EntropyMap::append(const EntropyMap& next)
+{
+    assert(region_size_ == next.region_size_);
+    regions_.insert(regions_.end(), next.regions_.begin(), next.regions_.end());
+}
+
+void EntropyMap::clear()
+{
+    regions_.clear();
+}
+
+double EntropyMap::entropy(size_t region) const
+{
+    return static_cast<double>(regions_[region]) * MAX_ENTROPY / QUANTIZATION_STEPS;
+}
+
+std::string EntropyMap::to_hex() const
+{
+    std::string hex;
+    hex.reserve(regions_.size() * 2);
+    for (uint8_t value : regions_) {
+        hex.push_back(HEX_DIGITS[value >> 4]);
+        hex.push_back(HEX_DIGITS[value & 0x0F]);
+    }
+    return hex;
+}
+
+// static
+bool EntropyMap::from_hex(const std::string& hex, uint64_t region_size, EntropyMap& entropy_map)
+{
+    if (hex.size() % 2 != 0 || 0 == region_size) {
+        return false;
+    }
+
+    EntropyMap parsed(region_size);
+    parsed.regions_.reserve(hex.size() / 2);
+    for (size_t i = 0; i < hex.size(); i += 2) {
+        int high = hex_digit_value(hex[i]);
+        int low = hex_digit_value(hex[i + 1]);
+        if (high < 0 || low < 0) {
+            return false;
+        }
+        parsed.regions_.push_back(static_cast<uint8_t>((high << 4) | low));
+    }
+    entropy_map = std::move(parsed);
+    return true;
+}
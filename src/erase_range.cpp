@@ -0,0 +1,49 @@
+#include <eraser/erase_range.h>
+
+#include <algorithm>
+
+using namespace shredder;
+
+void shredder::coalesce_ranges(std::vector<EraseRange>& ranges)
+{
+    auto by_offset = [](const EraseRange& left, const EraseRange& right) { return left.offset < right.offset; };
+    if (!std::is_sorted(ranges.begin(), ranges.end(), by_offset)) {
+        std::sort(ranges.begin(), ranges.end(), by_offset);
+    }
+
+    auto merged = ranges.begin();
+    for (auto it = ranges.begin(); it != ranges.end(); ++it) {
+        if (0 == it->length) {
+            continue;
+        }
+        if (merged != ranges.begin() && it->offset <= std::prev(merged)->end()) {
+            // overlapping or adjacent, extend the previous one
+            EraseRange& previous = *std::prev(merged);
+            previous.length = std::max(previous.end(), it->end()) - previous.offset;
+            continue;
+        }
+        *merged++ = *it;
+    }
+    ranges.erase(merged, ranges.end());
+}
+
+void shredder::intersect_range(const std::vector<EraseRange>& extents, const EraseRange& range, std::vector<EraseRange>& result)
+{
+    // the first extent ending after the range beginning
+    auto it = std::upper_bound(extents.begin(), extents.end(), range.offset,
+                               [](uint64_t offset, const EraseRange& extent) { return offset < extent.end(); });
+    for (; it != extents.end() && it->offset < range.end(); ++it) {
+        const uint64_t begin = std::max(it->offset, range.offset);
+        const uint64_t end = std::min(it->end(), range.end());
+        if (begin < end) {
+            result.push_back({ begin, end - begin });
+        }
+    }
+}
+
+bool shredder::contains_offset(const std::vector<EraseRange>& extents, uint64_t offset)
+{
+    auto it = std::upper_bound(extents.begin(), extents.end(), offset,
+                               [](uint64_t offset, const EraseRange& extent) { return offset < extent.end(); });
+    return it != extents.end() && it->offset <= offset;
+}
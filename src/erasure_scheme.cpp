@@ -0,0 +1,53 @@
+#include <eraser/erasure_scheme.h>
+
+#include <algorithm>
+#include <cassert>
+#include <random>
+
+using namespace shredder;
+
+ErasureScheme::ErasureScheme(Type type, unsigned passes_count)
+    : ErasureScheme(type, passes_count, std::random_device()())
+{
+}
+
+ErasureScheme::ErasureScheme(Type type, unsigned passes_count, uint32_t seed)
+    : type_(type)
+    , seed_(seed)
+{
+    switch (type_) {
+    case Type::SinglePass:
+        passes_count_ = 1;
+        break;
+    case Type::ZeroOneRandom:
+    case Type::DoD5220_22M:
+        passes_count_ = 3;
+        break;
+    case Type::RandomPasses:
+        passes_count_ = std::min(std::max(passes_count, 1u), MAX_PASSES);
+        break;
+    }
+
+    // random passes by default, fixed-character passes are filled below
+    patterns_.reset(new uint8_t[PATTERN_LENGTH * passes_count_]);
+    // the generator output is the same on every platform, unlike distributions
+    std::mt19937 generator(seed_);
+    std::generate(patterns_.get(), patterns_.get() + PATTERN_LENGTH * passes_count_,
+                  [&]() { return static_cast<uint8_t>(generator() >> 24); });
+
+    if (Type::ZeroOneRandom == type_) {
+        std::fill_n(pattern(0), PATTERN_LENGTH, 0x00);
+        std::fill_n(pattern(1), PATTERN_LENGTH, 0xFF);
+    }
+    else if (Type::DoD5220_22M == type_) {
+        const uint8_t character = static_cast<uint8_t>(generator() >> 24);
+        std::fill_n(pattern(0), PATTERN_LENGTH, character);
+        std::fill_n(pattern(1), PATTERN_LENGTH, static_cast<uint8_t>(~character));
+    }
+}
+
+uint8_t* ErasureScheme::pattern(unsigned pass) const
+{
+    assert(pass < passes_count_);
+    return patterns_.get() + PATTERN_LENGTH * pass;
+}
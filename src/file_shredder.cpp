@@ -2,6 +2,10 @@
 #include <eraser/shredder_cache.h>
 
 #include <eraser/encryption_checker.h>
+#include <eraser/byte_histogram.h>
+#include <eraser/content_statistics.h>
+#include <eraser/cancellation_token.h>
+#include <eraser/entropy_map.h>
 #include <winapi-helpers/md5.h>
 #include <winapi-helpers/hardware_information.h>
 #include <plog/Log.h>
@@ -11,6 +15,7 @@
 #include <boost/filesystem.hpp>
 #include <algorithm>
 #include <memory>
+#include <numeric>
 #include <string>
 #include <chrono>
 
@@ -20,6 +25,67 @@ using namespace shredder;
 using namespace encryption;
 namespace fs = boost::filesystem;
 
+struct FileShredder::RangeEntropyJob
+{
+    std::string hash;
+    std::wstring file_path;
+    IShredderCallback* callback = nullptr;
+    ShredderFileIdentity identity;
+    std::shared_ptr<CancellationToken> cancellation_token;
+
+    /// Ranges dropped by interrupt_checks() are never counted, the callback is completed
+    /// when the last of them is released
+    ~RangeEntropyJob()
+    {
+        if (!finished && callback) {
+            callback->cleanup();
+        }
+    }
+
+    /// Ranges are classified by randomness statistics, appended in the file order once all are counted
+    bool classify = false;
+    uintmax_t range_size = 0;
+    std::vector<ContentStatistics> statistics;
+
+    /// Entropy maps of ranges, appended in the file order the same way (empty if maps are disabled)
+    std::vector<EntropyMap> maps;
+
+    /// Lock merging and the callback, which is not thread-safe
+    std::mutex job_lock;
+    ByteHistogram histogram;
+    uintmax_t bytes_counted = 0;
+    size_t ranges_left = 0;
+    bool failed = false;
+
+    /// The last range has been counted, the callback is completed by it
+    bool finished = false;
+};
+
+class FileShredder::RunningCheck
+{
+public:
+    explicit RunningCheck(FileShredder& shredder) : shredder_(shredder)
+    {
+        std::lock_guard<std::mutex> l(shredder_.checks_lock_);
+        ++shredder_.running_checks_;
+    }
+
+    ~RunningCheck()
+    {
+        {
+            std::lock_guard<std::mutex> l(shredder_.checks_lock_);
+            --shredder_.running_checks_;
+        }
+        shredder_.checks_finished_.notify_all();
+    }
+
+    RunningCheck(const RunningCheck&) = delete;
+    RunningCheck& operator=(const RunningCheck&) = delete;
+
+private:
+    FileShredder& shredder_;
+};
+
 namespace {
 
 const char* get_md5(const char* message)
@@ -32,10 +98,56 @@ const char* get_md5(const char* message)
 
 bool shredder::FileShredder::multithreaded_erase_(false);
 bool shredder::FileShredder::ntfs_erase_(false);
+bool shredder::FileShredder::mapped_entropy_scan_(false);
+bool shredder::FileShredder::async_entropy_scan_(false);
+unsigned shredder::FileShredder::entropy_queue_depth_(8);
+bool shredder::FileShredder::persistent_entropy_cache_(true);
+bool shredder::FileShredder::statistical_classification_(false);
+uintmax_t shredder::FileShredder::sampled_entropy_threshold_(0);
+bool shredder::FileShredder::early_entropy_classification_(false);
+uintmax_t shredder::FileShredder::parallel_entropy_threshold_(0);
+uintmax_t shredder::FileShredder::entropy_map_region_size_(0);
+bool shredder::FileShredder::signature_classification_(false);
+size_t shredder::FileShredder::signature_confirmation_blocks_(16);
+bool shredder::FileShredder::direct_io_erase_(false);
+bool shredder::FileShredder::direct_io_huge_pages_(false);
+bool shredder::FileShredder::async_erase_(false);
+unsigned shredder::FileShredder::erase_queue_depth_(32);
+DurabilityPolicy shredder::FileShredder::durability_policy_(DurabilityPolicy::PerFile);
+bool shredder::FileShredder::discard_erase_(false);
+bool shredder::FileShredder::discard_trim_(false);
+ErasureScheme::Type shredder::FileShredder::erasure_scheme_(ErasureScheme::Type::SinglePass);
+unsigned shredder::FileShredder::erasure_passes_(1);
+bool shredder::FileShredder::verify_erase_(false);
+bool shredder::FileShredder::resumable_erase_(true);
+uintmax_t shredder::FileShredder::erase_checkpoint_interval_(1024 * 1024 * 1024);
 
 bool shredder::FileShredderSettings::ntfs_erase = true;
 bool shredder::FileShredderSettings::multithreaded_erase = false;
 size_t shredder::FileShredderSettings::thread_number = 0;
+bool shredder::FileShredderSettings::mapped_entropy_scan = false;
+bool shredder::FileShredderSettings::async_entropy_scan = false;
+unsigned shredder::FileShredderSettings::entropy_queue_depth = 8;
+bool shredder::FileShredderSettings::persistent_entropy_cache = true;
+bool shredder::FileShredderSettings::statistical_classification = false;
+uintmax_t shredder::FileShredderSettings::sampled_entropy_threshold = 0;
+bool shredder::FileShredderSettings::early_entropy_classification = false;
+uintmax_t shredder::FileShredderSettings::parallel_entropy_threshold = 0;
+uintmax_t shredder::FileShredderSettings::entropy_map_region_size = 0;
+bool shredder::FileShredderSettings::signature_classification = false;
+size_t shredder::FileShredderSettings::signature_confirmation_blocks = 16;
+bool shredder::FileShredderSettings::direct_io_erase = false;
+bool shredder::FileShredderSettings::direct_io_huge_pages = false;
+bool shredder::FileShredderSettings::async_erase = false;
+unsigned shredder::FileShredderSettings::erase_queue_depth = 32;
+DurabilityPolicy shredder::FileShredderSettings::durability_policy = DurabilityPolicy::PerFile;
+bool shredder::FileShredderSettings::discard_erase = false;
+bool shredder::FileShredderSettings::discard_trim = false;
+ErasureScheme::Type shredder::FileShredderSettings::erasure_scheme = ErasureScheme::Type::SinglePass;
+unsigned shredder::FileShredderSettings::erasure_passes = 1;
+bool shredder::FileShredderSettings::verify_erase = false;
+bool shredder::FileShredderSettings::resumable_erase = true;
+uintmax_t shredder::FileShredderSettings::erase_checkpoint_interval = 1024 * 1024 * 1024;
 
 FileShredder& FileShredder::instance(const FileShredderSettings& settings)
 {
@@ -58,6 +170,29 @@ FileShredder::FileShredder(const FileShredderSettings& settings) :
 
     // Force NTFS journal cleanup
     FileShredder::ntfs_erase_ = settings.ntfs_erase;
+    FileShredder::mapped_entropy_scan_ = settings.mapped_entropy_scan;
+    FileShredder::async_entropy_scan_ = settings.async_entropy_scan;
+    FileShredder::entropy_queue_depth_ = settings.entropy_queue_depth;
+    FileShredder::persistent_entropy_cache_ = settings.persistent_entropy_cache;
+    FileShredder::statistical_classification_ = settings.statistical_classification;
+    FileShredder::sampled_entropy_threshold_ = settings.sampled_entropy_threshold;
+    FileShredder::early_entropy_classification_ = settings.early_entropy_classification;
+    FileShredder::parallel_entropy_threshold_ = settings.parallel_entropy_threshold;
+    FileShredder::entropy_map_region_size_ = settings.entropy_map_region_size;
+    FileShredder::signature_classification_ = settings.signature_classification;
+    FileShredder::signature_confirmation_blocks_ = settings.signature_confirmation_blocks;
+    FileShredder::direct_io_erase_ = settings.direct_io_erase;
+    FileShredder::direct_io_huge_pages_ = settings.direct_io_huge_pages;
+    FileShredder::async_erase_ = settings.async_erase;
+    FileShredder::erase_queue_depth_ = settings.erase_queue_depth;
+    FileShredder::durability_policy_ = settings.durability_policy;
+    FileShredder::discard_erase_ = settings.discard_erase;
+    FileShredder::discard_trim_ = settings.discard_trim;
+    FileShredder::erasure_scheme_ = settings.erasure_scheme;
+    FileShredder::erasure_passes_ = settings.erasure_passes;
+    FileShredder::verify_erase_ = settings.verify_erase;
+    FileShredder::resumable_erase_ = settings.resumable_erase;
+    FileShredder::erase_checkpoint_interval_ = settings.erase_checkpoint_interval;
 
     LOG_INFO << "FileShredder: NTFS_ERASE=" << FileShredder::ntfs_erase_;
     LOG_INFO << "FileShredder: System reported " << cores_number() << " CPU cores";
@@ -105,8 +240,19 @@ bool FileShredder::submit(const std::wstring& path, bool system_added, bool no_i
         cache_->submit(file_path, -1.0);
     }
 
+    // check of the same file submitted earlier is superseded
+    auto cancellation_token = std::make_shared<CancellationToken>();
+    {
+        std::lock_guard<std::mutex> l(checks_lock_);
+        std::shared_ptr<CancellationToken>& check_token = check_tokens_[hash];
+        if (check_token) {
+            check_token->cancel();
+        }
+        check_token = cancellation_token;
+    }
+
     // last operation in the method
-    calculation_pool.enqueue(&FileShredder::update_entropy, this, std::move(hash), std::move(file_path), callback);    
+    calculation_pool.enqueue(&FileShredder::update_entropy, this, std::move(hash), std::move(file_path), callback, std::move(cancellation_token));
     return true;
 }
 
@@ -125,6 +271,7 @@ bool FileShredder::remove(const std::wstring& path)
     }
 
     std::string hash = get_md5(helpers::wstring_to_utf8(file_path).c_str());
+    cancel_check(path);
 
     std::lock_guard<std::recursive_mutex> l(update_mutex_);
     if (!db_.remove_record(hash)) {
@@ -137,18 +284,89 @@ bool FileShredder::remove(const std::wstring& path)
     return true;
 }
 
-void FileShredder::erase_files()
+bool FileShredder::cancel_check(const std::wstring& path)
+{
+	std::wstring file_path = path;
+#if defined(_WIN32) || defined(_WIN64)
+	// case insensitive path
+	if (!file_path.empty()) {
+		std::transform(file_path.begin(), file_path.end(), file_path.begin(), ::towupper);
+	}
+#endif
+
+    std::string hash = get_md5(helpers::wstring_to_utf8(file_path).c_str());
+
+    std::lock_guard<std::mutex> l(checks_lock_);
+    auto it = check_tokens_.find(hash);
+    if (it == check_tokens_.end()) {
+        return false;
+    }
+    it->second->cancel();
+    check_tokens_.erase(it);
+    return true;
+}
+
+std::vector<std::wstring> FileShredder::erase_files()
 {
     LOG_DEBUG << "Interrupt current checks";
-    interrupt_checks();
+    if (!interrupt_checks()) {
+        // checks store entropy of the files being erased, they must not race with erasure
+        LOG_WARNING << "Entropy checks are still running, wait for them";
+        wait_checks();
+    }
 
     if (!cache_->is_cache_ready()) {
         LOG_DEBUG << "Cache needs to be reset [shred_files]";
         reset_cache();
     }
-    cache_->erase_files();
 
+    // identities of the files before erasure, entries of other files stay in the entropy cache
+    std::vector<std::pair<std::wstring, ShredderFileIdentity>> erased_identities;
+    if (persistent_entropy_cache_) {
+        for (const auto& file : cache_->files_prepared()) {
+            ShredderFileIdentity identity = ShredderFileIdentity::read(file.first);
+            if (identity.valid) {
+                erased_identities.emplace_back(file.first, identity);
+            }
+        }
+    }
+
+    // patterns of all passes are generated once, shared by all drives of the job.
+    // The file table and the journal stay until the job is finished, the interrupted job is resumed by the next call
+    // with the same patterns. The journal of the job with other passes is abandoned
+    auto erasure_scheme = std::make_shared<const ErasureScheme>(erasure_scheme_, erasure_passes_);
+    if (resumable_erase_) {
+        ErasureScheme::Type journaled_type = ErasureScheme::Type::SinglePass;
+        unsigned journaled_passes = 0;
+        uint32_t journaled_seed = 0;
+        if (db_.find_erasure_job(journaled_type, journaled_passes, journaled_seed) &&
+            journaled_type == erasure_scheme->type() && journaled_passes == erasure_scheme->passes_count()) {
+            erasure_scheme = std::make_shared<const ErasureScheme>(journaled_type, journaled_passes, journaled_seed);
+        }
+        else {
+            db_.clean_erasure_journal();
+            if (!db_.update_erasure_job(*erasure_scheme)) {
+                LOG_DEBUG << "Unable to journal the erase job";
+                db_.check_sqlite_error();
+            }
+        }
+    }
+    std::vector<std::wstring> unverified_files = cache_->erase_files(erasure_scheme, resumable_erase_ ? &db_ : nullptr);
+
+    // erased files are gone, so are their identities and progress.
+    // Files left in place unchanged (e.g. locked ones) keep their entries
+    std::vector<ShredderFileIdentity> evicted_identities;
+    for (const auto& erased_identity : erased_identities) {
+        if (ShredderFileIdentity::read(erased_identity.first) != erased_identity.second) {
+            evicted_identities.push_back(erased_identity.second);
+        }
+    }
     db_.drop_table();
+    if (!evicted_identities.empty() && !db_.remove_cached_entropy(evicted_identities)) {
+        db_.check_sqlite_error();
+    }
+    db_.clean_erasure_journal();
+    return unverified_files;
 }
 
 bool FileShredder::clean()
@@ -160,6 +378,9 @@ bool FileShredder::clean()
         return false;
     }
 
+    // the interrupted job is abandoned
+    db_.clean_erasure_journal();
+
     cache_->clean();
     return true;
 }
@@ -210,16 +431,24 @@ size_t FileShredder::threads_number() const
     return calculation_pool.threads_number();
 }
 
-void FileShredder::interrupt_checks()
+bool FileShredder::interrupt_checks()
 {
-    ShannonEncryptionChecker::interrupt(true);
-    calculation_pool.stop();
+    // pending checks never start, running ones stop at the next block
+    std::unique_lock<std::mutex> l(checks_lock_);
+    for (auto& check_token : check_tokens_) {
+        check_token.second->cancel();
+    }
+    check_tokens_.clear();
     calculation_pool.clear();
 
-    // enough for finishing tasks
-    while (!calculation_pool.stopped()) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
-    }
+    return checks_finished_.wait_for(l, std::chrono::milliseconds(CANCELLATION_TIMEOUT_MS),
+        [this] { return 0 == running_checks_; });
+}
+
+void FileShredder::wait_checks()
+{
+    std::unique_lock<std::mutex> l(checks_lock_);
+    checks_finished_.wait(l, [this] { return 0 == running_checks_; });
 }
 
 bool FileShredder::read_table(std::vector<ShredderFileInfo>& ret_table)
@@ -234,7 +463,7 @@ bool FileShredder::read_table(std::vector<ShredderFileInfo>& ret_table)
 				std::transform(file_path.begin(), file_path.end(), file_path.begin(), ::towupper);
 			}
 #endif
-            cache_->submit(file_path, info.entropy);
+            cache_->submit(file_path, info.entropy, info.flags.get_flags(), info.entropy_map);
         });
         cache_->set_cache_ready(true);
         return true;
@@ -244,21 +473,264 @@ bool FileShredder::read_table(std::vector<ShredderFileInfo>& ret_table)
     }
 }
 
-void FileShredder::update_entropy(std::string hash, std::wstring file_path, IShredderCallback* callback)
+void FileShredder::update_entropy(std::string hash, std::wstring file_path, IShredderCallback* callback,
+    std::shared_ptr<CancellationToken> cancellation_token)
 {
+    RunningCheck running_check(*this);
+    if (cancellation_token->is_cancelled()) {
+        if (callback) {
+            callback->cleanup();
+        }
+        return;
+    }
+
+    // unchanged file has been scanned before, e.g. resubmitted artefact
+    ShredderFileIdentity identity;
+    if (persistent_entropy_cache_) {
+        identity = ShredderFileIdentity::read(file_path);
+        double cached_entropy{};
+        bool cached_compressed{};
+        EntropyMap cached_map;
+        if (db_.find_cached_entropy(identity, cached_entropy, cached_compressed, cached_map)) {
+            LOG_DEBUG << "Cached entropy of " << helpers::wstring_to_utf8(file_path);
+            finish_check(hash, cancellation_token);
+            store_entropy(hash, file_path, cached_entropy, cached_compressed, cached_map, ShredderFileIdentity(), callback);
+            return;
+        }
+    }
+
     ShannonEncryptionChecker checker;
+    checker.set_cancellation_token(cancellation_token);
     
     if (callback) {
         checker.set_callback(callback);
     }
 
-    double entropy = checker.get_file_entropy(file_path);
+    set_scan_mode(checker);
+
+    // entropy of regions is gathered by complete, range and sampled scans
+    EntropyMap entropy_map(entropy_map_region_size_ ? entropy_map_region_size_ : EntropyMap::DEFAULT_REGION_SIZE);
+
+    // huge files are estimated from a constant-size sample or classified incrementally
+    double entropy{};
+    bool compressed{};
+    boost::system::error_code ec;
+    uintmax_t file_size = fs::file_size(file_path, ec);
+    ShannonEncryptionChecker::ContentClassification signature;
+    checker.set_signature_confirmation(signature_confirmation_blocks_);
+    if (!ec && signature_classification_ && checker.get_signature_classification(file_path, signature)) {
+        // archive, media or encrypted container, the class is obvious from the header
+        entropy = signature.entropy;
+        compressed = signature.compressed;
+    }
+    else if (!ec && early_entropy_classification_) {
+        // only the class matters for erasure, stop reading once it is settled
+        entropy = checker.classify_file_entropy(file_path).entropy;
+    }
+    else if (!ec && sampled_entropy_threshold_ && file_size > sampled_entropy_threshold_) {
+        if (entropy_map_region_size_) {
+            checker.set_entropy_map(&entropy_map);
+        }
+        if (statistical_classification_) {
+            ShannonEncryptionChecker::ContentClassification classification = checker.get_sampled_file_classification(file_path);
+            entropy = classification.entropy;
+            compressed = classification.compressed;
+        }
+        else {
+            entropy = checker.get_sampled_file_entropy(file_path).entropy;
+        }
+    }
+    else if (!ec && parallel_entropy_threshold_ && file_size > parallel_entropy_threshold_ && threads_number() > 1 &&
+             split_entropy_check(hash, file_path, file_size, identity, callback, cancellation_token)) {
+        // the worker counting the last range stores the result
+        return;
+    }
+    else if (statistical_classification_) {
+        // the same single pass, compressed data is told from ciphertext
+        if (entropy_map_region_size_) {
+            checker.set_entropy_map(&entropy_map);
+        }
+        ShannonEncryptionChecker::ContentClassification classification = checker.get_file_classification(file_path);
+        entropy = classification.entropy;
+        compressed = classification.compressed;
+    }
+    else {
+        if (entropy_map_region_size_) {
+            checker.set_entropy_map(&entropy_map);
+        }
+        entropy = checker.get_file_entropy(file_path);
+    }
+
+    // cancelled check leaves the entropy unknown
+    if (cancellation_token->is_cancelled()) {
+        if (callback) {
+            callback->cleanup();
+        }
+        return;
+    }
+    finish_check(hash, cancellation_token);
+    store_entropy(hash, file_path, entropy, compressed, entropy_map, identity, callback);
+}
 
-    if (!db_.update_record(hash, entropy)) {
+bool FileShredder::split_entropy_check(const std::string& hash, const std::wstring& file_path, uintmax_t file_size,
+    const ShredderFileIdentity& identity, IShredderCallback* callback, const std::shared_ptr<CancellationToken>& cancellation_token)
+{
+    uintmax_t ranges_count = std::min<uintmax_t>(threads_number(), file_size / MIN_ENTROPY_RANGE_SIZE);
+    if (ranges_count < 2) {
+        return false;
+    }
+
+    // ranges start at page boundaries, so that they could be mapped,
+    // at Monte Carlo point boundaries, so that appended statistics are exact,
+    // and at region boundaries, so that appended entropy maps are exact
+    uintmax_t range_alignment = std::lcm<uintmax_t>(1024 * 1024, ContentStatistics::MONTE_CARLO_POINT_SIZE);
+    if (entropy_map_region_size_) {
+        range_alignment = std::lcm<uintmax_t>(range_alignment, entropy_map_region_size_);
+    }
+    uintmax_t range_size = (file_size + ranges_count - 1) / ranges_count;
+    range_size = (range_size + range_alignment - 1) / range_alignment * range_alignment;
+    ranges_count = (file_size + range_size - 1) / range_size;
+    if (ranges_count < 2) {
+        return false;
+    }
+
+    auto job = std::make_shared<RangeEntropyJob>();
+    job->hash = hash;
+    job->file_path = file_path;
+    job->callback = callback;
+    job->identity = identity;
+    job->cancellation_token = cancellation_token;
+    job->classify = statistical_classification_;
+    job->range_size = range_size;
+    job->ranges_left = static_cast<size_t>(ranges_count);
+    if (job->classify) {
+        job->statistics.resize(job->ranges_left);
+    }
+    if (entropy_map_region_size_) {
+        job->maps.resize(job->ranges_left, EntropyMap(entropy_map_region_size_));
+    }
+    if (callback) {
+        callback->init(file_size);
+    }
+
+    for (uintmax_t range = 1; range < ranges_count; ++range) {
+        uintmax_t offset = range * range_size;
+        calculation_pool.enqueue(&FileShredder::update_entropy_range, this, job, offset, std::min(range_size, file_size - offset));
+    }
+
+    // the first range is counted right here
+    update_entropy_range(job, 0, range_size);
+    return true;
+}
+
+void FileShredder::update_entropy_range(std::shared_ptr<RangeEntropyJob> job, uintmax_t offset, uintmax_t length)
+{
+    RunningCheck running_check(*this);
+    ShannonEncryptionChecker checker;
+    checker.set_cancellation_token(job->cancellation_token);
+    set_scan_mode(checker);
+
+    // every range has its own statistics, histograms are merged at once
+    const size_t range = static_cast<size_t>(offset / job->range_size);
+    if (!job->maps.empty()) {
+        checker.set_entropy_map(&job->maps[range]);
+    }
+    ByteHistogram histogram;
+    bool completed = job->classify ?
+        checker.get_file_range_statistics(job->file_path, offset, length, job->statistics[range]) :
+        checker.get_file_range_histogram(job->file_path, offset, length, histogram);
+
+    double entropy{};
+    bool compressed{};
+    {
+        std::lock_guard<std::mutex> l(job->job_lock);
+        job->histogram.merge(histogram);
+        job->bytes_counted += job->classify ? job->statistics[range].total() : histogram.total();
+        job->failed = job->failed || !completed;
+        if (job->callback) {
+            job->callback->set_value(job->bytes_counted);
+        }
+
+        if (--job->ranges_left > 0) {
+            return;
+        }
+        job->finished = true;
+    }
+
+    // the last finished range, others do not touch the job anymore
+    if (job->failed) {
+        entropy = -1.0;
+    }
+    else if (job->classify) {
+        ContentStatistics statistics;
+        for (const ContentStatistics& range_statistics : job->statistics) {
+            statistics.append(range_statistics);
+        }
+        ShannonEncryptionChecker::ContentClassification classification = ShannonEncryptionChecker::get_statistics_classification(statistics);
+        entropy = classification.entropy;
+        compressed = classification.compressed;
+    }
+    else {
+        entropy = job->histogram.entropy();
+    }
+
+    EntropyMap entropy_map(entropy_map_region_size_ ? entropy_map_region_size_ : EntropyMap::DEFAULT_REGION_SIZE);
+    for (const EntropyMap& range_map : job->maps) {
+        entropy_map.append(range_map);
+    }
+
+    if (job->cancellation_token->is_cancelled()) {
+        if (job->callback) {
+            job->callback->cleanup();
+        }
+        return;
+    }
+    finish_check(job->hash, job->cancellation_token);
+    store_entropy(job->hash, job->file_path, entropy, compressed, entropy_map, job->identity, job->callback);
+}
+
+void FileShredder::set_scan_mode(ShannonEncryptionChecker& checker)
+{
+    // without io_uring the asynchronous scan would read by buffers, mapped windows are better then
+    if (async_entropy_scan_ && ShannonEncryptionChecker::is_async_scan_supported()) {
+        checker.set_scan_mode(ShannonEncryptionChecker::AsyncScan);
+        checker.set_async_queue_depth(entropy_queue_depth_);
+    }
+    else if (mapped_entropy_scan_) {
+        checker.set_scan_mode(ShannonEncryptionChecker::MappedScan);
+    }
+}
+
+void FileShredder::finish_check(const std::string& hash, const std::shared_ptr<CancellationToken>& cancellation_token)
+{
+    std::lock_guard<std::mutex> l(checks_lock_);
+    auto it = check_tokens_.find(hash);
+    if (it != check_tokens_.end() && it->second == cancellation_token) {
+        check_tokens_.erase(it);
+    }
+}
+
+void FileShredder::store_entropy(const std::string& hash, const std::wstring& file_path, double entropy, bool compressed,
+    const EntropyMap& entropy_map, const ShredderFileIdentity& identity, IShredderCallback* callback)
+{
+    if (!db_.update_record(hash, entropy, compressed)) {
         LOG_WARNING << "Unable to insert path " << helpers::wstring_to_utf8(file_path);
         db_.check_sqlite_error();
     }
 
+    if (entropy >= 0.0 && !entropy_map.empty()) {
+        if (!db_.update_entropy_map(hash, entropy_map)) {
+            db_.check_sqlite_error();
+        }
+    }
+
+    // file modified during the scan is calculated again next time
+    if (entropy >= 0.0 && identity.valid && ShredderFileIdentity::read(file_path) == identity) {
+        if (!db_.update_cached_entropy(identity, entropy, compressed, entropy_map)) {
+            db_.check_sqlite_error();
+        }
+    }
+
     if (callback) {
         callback->cleanup();
     }
@@ -285,3 +757,63 @@ bool FileShredder::is_ntfs_erase()
 {
     return ntfs_erase_;
 }
+
+bool FileShredder::is_direct_io_erase()
+{
+    return direct_io_erase_;
+}
+
+bool FileShredder::is_direct_io_huge_pages()
+{
+    return direct_io_huge_pages_;
+}
+
+bool FileShredder::is_async_erase()
+{
+    return async_erase_;
+}
+
+unsigned FileShredder::erase_queue_depth()
+{
+    return erase_queue_depth_;
+}
+
+DurabilityPolicy FileShredder::durability_policy()
+{
+    return durability_policy_;
+}
+
+bool FileShredder::is_discard_erase()
+{
+    return discard_erase_;
+}
+
+bool FileShredder::is_discard_trim()
+{
+    return discard_trim_;
+}
+
+ErasureScheme::Type FileShredder::erasure_scheme()
+{
+    return erasure_scheme_;
+}
+
+unsigned FileShredder::erasure_passes()
+{
+    return erasure_passes_;
+}
+
+bool FileShredder::is_verify_erase()
+{
+    return verify_erase_;
+}
+
+bool FileShredder::is_resumable_erase()
+{
+    return resumable_erase_;
+}
+
+uintmax_t FileShredder::erase_checkpoint_interval()
+{
+    return erase_checkpoint_interval_;
+}
@@ -0,0 +1,239 @@
+#include <eraser/histogram_kernels.h>
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define ERASER_X64_KERNELS
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang compile every kernel for its own instruction set,
+// MSVC allows intrinsics anywhere
+#if defined(__GNUC__) || defined(__clang__)
+#define ERASER_TARGET(isa) __attribute__((target(isa)))
+#else
+#define ERASER_TARGET(isa)
+#endif
+
+using namespace shredder;
+
+namespace {
+
+/// Spread 8 bytes of the machine word over the interleaved tables
+inline void count_word(uint64_t word, HistogramTables& tables)
+{
+    ++tables[0][word & 0xFF];
+    ++tables[1][(word >> 8) & 0xFF];
+    ++tables[2][(word >> 16) & 0xFF];
+    ++tables[3][(word >> 24) & 0xFF];
+    ++tables[0][(word >> 32) & 0xFF];
+    ++tables[1][(word >> 40) & 0xFF];
+    ++tables[2][(word >> 48) & 0xFF];
+    ++tables[3][(word >> 56) & 0xFF];
+}
+
+/// Bytes which do not fill the whole vector
+inline void count_tail(const uint8_t* block_start, size_t block_size, HistogramTables& tables)
+{
+    for (size_t i = 0; i < block_size; ++i) {
+        ++tables[i % HISTOGRAM_TABLES_COUNT][block_start[i]];
+    }
+}
+
+void histogram_scalar(const uint8_t* block_start, size_t block_size, HistogramTables& tables)
+{
+    size_t i = 0;
+    for (; i + 8 <= block_size; i += 8) {
+        uint64_t word{};
+        std::memcpy(&word, block_start + i, sizeof(word));
+        count_word(word, tables);
+    }
+    count_tail(block_start + i, block_size - i, tables);
+}
+
+#if defined(ERASER_X64_KERNELS)
+
+// Run-skipping variants of the scalar kernel: the whole register is compared with its first byte,
+// so that runs of the same byte (zero-filled and sparse regions) are counted by a single add.
+// Other registers are spread over the tables word by word, as in the scalar kernel, so these variants
+// are slower than the scalar kernel on random or compressed data (see histogram_* results of eraser_bench)
+
+ERASER_TARGET("sse4.2")
+void histogram_runs_sse42(const uint8_t* block_start, size_t block_size, HistogramTables& tables)
+{
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= block_size; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block_start + i));
+        __m128i first = _mm_shuffle_epi8(v, zero);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, first)) == 0xFFFF) {
+            tables[0][block_start[i]] += 16;
+            continue;
+        }
+        count_word(static_cast<uint64_t>(_mm_cvtsi128_si64(v)), tables);
+        count_word(static_cast<uint64_t>(_mm_extract_epi64(v, 1)), tables);
+    }
+    count_tail(block_start + i, block_size - i, tables);
+}
+
+ERASER_TARGET("avx2")
+void histogram_runs_avx2(const uint8_t* block_start, size_t block_size, HistogramTables& tables)
+{
+    size_t i = 0;
+    for (; i + 32 <= block_size; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block_start + i));
+        __m256i first = _mm256_set1_epi8(static_cast<char>(block_start[i]));
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, first)) == -1) {
+            tables[0][block_start[i]] += 32;
+            continue;
+        }
+        __m128i low = _mm256_castsi256_si128(v);
+        __m128i high = _mm256_extracti128_si256(v, 1);
+        count_word(static_cast<uint64_t>(_mm_cvtsi128_si64(low)), tables);
+        count_word(static_cast<uint64_t>(_mm_extract_epi64(low, 1)), tables);
+        count_word(static_cast<uint64_t>(_mm_cvtsi128_si64(high)), tables);
+        count_word(static_cast<uint64_t>(_mm_extract_epi64(high, 1)), tables);
+    }
+    count_tail(block_start + i, block_size - i, tables);
+}
+
+ERASER_TARGET("avx512f,avx512bw")
+void histogram_runs_avx512(const uint8_t* block_start, size_t block_size, HistogramTables& tables)
+{
+    size_t i = 0;
+    for (; i + 64 <= block_size; i += 64) {
+        __m512i v = _mm512_loadu_si512(block_start + i);
+        __m512i first = _mm512_set1_epi8(static_cast<char>(block_start[i]));
+        if (_mm512_cmpeq_epi8_mask(v, first) == ~0ULL) {
+            tables[0][block_start[i]] += 64;
+            continue;
+        }
+        // words straight from the source, the register is not stored back
+        for (size_t w = 0; w < 64; w += 8) {
+            uint64_t word{};
+            std::memcpy(&word, block_start + i + w, sizeof(word));
+            count_word(word, tables);
+        }
+    }
+    count_tail(block_start + i, block_size - i, tables);
+}
+
+enum class CpuFeature {
+    Sse42,
+    Avx2,
+    Avx512
+};
+
+bool cpu_supports(CpuFeature feature)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int regs[4]{};
+    __cpuid(regs, 1);
+    const bool sse42 = (regs[2] & (1 << 20)) != 0;
+    const bool os_avx = (regs[2] & (1 << 27)) && (regs[2] & (1 << 28)) && ((_xgetbv(0) & 0x06) == 0x06);
+    const bool os_avx512 = os_avx && ((_xgetbv(0) & 0xE6) == 0xE6);
+    __cpuidex(regs, 7, 0);
+    switch (feature) {
+    case CpuFeature::Sse42:
+        return sse42;
+    case CpuFeature::Avx2:
+        return os_avx && (regs[1] & (1 << 5));
+    case CpuFeature::Avx512:
+        // AVX512F and AVX512BW
+        return os_avx512 && (regs[1] & (1 << 16)) && (regs[1] & (1 << 30));
+    }
+    return false;
+#else
+    __builtin_cpu_init();
+    switch (feature) {
+    case CpuFeature::Sse42:
+        return __builtin_cpu_supports("sse4.2");
+    case CpuFeature::Avx2:
+        return __builtin_cpu_supports("avx2");
+    case CpuFeature::Avx512:
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+    }
+    return false;
+#endif
+}
+
+#endif // defined(ERASER_X64_KERNELS)
+
+} // namespace
+
+std::vector<HistogramKernelInfo> shredder::supported_histogram_kernels()
+{
+    std::vector<HistogramKernelInfo> kernels{ { "scalar", &histogram_scalar } };
+#if defined(ERASER_X64_KERNELS)
+    if (cpu_supports(CpuFeature::Sse42)) {
+        kernels.push_back({ "sse4.2-runs", &histogram_runs_sse42 });
+    }
+    if (cpu_supports(CpuFeature::Avx2)) {
+        kernels.push_back({ "avx2-runs", &histogram_runs_avx2 });
+    }
+    if (cpu_supports(CpuFeature::Avx512)) {
+        kernels.push_back({ "avx512-runs", &histogram_runs_avx512 });
+    }
+#endif
+    return kernels;
+}
+
+const HistogramKernelInfo& shredder::best_histogram_kernel()
+{
+    // run-skipping variants lose to the scalar kernel on random data by the compare of every register
+    static const HistogramKernelInfo best = supported_histogram_kernels().front();
+    return best;
+}
+
+const HistogramKernelInfo& shredder::best_runs_histogram_kernel()
+{
+    // variants are ordered from the narrowest to the widest register, the widest one skips runs fastest
+    static const HistogramKernelInfo best = supported_histogram_kernels().back();
+    return best;
+}
+
+bool shredder::starts_with_run(const uint8_t* block_start, size_t block_size)
+{
+    if (block_size < RUN_PROBE_SIZE) {
+        return false;
+    }
+
+    uint64_t words[RUN_PROBE_SIZE / sizeof(uint64_t)];
+    std::memcpy(words, block_start, sizeof(words));
+    const uint64_t run = block_start[0] * 0x0101010101010101ULL;
+    uint64_t difference{};
+    for (uint64_t word : words) {
+        difference |= word ^ run;
+    }
+    return 0 == difference;
+}
+
+double shredder::histogram_entropy(const uint64_t* counters, size_t bins_count, uintmax_t total)
+{
+    if (0 == total) {
+        return 0.0;
+    }
+
+    // H = log2(N) - sum(c * log2(c)) / N
+    // Independent partial sums let the compiler pipeline log2 calls
+    double partial_sums[4] = {};
+    for (size_t b = 0; b < bins_count; ++b) {
+        uint64_t c = counters[b];
+        // c == 1 contributes nothing
+        if (c > 1) {
+            double fp_count = static_cast<double>(c);
+            partial_sums[b & 3] += fp_count * std::log2(fp_count);
+        }
+    }
+
+    double fp_total = static_cast<double>(total);
+    double sum = (partial_sums[0] + partial_sums[1]) + (partial_sums[2] + partial_sums[3]);
+    double entropy = std::log2(fp_total) - sum / fp_total;
+
+    // rounding may lead to a tiny negative value for a single-byte sequence
+    return (entropy > 0.0) ? entropy : 0.0;
+}
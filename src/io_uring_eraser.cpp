@@ -0,0 +1,375 @@
+#if defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
+#include <eraser/io_uring_eraser.h>
+
+#include <algorithm>
+#include <limits>
+#include <cassert>
+#include <cerrno>
+
+#include <unistd.h>
+
+using namespace shredder;
+
+namespace {
+
+/// Synchronous write, the last resort if the asynchronous one fails
+bool pwrite_all(int fd, const uint8_t* buffer, size_t length, uint64_t offset)
+{
+    while (length > 0) {
+        ssize_t bytes_written = ::pwrite(fd, buffer, length, static_cast<off_t>(offset));
+        if (bytes_written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes_written <= 0) {
+            return false;
+        }
+        buffer += bytes_written;
+        length -= static_cast<size_t>(bytes_written);
+        offset += static_cast<uint64_t>(bytes_written);
+    }
+    return true;
+}
+
+} // namespace
+
+IoUringEraser::~IoUringEraser()
+{
+    wait_all();
+}
+
+bool IoUringEraser::init(unsigned queue_depth, size_t block_size, bool huge_pages)
+{
+    queue_depth = std::max(queue_depth, 2u);
+    if (!queue_.init(queue_depth)) {
+        return false;
+    }
+    if (!pattern_.init(1, block_size, huge_pages)) {
+        return false;
+    }
+    pattern_mask_ = nullptr;
+    pattern_mask_length_ = 0;
+
+    // fixed buffer saves page pinning on every write, regular writes are used if registration fails
+    queue_.register_buffers({ { pattern_.buffer(0), pattern_.buffer_size() } });
+
+    // completion ring is twice as big as the submission one, so that it never overflows
+    operations_.assign(queue_depth, Operation());
+    free_slots_.clear();
+    for (unsigned slot = queue_depth; slot > 0; --slot) {
+        free_slots_.push_back(slot - 1);
+    }
+    return true;
+}
+
+bool IoUringEraser::write(int fd, uint64_t offset, const uint8_t* buffer, size_t length, int main_fd)
+{
+    if (!is_ready() || fd < 0) {
+        return false;
+    }
+
+    Operation operation;
+    operation.fd = fd;
+    operation.file_fd = (main_fd >= 0) ? main_fd : fd;
+    operation.buffer = buffer;
+    operation.length = length;
+    operation.offset = offset;
+    while (operation.length > 0) {
+        Operation chunk = operation;
+        chunk.length = std::min<size_t>(operation.length, std::numeric_limits<int32_t>::max());
+        if (!queue_write(chunk)) {
+            return false;
+        }
+        operation.buffer += chunk.length;
+        operation.offset += chunk.length;
+        operation.length -= chunk.length;
+    }
+    return true;
+}
+
+bool IoUringEraser::write_pattern(int fd, uint64_t offset, uint64_t length, const uint8_t* mask, size_t mask_length, int main_fd)
+{
+    if (!is_ready() || fd < 0 || 0 == mask_length) {
+        return false;
+    }
+
+    if (pattern_mask_ != mask || pattern_mask_length_ != mask_length) {
+        // writes in flight still read the old pattern
+        while (free_slots_.size() < operations_.size()) {
+            if (!handle_completions()) {
+                return false;
+            }
+        }
+        pattern_.fill(mask, mask_length);
+        pattern_mask_ = mask;
+        pattern_mask_length_ = mask_length;
+    }
+
+    Operation operation;
+    operation.fd = fd;
+    operation.file_fd = (main_fd >= 0) ? main_fd : fd;
+    operation.buffer = pattern_.buffer(0);
+    operation.fixed = true;
+    for (uint64_t bytes_queued = 0; bytes_queued < length; ) {
+        operation.offset = offset + bytes_queued;
+        operation.length = static_cast<size_t>(std::min<uint64_t>(length - bytes_queued, pattern_.buffer_size()));
+        if (!queue_write(operation)) {
+            return false;
+        }
+        bytes_queued += operation.length;
+    }
+    return true;
+}
+
+bool IoUringEraser::finish_file(int fd, int direct_fd, const std::string& unlink_path, bool sync)
+{
+    if (fd < 0) {
+        return false;
+    }
+
+    FileState& file = files_[fd];
+    file.direct_fd = direct_fd;
+    file.unlink_path = unlink_path;
+    file.sync = sync;
+    file.finished = true;
+    if (0 == file.writes_in_flight) {
+        finished_files_.push_back(fd);
+        queue_finished_files();
+    }
+    return queue_.submit();
+}
+
+bool IoUringEraser::wait_file(int fd)
+{
+    for (auto it = files_.find(fd); it != files_.end() && it->second.writes_in_flight > 0; it = files_.find(fd)) {
+        if (!handle_completions()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool IoUringEraser::wait_all()
+{
+    while (!files_.empty() || free_slots_.size() < operations_.size()) {
+        queue_finished_files();
+        if (!handle_completions()) {
+            break;
+        }
+    }
+
+    const bool success = (0 == failed_operations_);
+    failed_operations_ = 0;
+    return success;
+}
+
+bool IoUringEraser::queue_write(const Operation& operation)
+{
+    unsigned slot{};
+    if (!reserve_slot(slot)) {
+        return false;
+    }
+    ++files_[operation.file_fd].writes_in_flight;
+    operations_[slot] = operation;
+    if (!prepare(operation, slot)) {
+        complete(slot, -EIO);
+        return false;
+    }
+
+    // keep the drive busy, completions are handled when all slots are taken
+    if (free_slots_.empty()) {
+        return queue_.submit();
+    }
+    return true;
+}
+
+bool IoUringEraser::prepare(const Operation& operation, unsigned slot)
+{
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        bool prepared = false;
+        switch (operation.type) {
+        case Operation::Write:
+            prepared = operation.fixed ?
+                queue_.prepare_write_fixed(operation.fd, operation.buffer, static_cast<unsigned>(operation.length),
+                                           operation.offset, 0, slot) :
+                queue_.prepare_write(operation.fd, operation.buffer, static_cast<unsigned>(operation.length),
+                                     operation.offset, slot);
+            break;
+        case Operation::Sync:
+            prepared = queue_.prepare_fsync(operation.fd, true, slot);
+            break;
+        case Operation::Unlink:
+            prepared = queue_.prepare_unlink(files_[operation.file_fd].unlink_path.c_str(), slot);
+            break;
+        }
+        if (prepared) {
+            return true;
+        }
+        // submission ring is full of not yet submitted entries
+        if (!queue_.submit()) {
+            return false;
+        }
+    }
+    return false;
+}
+
+void IoUringEraser::queue_finished_files()
+{
+    while (!finished_files_.empty()) {
+        const int fd = finished_files_.back();
+        const bool sync = files_[fd].sync;
+        const bool unlink = !files_[fd].unlink_path.empty();
+        const size_t slots_count = (sync ? 1 : 0) + (unlink ? 1 : 0);
+        if (free_slots_.size() < slots_count) {
+            return;
+        }
+        finished_files_.pop_back();
+        if (0 == slots_count) {
+            close_file(fd);
+            continue;
+        }
+
+        // unlink starts only after the data is on the drive, both are submitted at once
+        if (sync) {
+            unsigned slot = free_slots_.back();
+            free_slots_.pop_back();
+            operations_[slot] = Operation();
+            operations_[slot].type = Operation::Sync;
+            operations_[slot].fd = operations_[slot].file_fd = fd;
+            if (!prepare(operations_[slot], slot)) {
+                // the queue is broken, finish the file synchronously
+                free_slots_.push_back(slot);
+                if (0 != ::fsync(fd) || (unlink && 0 != ::unlink(files_[fd].unlink_path.c_str()))) {
+                    ++failed_operations_;
+                }
+                close_file(fd);
+                continue;
+            }
+            if (unlink) {
+                queue_.link_last();
+            }
+        }
+
+        if (unlink) {
+            unsigned slot = free_slots_.back();
+            free_slots_.pop_back();
+            operations_[slot] = Operation();
+            operations_[slot].type = Operation::Unlink;
+            operations_[slot].fd = operations_[slot].file_fd = fd;
+            if (!prepare(operations_[slot], slot)) {
+                complete(slot, -EIO);
+            }
+        }
+    }
+}
+
+bool IoUringEraser::reserve_slot(unsigned& slot)
+{
+    while (free_slots_.empty()) {
+        if (!handle_completions()) {
+            return false;
+        }
+    }
+    slot = free_slots_.back();
+    free_slots_.pop_back();
+    return true;
+}
+
+bool IoUringEraser::handle_completions()
+{
+    if (free_slots_.size() == operations_.size()) {
+        // nothing in flight
+        return false;
+    }
+    if (!queue_.submit(1)) {
+        return false;
+    }
+
+    IoUringCompletion completion;
+    while (queue_.peek_completion(completion)) {
+        complete(static_cast<unsigned>(completion.user_data), completion.result);
+    }
+    queue_finished_files();
+    return queue_.submit();
+}
+
+void IoUringEraser::complete(unsigned slot, int32_t result)
+{
+    assert(slot < operations_.size());
+    Operation& operation = operations_[slot];
+    const int file_fd = operation.file_fd;
+
+    if (Operation::Write == operation.type) {
+        if (result > 0 && static_cast<size_t>(result) < operation.length) {
+            // short write, queue the rest in the same slot
+            operation.buffer += result;
+            operation.offset += static_cast<uint64_t>(result);
+            operation.length -= static_cast<size_t>(result);
+            if (prepare(operation, slot)) {
+                return;
+            }
+            result = -EIO;
+        }
+        else if (-EAGAIN == result || -EINTR == result) {
+            if (prepare(operation, slot)) {
+                return;
+            }
+        }
+        else if (result < 0 && operation.fd != file_fd) {
+            // direct I/O refused (e.g. unaligned by the filesystem), retry through the page cache
+            operation.fd = file_fd;
+            operation.fixed = false;
+            if (prepare(operation, slot)) {
+                return;
+            }
+        }
+
+        if (result <= 0 && !pwrite_all(file_fd, operation.buffer, operation.length, operation.offset)) {
+            ++failed_operations_;
+        }
+
+        free_slots_.push_back(slot);
+        FileState& file = files_[file_fd];
+        assert(file.writes_in_flight > 0);
+        if (0 == --file.writes_in_flight && file.finished) {
+            finished_files_.push_back(file_fd);
+        }
+        return;
+    }
+
+    free_slots_.push_back(slot);
+    if (Operation::Sync == operation.type) {
+        if (result < 0) {
+            ++failed_operations_;
+        }
+        auto it = files_.find(file_fd);
+        if (it != files_.end() && it->second.unlink_path.empty()) {
+            close_file(file_fd);
+        }
+        return;
+    }
+
+    // cancelled after failed sync or not supported by the kernel, the overwrite is done anyway
+    auto it = files_.find(file_fd);
+    if (it == files_.end()) {
+        return;
+    }
+    if (result < 0 && 0 != ::unlink(it->second.unlink_path.c_str())) {
+        ++failed_operations_;
+    }
+    close_file(file_fd);
+}
+
+void IoUringEraser::close_file(int fd)
+{
+    auto it = files_.find(fd);
+    if (it == files_.end()) {
+        return;
+    }
+    if (it->second.direct_fd >= 0) {
+        ::close(it->second.direct_fd);
+    }
+    ::close(fd);
+    files_.erase(it);
+}
+
+#endif // defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
@@ -0,0 +1,471 @@
+#include <eraser/io_uring_queue.h>
+
+#if defined(ERASER_HAS_IO_URING)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#endif
+
+using namespace shredder;
+
+IoUringQueue::~IoUringQueue()
+{
+    close();
+}
+
+#if defined(ERASER_HAS_IO_URING)
+
+namespace {
+
+int io_uring_setup(unsigned entries, io_uring_params* params)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int io_uring_enter(int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+int io_uring_register(int ring_fd, unsigned opcode, const void* arg, unsigned nr_args)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args));
+}
+
+template <typename T>
+T* ring_pointer(void* ring, unsigned offset)
+{
+    return reinterpret_cast<T*>(static_cast<uint8_t*>(ring) + offset);
+}
+
+} // namespace
+
+bool IoUringQueue::init(unsigned queue_depth)
+{
+    close();
+
+    io_uring_params params{};
+    ring_fd_ = io_uring_setup(queue_depth, &params);
+    if (ring_fd_ < 0) {
+        // ENOSYS on old kernels, EPERM if disabled by sysctl or seccomp
+        ring_fd_ = -1;
+        return false;
+    }
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+        sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    }
+
+    sq_ring_ = ::mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+    if (MAP_FAILED == sq_ring_) {
+        sq_ring_ = nullptr;
+        close();
+        return false;
+    }
+
+    if (single_mmap) {
+        cq_ring_ = sq_ring_;
+    }
+    else {
+        cq_ring_ = ::mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+        if (MAP_FAILED == cq_ring_) {
+            cq_ring_ = nullptr;
+            close();
+            return false;
+        }
+    }
+
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = ::mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+    if (MAP_FAILED == sqes_) {
+        sqes_ = nullptr;
+        close();
+        return false;
+    }
+
+    sq_head_ = ring_pointer<unsigned>(sq_ring_, params.sq_off.head);
+    sq_tail_ = ring_pointer<unsigned>(sq_ring_, params.sq_off.tail);
+    sq_mask_ = *ring_pointer<unsigned>(sq_ring_, params.sq_off.ring_mask);
+    sq_array_ = ring_pointer<unsigned>(sq_ring_, params.sq_off.array);
+    cq_head_ = ring_pointer<unsigned>(cq_ring_, params.cq_off.head);
+    cq_tail_ = ring_pointer<unsigned>(cq_ring_, params.cq_off.tail);
+    cq_mask_ = *ring_pointer<unsigned>(cq_ring_, params.cq_off.ring_mask);
+    cqes_ = ring_pointer<io_uring_cqe>(cq_ring_, params.cq_off.cqes);
+    sq_entries_ = params.sq_entries;
+    sqe_tail_ = *sq_tail_;
+    in_flight_ = 0;
+    return true;
+}
+
+void IoUringQueue::close()
+{
+    if (sqes_) {
+        ::munmap(sqes_, sqes_size_);
+    }
+    if (cq_ring_ && cq_ring_ != sq_ring_) {
+        ::munmap(cq_ring_, cq_ring_size_);
+    }
+    if (sq_ring_) {
+        ::munmap(sq_ring_, sq_ring_size_);
+    }
+    if (ring_fd_ >= 0) {
+        ::close(ring_fd_);
+    }
+    sqes_ = sq_ring_ = cq_ring_ = last_sqe_ = nullptr;
+    ring_fd_ = -1;
+    in_flight_ = 0;
+    reaped_.clear();
+    buffers_registered_ = false;
+}
+
+bool IoUringQueue::register_buffers(const std::vector<std::pair<void*, size_t>>& buffers)
+{
+    if (!is_ready() || buffers.empty()) {
+        return false;
+    }
+
+    std::vector<iovec> iovecs;
+    for (const auto& buffer : buffers) {
+        iovecs.push_back(iovec{ buffer.first, buffer.second });
+    }
+
+    // may fail with ENOMEM if RLIMIT_MEMLOCK is too low
+    buffers_registered_ = (0 == io_uring_register(ring_fd_, IORING_REGISTER_BUFFERS, iovecs.data(), static_cast<unsigned>(iovecs.size())));
+    return buffers_registered_;
+}
+
+void* IoUringQueue::next_sqe()
+{
+    unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    if (sqe_tail_ - head >= sq_entries_) {
+        return nullptr;
+    }
+
+    unsigned index = sqe_tail_ & sq_mask_;
+    io_uring_sqe* sqe = static_cast<io_uring_sqe*>(sqes_) + index;
+    std::memset(sqe, 0, sizeof(io_uring_sqe));
+    sq_array_[index] = index;
+    ++sqe_tail_;
+    ++in_flight_;
+    last_sqe_ = sqe;
+    return sqe;
+}
+
+bool IoUringQueue::prepare_read_fixed(int fd, void* buffer, unsigned length, uint64_t offset, unsigned buffer_index, uint64_t user_data)
+{
+    if (!buffers_registered_) {
+        return prepare_read(fd, buffer, length, offset, user_data);
+    }
+
+    io_uring_sqe* sqe = static_cast<io_uring_sqe*>(next_sqe());
+    if (nullptr == sqe) {
+        return false;
+    }
+    sqe->opcode = IORING_OP_READ_FIXED;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buffer);
+    sqe->len = length;
+    sqe->off = offset;
+    sqe->buf_index = static_cast<uint16_t>(buffer_index);
+    sqe->user_data = user_data;
+    return true;
+}
+
+bool IoUringQueue::prepare_read(int fd, void* buffer, unsigned length, uint64_t offset, uint64_t user_data)
+{
+    io_uring_sqe* sqe = static_cast<io_uring_sqe*>(next_sqe());
+    if (nullptr == sqe) {
+        return false;
+    }
+
+    // IORING_OP_READ needs kernel 5.6, older kernels complete it with -EINVAL
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buffer);
+    sqe->len = length;
+    sqe->off = offset;
+    sqe->user_data = user_data;
+    return true;
+}
+
+bool IoUringQueue::prepare_write_fixed(int fd, const void* buffer, unsigned length, uint64_t offset, unsigned buffer_index, uint64_t user_data)
+{
+    if (!buffers_registered_) {
+        return prepare_write(fd, buffer, length, offset, user_data);
+    }
+
+    io_uring_sqe* sqe = static_cast<io_uring_sqe*>(next_sqe());
+    if (nullptr == sqe) {
+        return false;
+    }
+    sqe->opcode = IORING_OP_WRITE_FIXED;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buffer);
+    sqe->len = length;
+    sqe->off = offset;
+    sqe->buf_index = static_cast<uint16_t>(buffer_index);
+    sqe->user_data = user_data;
+    return true;
+}
+
+bool IoUringQueue::prepare_write(int fd, const void* buffer, unsigned length, uint64_t offset, uint64_t user_data)
+{
+    io_uring_sqe* sqe = static_cast<io_uring_sqe*>(next_sqe());
+    if (nullptr == sqe) {
+        return false;
+    }
+
+    // IORING_OP_WRITE needs kernel 5.6, older kernels complete it with -EINVAL
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buffer);
+    sqe->len = length;
+    sqe->off = offset;
+    sqe->user_data = user_data;
+    return true;
+}
+
+bool IoUringQueue::prepare_fsync(int fd, bool data_only, uint64_t user_data)
+{
+    io_uring_sqe* sqe = static_cast<io_uring_sqe*>(next_sqe());
+    if (nullptr == sqe) {
+        return false;
+    }
+    sqe->opcode = IORING_OP_FSYNC;
+    sqe->fd = fd;
+    sqe->fsync_flags = data_only ? IORING_FSYNC_DATASYNC : 0;
+    sqe->user_data = user_data;
+    return true;
+}
+
+bool IoUringQueue::prepare_unlink(const char* path, uint64_t user_data)
+{
+    io_uring_sqe* sqe = static_cast<io_uring_sqe*>(next_sqe());
+    if (nullptr == sqe) {
+        return false;
+    }
+
+    // IORING_OP_UNLINKAT needs kernel 5.11, older kernels fail it on submission with -EINVAL,
+    // which ends the submission, entries queued after it are submitted by the next io_uring_enter
+    sqe->opcode = IORING_OP_UNLINKAT;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = reinterpret_cast<uint64_t>(path);
+    sqe->unlink_flags = 0;
+    sqe->user_data = user_data;
+    return true;
+}
+
+bool IoUringQueue::link_last()
+{
+    if (nullptr == last_sqe_) {
+        return false;
+    }
+    static_cast<io_uring_sqe*>(last_sqe_)->flags |= IOSQE_IO_LINK;
+    return true;
+}
+
+bool IoUringQueue::submit(unsigned wait_count)
+{
+    if (!is_ready()) {
+        return false;
+    }
+
+    __atomic_store_n(sq_tail_, sqe_tail_, __ATOMIC_RELEASE);
+    last_sqe_ = nullptr;
+
+    // The kernel may consume only a part of the published entries: an entry failed on preparation
+    // completes with an error and ends the submission, the rest stay in the ring.
+    // Entries not consumed yet are counted from the head the kernel advances, not from the local tail
+    for (;;) {
+        unsigned pending = sqe_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+        if (0 == pending) {
+            break;
+        }
+
+        int submitted = io_uring_enter(ring_fd_, pending, 0, 0);
+        if (submitted > 0) {
+            continue;
+        }
+        if (submitted < 0 && errno == EINTR) {
+            continue;
+        }
+        if (submitted < 0 && errno != EAGAIN && errno != EBUSY) {
+            return false;
+        }
+
+        // out of resources, or the completion ring is full: completions have to be taken
+        // from the ring before the kernel accepts more entries
+        if (!reap_completions()) {
+            return false;
+        }
+    }
+
+    while (wait_count > reaped_.size()) {
+        unsigned ready = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE) - *cq_head_;
+        unsigned wanted = wait_count - static_cast<unsigned>(reaped_.size());
+        if (ready >= wanted) {
+            break;
+        }
+        if (io_uring_enter(ring_fd_, 0, wanted, IORING_ENTER_GETEVENTS) >= 0) {
+            break;
+        }
+        if (errno != EINTR) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool IoUringQueue::reap_completions()
+{
+    unsigned head = *cq_head_;
+    unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    if (head == tail) {
+        // nothing to free, wait until any operation consumed by the kernel completes
+        unsigned pending = sqe_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+        if (in_flight_ - static_cast<unsigned>(reaped_.size()) <= pending) {
+            return false;
+        }
+        if (io_uring_enter(ring_fd_, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+            return false;
+        }
+        tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    }
+
+    for (; head != tail; ++head) {
+        const io_uring_cqe* cqe = static_cast<const io_uring_cqe*>(cqes_) + (head & cq_mask_);
+        reaped_.push_back(IoUringCompletion{ cqe->user_data, cqe->res });
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    return true;
+}
+
+bool IoUringQueue::peek_completion(IoUringCompletion& completion)
+{
+    if (!is_ready()) {
+        return false;
+    }
+
+    // completions taken from the ring during submission go first
+    if (!reaped_.empty()) {
+        completion = reaped_.front();
+        reaped_.pop_front();
+        --in_flight_;
+        return true;
+    }
+
+    unsigned head = *cq_head_;
+    unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    if (head == tail) {
+        return false;
+    }
+
+    const io_uring_cqe* cqe = static_cast<const io_uring_cqe*>(cqes_) + (head & cq_mask_);
+    completion.user_data = cqe->user_data;
+    completion.result = cqe->res;
+    __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+    --in_flight_;
+    return true;
+}
+
+bool IoUringQueue::wait_completion(IoUringCompletion& completion)
+{
+    while (!peek_completion(completion)) {
+        if (0 == in_flight_) {
+            return false;
+        }
+        // published entries the kernel has not consumed yet go with the wait, otherwise it never ends
+        unsigned pending = __atomic_load_n(sq_tail_, __ATOMIC_ACQUIRE) - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+        if (io_uring_enter(ring_fd_, pending, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#else
+
+bool IoUringQueue::init(unsigned queue_depth)
+{
+    return false;
+}
+
+void IoUringQueue::close()
+{
+}
+
+bool IoUringQueue::register_buffers(const std::vector<std::pair<void*, size_t>>& buffers)
+{
+    return false;
+}
+
+void* IoUringQueue::next_sqe()
+{
+    return nullptr;
+}
+
+bool IoUringQueue::reap_completions()
+{
+    return false;
+}
+
+bool IoUringQueue::prepare_read_fixed(int fd, void* buffer, unsigned length, uint64_t offset, unsigned buffer_index, uint64_t user_data)
+{
+    return false;
+}
+
+bool IoUringQueue::prepare_read(int fd, void* buffer, unsigned length, uint64_t offset, uint64_t user_data)
+{
+    return false;
+}
+
+bool IoUringQueue::prepare_write_fixed(int fd, const void* buffer, unsigned length, uint64_t offset, unsigned buffer_index, uint64_t user_data)
+{
+    return false;
+}
+
+bool IoUringQueue::prepare_write(int fd, const void* buffer, unsigned length, uint64_t offset, uint64_t user_data)
+{
+    return false;
+}
+
+bool IoUringQueue::prepare_fsync(int fd, bool data_only, uint64_t user_data)
+{
+    return false;
+}
+
+bool IoUringQueue::prepare_unlink(const char* path, uint64_t user_data)
+{
+    return false;
+}
+
+bool IoUringQueue::link_last()
+{
+    return false;
+}
+
+bool IoUringQueue::submit(unsigned wait_count)
+{
+    return false;
+}
+
+bool IoUringQueue::peek_completion(IoUringCompletion& completion)
+{
+    return false;
+}
+
+bool IoUringQueue::wait_completion(IoUringCompletion& completion)
+{
+    return false;
+}
+
+#endif // defined(ERASER_HAS_IO_URING)
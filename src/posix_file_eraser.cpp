@@ -1,81 +1,426 @@
 #if defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
-#include <win_file_eraser/destructabe_file.h>
+#include <eraser/posix_file_eraser.h>
+#include <eraser/io_uring_eraser.h>
+#include <eraser/io_uring_queue.h>
+#include <winapi-helpers/utilities.h>
 
 #include <algorithm>
+#include <limits>
 #include <vector>
 #include <cassert>
-#include <sstream>
+#include <cerrno>
 
-#include <boost/filesystem.hpp>
-#include <boost/system/error_code.hpp>
-#include <boost/uuid/uuid.hpp>            // uuid class
-#include <boost/uuid/uuid_generators.hpp> // generators
-#include <boost/uuid/uuid_io.hpp>         // streaming operators etc.
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <linux/fs.h>
+#include <linux/fiemap.h>
+#endif
 
+using namespace helpers;
+using namespace shredder;
 
-namespace fs = boost::filesystem;
-namespace bs = boost::system;
+std::default_random_engine NativeFileEraser::generator_;
 
-NativeFileEraser::NativeFileEraser(const std::wstring& filename, FileSpecific attributes/* = FileSpecific::Unknown*/)
+NativeFileEraser::NativeFileEraser(const std::wstring& filename, EntropyEstimation estimation, DiskType disk_type,
+                                   DurabilityPolicy durability)
+    : disk_type_(disk_type), durability_(durability), information_estimation_(estimation)
 {
+    open(filename);
+}
+
+NativeFileEraser::~NativeFileEraser()
+{
+    close();
+}
+
+// static
+bool NativeFileEraser::clean_ntfs_journal(const std::wstring&)
+{
+    return false;
+}
+
+// static
+bool NativeFileEraser::sync_filesystem(const std::wstring& path)
+{
+#if defined(__linux__)
+    int descriptor = ::open(helpers::wstring_to_utf8(path).c_str(), O_RDONLY | O_CLOEXEC);
+    if (descriptor < 0) {
+        return false;
+    }
+    const bool synced = (0 == ::syncfs(descriptor));
+    ::close(descriptor);
+    return synced;
+#else
+    ::sync();
+    return true;
+#endif
+}
+
+// static
+bool NativeFileEraser::flush_file(const std::wstring& filename)
+{
+    int descriptor = ::open(helpers::wstring_to_utf8(filename).c_str(), O_WRONLY | O_CLOEXEC);
+    if (descriptor < 0) {
+        return false;
+    }
+#if defined(__APPLE__)
+    const bool flushed = (0 == ::fsync(descriptor));
+#else
+    const bool flushed = (0 == ::fdatasync(descriptor));
+#endif
+    ::close(descriptor);
+    return flushed;
+}
+
+// static
+bool NativeFileEraser::trim_filesystem(const std::wstring& path, std::vector<EraseRange> ranges)
+{
+#if defined(__linux__) && defined(FITRIM)
+    coalesce_ranges(ranges);
+    if (ranges.empty()) {
+        return true;
+    }
+
+    int descriptor = ::open(helpers::wstring_to_utf8(path).c_str(), O_RDONLY | O_CLOEXEC);
+    if (descriptor < 0) {
+        return false;
+    }
+    // FIEMAP physical offsets are the FITRIM address space of ext4, XFS and Btrfs,
+    // only free blocks inside the range are discarded
+    bool trimmed = true;
+    for (const EraseRange& released : ranges) {
+        fstrim_range range{};
+        range.start = released.offset;
+        range.len = released.length;
+        range.minlen = 0;
+        if (0 != ::ioctl(descriptor, FITRIM, &range)) {
+            trimmed = false;
+            break;
+        }
+    }
+    ::close(descriptor);
+    return trimmed;
+#else
+    return false;
+#endif
 }
 
 bool NativeFileEraser::open(const std::wstring& filename)
 {
+    std::string path = helpers::wstring_to_utf8(filename);
+    struct stat file_stat{};
+    if (0 != ::stat(path.c_str(), &file_stat) || !S_ISREG(file_stat.st_mode)) {
+        return false;
+    }
+
+    // remove read-only attribute
+    if (0 == (file_stat.st_mode & S_IWUSR)) {
+        ::chmod(path.c_str(), file_stat.st_mode | S_IWUSR);
+    }
+
+    // try at least twice
+    if (try_open(path) || try_open(path)) {
+        return true;
+    }
+    // unable to open, do nothing
     return false;
 }
 
 void NativeFileEraser::close()
 {
+    if (io_uring_eraser_ && file_descriptor_ >= 0) {
+        // the engine syncs and closes the file after queued writes
+        io_uring_eraser_->finish_file(file_descriptor_, direct_descriptor_, std::string(), DurabilityPolicy::PerFile == durability_);
+        file_descriptor_ = direct_descriptor_ = -1;
+    }
+
+    close_direct();
+    if (file_descriptor_ >= 0) {
+        // data is on the drive before the file node is erased, written through or synced by the caller otherwise
+        if (written_ && DurabilityPolicy::PerFile == durability_) {
+#if defined(__APPLE__)
+            ::fsync(file_descriptor_);
+#else
+            ::fdatasync(file_descriptor_);
+#endif
+        }
+        ::close(file_descriptor_);
+    }
+    file_descriptor_ = -1;
+    written_ = false;
+}
+
+bool NativeFileEraser::flush()
+{
+    if (file_descriptor_ < 0) {
+        return false;
+    }
+    if (io_uring_eraser_) {
+        io_uring_eraser_->wait_file(file_descriptor_);
+        buffered_in_flight_ = direct_in_flight_ = false;
+    }
+    if (!written_ || DurabilityPolicy::PerWrite == durability_) {
+        return true;
+    }
+#if defined(__APPLE__)
+    return 0 == ::fsync(file_descriptor_);
+#else
+    return 0 == ::fdatasync(file_descriptor_);
+#endif
 }
 
-bool NativeFileEraser::erase_full(uint8_t* start_mask, size_t mask_length/* = 65536*/)
+void NativeFileEraser::set_verification(bool verification)
 {
-    return false;
+    verification_ = verification;
+    written_ranges_.clear();
+    written_mask_ = nullptr;
+    written_mask_length_ = 0;
+}
+
+bool NativeFileEraser::verification_job(VerificationJob& job)
+{
+    if (!verification_ || file_descriptor_ < 0 || written_ranges_.empty()) {
+        return false;
+    }
+
+    // overwrite reaches the drive before it is read back,
+    // the descriptor is writable, so that the verifier truncates the file once it is read
+    if (!flush()) {
+        return false;
+    }
+#if defined(O_DIRECT)
+    job.fd = ::open(initial_filepath_.c_str(), O_RDWR | O_CLOEXEC | O_DIRECT);
+#endif
+    if (job.fd < 0) {
+        job.fd = ::open(initial_filepath_.c_str(), O_RDWR | O_CLOEXEC);
+        if (job.fd < 0) {
+            return false;
+        }
+        // read the drive rather than the page cache
+#if defined(F_NOCACHE)
+        ::fcntl(job.fd, F_NOCACHE, 1);
+#elif defined(POSIX_FADV_DONTNEED)
+        ::posix_fadvise(job.fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+    }
+
+    job.path = initial_filepath_;
+    job.mask.assign(written_mask_, written_mask_ + written_mask_length_);
+    job.ranges = written_ranges_.ranges();
+    written_ranges_.clear();
+    return true;
+}
+
+bool NativeFileEraser::close_and_unlink(const std::wstring& unlink_path)
+{
+    std::string path = helpers::wstring_to_utf8(unlink_path);
+    if (io_uring_eraser_ && file_descriptor_ >= 0) {
+        const bool finished = io_uring_eraser_->finish_file(file_descriptor_, direct_descriptor_, path,
+                                                            DurabilityPolicy::PerFile == durability_);
+        file_descriptor_ = direct_descriptor_ = -1;
+        close_direct();
+        return finished;
+    }
+
+    close();
+    return 0 == ::unlink(path.c_str());
+}
+
+void NativeFileEraser::set_block_size(size_t block_size)
+{
+    assert(block_size > 0);
+    block_size_ = std::max<size_t>(block_size, 1);
+    write_block_.clear();
+    direct_buffers_.release();
+}
+
+bool NativeFileEraser::set_direct_io(bool direct_io, bool huge_pages)
+{
+    close_direct();
+    if (!direct_io) {
+        return true;
+    }
+    if (file_descriptor_ < 0) {
+        return false;
+    }
+
+#if defined(O_DIRECT)
+    // tmpfs and some FUSE filesystems refuse O_DIRECT by EINVAL
+    direct_descriptor_ = ::open(initial_filepath_.c_str(), O_WRONLY | O_CLOEXEC | O_DIRECT | sync_flags());
+#elif defined(F_NOCACHE)
+    direct_descriptor_ = ::open(initial_filepath_.c_str(), O_WRONLY | O_CLOEXEC | sync_flags());
+    if (direct_descriptor_ >= 0 && -1 == ::fcntl(direct_descriptor_, F_NOCACHE, 1)) {
+        close_direct();
+    }
+#endif
+    huge_pages_ = huge_pages;
+    return direct_descriptor_ >= 0;
+}
+
+void NativeFileEraser::set_resume_offset(uint64_t offset)
+{
+    resume_offset_ = offset;
 }
 
-bool NativeFileEraser::erase_random(BYTE* start_mask, size_t mask_length, size_t areas/* = 0*/)
+void NativeFileEraser::set_checkpoint(uint64_t interval, std::function<void(uint64_t)> checkpoint)
+{
+    checkpoint_interval_ = interval;
+    checkpoint_ = std::move(checkpoint);
+}
+
+void NativeFileEraser::set_io_uring_eraser(IoUringEraser* io_uring_eraser)
+{
+    io_uring_eraser_ = (io_uring_eraser && io_uring_eraser->is_ready()) ? io_uring_eraser : nullptr;
+}
+
+bool NativeFileEraser::erase_full(uint8_t* start_mask, size_t mask_length)
+{
+    if (file_descriptor_ < 0 || (0 == file_size_)) {
+        return false;
+    }
+
+    if (!prepared_to_erase_) {
+        prepare({ { 0, file_size_ } });
+    }
+
+    // the rest of the file is streamed from the resume offset, by checkpoint intervals if progress is journaled
+    uint64_t bytes_erased = std::min(resume_offset_, file_size_);
+    resume_offset_ = 0;
+    const uint64_t interval = (checkpoint_ && checkpoint_interval_ > 0) ? checkpoint_interval_ : file_size_;
+    while (bytes_erased < file_size_) {
+        const uint64_t erase_chunk = std::min(interval, file_size_ - bytes_erased);
+        if (!write_range(bytes_erased, erase_chunk, start_mask, mask_length)) {
+            return false;
+        }
+        bytes_erased += erase_chunk;
+
+        // written data is on the drive before the progress is recorded
+        if (checkpoint_ && bytes_erased < file_size_ && flush()) {
+            checkpoint_(bytes_erased);
+        }
+    }
+    return true;
+}
+
+bool NativeFileEraser::erase_random(uint8_t* start_mask, size_t mask_length)
 {
     if (megabyte_ > file_size_) {
         return erase_full(start_mask, mask_length);
     }
 
+    // every pass of the multi-pass erasure overwrites the same areas
+    if (random_ranges_.empty()) {
+        uint64_t begin_offset = 0;
+        uint64_t end_offset = file_size_ - mask_length;
+        uint64_t erased_areas = file_size_ / (mask_length * 5);
+
+        // add erase at begin, end and generate erase points in the middle (linearly distributed)
+        random_ranges_.push_back({ begin_offset, mask_length });
+        std::uniform_int_distribution<uint64_t> distribution(mask_length, end_offset - mask_length);
+        for (uint64_t i = 0; i < erased_areas; ++i) {
+            random_ranges_.push_back({ distribution(generator_), mask_length });
+        }
+        random_ranges_.push_back({ end_offset, mask_length });
+
+        // one write per distinct extent, not per point
+        coalesce_ranges(random_ranges_);
+    }
+
     if (!prepared_to_erase_) {
-        prepare();
+        prepare(random_ranges_);
     }
 
-    return false;
+    for (const EraseRange& erase_range : random_ranges_) {
+        assert(erase_range.end() <= file_size_);
+        if (!write_repeated(erase_range.offset, erase_range.length, start_mask, mask_length)) {
+            return false;
+        }
+    }
+    return true;
 }
 
-bool NativeFileEraser::erase_begin_end(BYTE* start_mask, size_t mask_length)
+bool NativeFileEraser::erase_begin_end(uint8_t* start_mask, size_t mask_length)
 {
     if (megabyte_ > file_size_) {
         return erase_full(start_mask, mask_length);
     }
 
     if (!prepared_to_erase_) {
-        prepare();
+        std::vector<EraseRange> overwritten{ { 0, mask_length }, { file_size_ - mask_length, mask_length } };
+        coalesce_ranges(overwritten);
+        prepare(overwritten);
     }
 
-    return false;
+    record_write(0, mask_length, start_mask, mask_length, 0);
+    if (!write_at(0, start_mask, mask_length)) {
+        return false;
+    }
+    record_write(file_size_ - mask_length, mask_length, start_mask, mask_length, 0);
+    return write_at(file_size_ - mask_length, start_mask, mask_length);
 }
 
-bool NativeFileEraser::erase_smart(BYTE* start_mask, size_t mask_length)
+bool NativeFileEraser::erase_discard(uint8_t* start_mask, size_t mask_length)
 {
-    if (big_file_) {
-        return erase_random(start_mask, mask_length, 0x0F);
+    if (file_descriptor_ < 0 || (0 == file_size_) || (0 == mask_length)) {
+        return false;
+    }
+
+    // header and footer are overwritten up to the filesystem block boundary, blocks between them are released
+    constexpr uint64_t alignment = AlignedBufferPool::IO_ALIGNMENT;
+    const uint64_t hole_begin = std::min<uint64_t>((mask_length + alignment - 1) / alignment * alignment, file_size_);
+    const uint64_t hole_end = std::max<uint64_t>((file_size_ - std::min<uint64_t>(mask_length, file_size_)) / alignment * alignment,
+                                                 hole_begin);
+    if (!write_range(0, hole_begin, start_mask, mask_length) ||
+        !write_range(hole_end, file_size_ - hole_end, start_mask, mask_length)) {
+        return false;
+    }
+    if (hole_begin == hole_end) {
+        return true;
     }
-    else if (false == big_file_ && information_estimation_ == FileSpecific::Encrypted) {
+
+    if (io_uring_eraser_) {
+        // queued writes of the middle would allocate released blocks again
+        io_uring_eraser_->wait_file(file_descriptor_);
+        buffered_in_flight_ = direct_in_flight_ = false;
+    }
+    // blocks are located before they are released, so that only they are trimmed afterwards
+    std::vector<EraseRange> hole_extents;
+    find_physical_extents(hole_begin, hole_end - hole_begin, hole_extents);
+    if (punch_hole(hole_begin, hole_end - hole_begin)) {
+        released_extents_.insert(released_extents_.end(), hole_extents.begin(), hole_extents.end());
+        return true;
+    }
+
+    // filesystem does not support hole punching, overwrite the middle
+    if (!prepared_to_erase_) {
+        prepare({ { 0, file_size_ } });
+    }
+    return write_range(hole_begin, hole_end - hole_begin, start_mask, mask_length);
+}
+
+bool NativeFileEraser::erase_smart(uint8_t* start_mask, size_t mask_length)
+{
+    // map built for the same file size, otherwise file has been changed since the scan
+    if (entropy_map_ && !entropy_map_->empty() &&
+        entropy_map_->regions_count() == (file_size_ + entropy_map_->region_size() - 1) / entropy_map_->region_size()) {
+        return erase_regions(start_mask, mask_length);
+    }
+
+    if (information_estimation_ == ShannonEncryptionChecker::Encrypted) {
         return erase_begin_end(start_mask, mask_length);
     }
-    else if (false == big_file_ && information_estimation_ == FileSpecific::Binary) {
-        return erase_random(start_mask, mask_length);
+    else if (information_estimation_ == ShannonEncryptionChecker::Binary) {
+        return erase_full(start_mask, mask_length);
     }
-    else if (false == big_file_ && information_estimation_ == FileSpecific::Plain) {
+    else if (information_estimation_ == ShannonEncryptionChecker::Plain) {
         return erase_full(start_mask, mask_length);
     }
-    else if (information_estimation_ == FileSpecific::Unknown) {
-        return erase_random(start_mask, mask_length);
+    else if (information_estimation_ == ShannonEncryptionChecker::Unknown) {
+        return erase_full(start_mask, mask_length);
     }
 
     // we did not covered something?
@@ -83,13 +428,524 @@ bool NativeFileEraser::erase_smart(BYTE* start_mask, size_t mask_length)
     return false;
 }
 
-bool NativeFileEraser::prepare()
+void NativeFileEraser::set_entropy_map(std::shared_ptr<const EntropyMap> entropy_map)
 {
+    entropy_map_ = std::move(entropy_map);
 }
 
-bool NativeFileEraser::try_open(const std::wstring& filename)
+bool NativeFileEraser::erase_regions(uint8_t* start_mask, size_t mask_length)
+{
+    if (file_descriptor_ < 0 || (0 == file_size_)) {
+        return false;
+    }
+
+    const uint64_t region_size = entropy_map_->region_size();
+    std::vector<EraseRange> erase_ranges;
+    for (size_t region = 0; region < entropy_map_->regions_count(); ++region) {
+        const uint64_t region_begin = region * region_size;
+        const uint64_t region_length = std::min<uint64_t>(region_size, file_size_ - region_begin);
+
+        // high-entropy region is useless without its beginning, plain and binary ones are erased fully
+        uint64_t erase_length = region_length;
+        if (ShannonEncryptionChecker::Encrypted ==
+            ShannonEncryptionChecker::information_entropy_estimation(entropy_map_->entropy(region), region_length)) {
+            erase_length = std::min<uint64_t>(region_length, mask_length);
+        }
+        erase_ranges.push_back({ region_begin, erase_length });
+    }
+
+    if (!prepared_to_erase_) {
+        std::vector<EraseRange> overwritten = erase_ranges;
+        if (megabyte_ <= file_size_) {
+            overwritten.push_back({ 0, mask_length });
+            overwritten.push_back({ file_size_ - mask_length, mask_length });
+        }
+        coalesce_ranges(overwritten);
+        prepare(overwritten);
+    }
+
+    for (const EraseRange& erase_range : erase_ranges) {
+        if (!write_range(erase_range.offset, erase_range.length, start_mask, mask_length)) {
+            return false;
+        }
+    }
+
+    if (megabyte_ > file_size_) {
+        return true;
+    }
+    return erase_begin_end(start_mask, mask_length);
+}
+
+bool NativeFileEraser::prepare(const std::vector<EraseRange>& overwritten)
+{
+    // static, so that it is valid until asynchronous writes complete
+    static constexpr uint8_t anchor = 0xEF;
+
+    if (0 == file_size_) {
+        return false;
+    }
+
+    // the last byte and, on SSD, every anchor_step_ bytes. The overwrite writes covered anchors anyway,
+    // holes are never written
+    std::vector<uint64_t> anchor_points;
+    auto add_anchor = [&](uint64_t anchor_point) {
+        if (!contains_offset(overwritten, anchor_point) && (!sparse_ || contains_offset(data_extents_, anchor_point))) {
+            anchor_points.push_back(anchor_point);
+        }
+    };
+    if (disk_type_ == helpers::PartititonInformation::SSD) {
+        for (uint64_t anchor_point = anchor_step_; anchor_point < file_size_ - 1; anchor_point += anchor_step_) {
+            add_anchor(anchor_point);
+        }
+    }
+    add_anchor(file_size_ - 1);
+
+    if (!write_anchors(anchor_points, &anchor)) {
+        return false;
+    }
+
+    // we can start safe erase
+    prepared_to_erase_ = true;
+
+    return true;
+}
+
+bool NativeFileEraser::try_open(const std::string& filename)
 {
     // First, open the file in overwrite mode
+    file_descriptor_ = ::open(filename.c_str(), O_WRONLY | O_CLOEXEC | sync_flags());
+    if (file_descriptor_ < 0) {
+        return false;
+    }
+
+    initial_filepath_ = filename;
+
+    struct stat file_stat{};
+    if (0 != ::fstat(file_descriptor_, &file_stat)) {
+        ::close(file_descriptor_);
+        file_descriptor_ = -1;
+        return false;
+    }
+    file_size_ = static_cast<uint64_t>(file_stat.st_size);
+    find_data_extents();
+
+    return true;
+}
+
+bool NativeFileEraser::punch_hole(uint64_t offset, uint64_t length)
+{
+#if defined(__linux__) && defined(FALLOC_FL_PUNCH_HOLE)
+    // ext4, XFS, Btrfs and tmpfs, EOPNOTSUPP otherwise. Filesystems mounted with discard also TRIM the range
+    while (0 != ::fallocate(file_descriptor_, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                            static_cast<off_t>(offset), static_cast<off_t>(length))) {
+        if (errno != EINTR) {
+            return false;
+        }
+    }
+    return true;
+#elif defined(F_PUNCHHOLE)
+    // APFS, the range is block-aligned
+    fpunchhole_t hole{};
+    hole.fp_offset = static_cast<off_t>(offset);
+    hole.fp_length = static_cast<off_t>(length);
+    return (0 == ::fcntl(file_descriptor_, F_PUNCHHOLE, &hole));
+#else
+    return false;
+#endif
+}
+
+bool NativeFileEraser::find_physical_extents(uint64_t offset, uint64_t length, std::vector<EraseRange>& extents) const
+{
+#if defined(__linux__) && defined(FS_IOC_FIEMAP)
+    constexpr unsigned extents_per_call = 64;
+    std::vector<uint8_t> buffer(sizeof(fiemap) + extents_per_call * sizeof(fiemap_extent));
+    fiemap* map = reinterpret_cast<fiemap*>(buffer.data());
+    const uint64_t end = offset + length;
+    uint64_t position = offset;
+    while (position < end) {
+        std::fill(buffer.begin(), buffer.end(), 0);
+        map->fm_start = position;
+        map->fm_length = end - position;
+        map->fm_extent_count = extents_per_call;
+        if (0 != ::ioctl(file_descriptor_, FS_IOC_FIEMAP, map)) {
+            return false;
+        }
+        if (0 == map->fm_mapped_extents) {
+            break;
+        }
+
+        for (unsigned i = 0; i < map->fm_mapped_extents; ++i) {
+            const fiemap_extent& extent = map->fm_extents[i];
+            // extents not yet allocated or not addressable by blocks are not trimmed
+            const uint64_t logical_begin = std::max<uint64_t>(extent.fe_logical, offset);
+            const uint64_t logical_end = std::min<uint64_t>(extent.fe_logical + extent.fe_length, end);
+            if (logical_begin < logical_end &&
+                !(extent.fe_flags & (FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DELALLOC | FIEMAP_EXTENT_ENCODED | FIEMAP_EXTENT_DATA_INLINE))) {
+                extents.push_back({ extent.fe_physical + (logical_begin - extent.fe_logical), logical_end - logical_begin });
+            }
+            position = (extent.fe_flags & FIEMAP_EXTENT_LAST) ? end : extent.fe_logical + extent.fe_length;
+        }
+    }
+    return true;
+#else
     return false;
+#endif
 }
+
+bool NativeFileEraser::find_data_extents()
+{
+    data_extents_.clear();
+    sparse_ = false;
+
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+    // the end of the file is a hole, SEEK_DATA past the last extent fails by ENXIO
+    off_t data = ::lseek(file_descriptor_, 0, SEEK_DATA);
+    while (data >= 0 && static_cast<uint64_t>(data) < file_size_) {
+        off_t hole = ::lseek(file_descriptor_, data, SEEK_HOLE);
+        if (hole <= data) {
+            data_extents_.clear();
+            return false;
+        }
+        const uint64_t extent_end = std::min(static_cast<uint64_t>(hole), file_size_);
+        data_extents_.push_back({ static_cast<uint64_t>(data), extent_end - static_cast<uint64_t>(data) });
+        data = ::lseek(file_descriptor_, hole, SEEK_DATA);
+    }
+    if (data < 0 && errno != ENXIO) {
+        data_extents_.clear();
+        return false;
+    }
+
+    // filesystems not supporting holes report one extent of the file size
+    sparse_ = (file_size_ > 0) &&
+        !(1 == data_extents_.size() && 0 == data_extents_.front().offset && file_size_ == data_extents_.front().length);
+    if (!sparse_) {
+        data_extents_.clear();
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool NativeFileEraser::split_by_extents(uint64_t offset, uint64_t length, std::vector<EraseRange>& parts) const
+{
+    if (!sparse_ || 0 == length) {
+        return false;
+    }
+    intersect_range(data_extents_, { offset, length }, parts);
+    return !(1 == parts.size() && offset == parts.front().offset && length == parts.front().length);
+}
+
+void NativeFileEraser::record_write(uint64_t offset, uint64_t length, const uint8_t* start_mask, size_t mask_length, uint64_t period)
+{
+    if (!verification_ || offset >= file_size_) {
+        return;
+    }
+
+    // the next pass overwrites the previous one
+    if (written_mask_ != start_mask || written_mask_length_ != mask_length) {
+        written_ranges_.clear();
+        written_mask_ = start_mask;
+        written_mask_length_ = mask_length;
+    }
+
+    // holes are never written, the origin of the mask stays the same
+    WrittenRange written_range{ offset, std::min(length, file_size_ - offset), offset, period };
+    std::vector<EraseRange> parts;
+    if (split_by_extents(written_range.offset, written_range.length, parts)) {
+        for (const EraseRange& part : parts) {
+            written_range.offset = part.offset;
+            written_range.length = part.length;
+            written_ranges_.add(written_range);
+        }
+        return;
+    }
+    written_ranges_.add(written_range);
+}
+
+int NativeFileEraser::sync_flags() const
+{
+    // as FILE_FLAG_WRITE_THROUGH on Windows
+    return (DurabilityPolicy::PerWrite == durability_) ? O_DSYNC : 0;
+}
+
+bool NativeFileEraser::write_at(uint64_t offset, const uint8_t* buffer, size_t length)
+{
+    // never write past the end, the file size should not change
+    if (offset >= file_size_) {
+        return (0 == length);
+    }
+    length = static_cast<size_t>(std::min<uint64_t>(length, file_size_ - offset));
+
+    // holes of the sparse file are skipped
+    std::vector<EraseRange> parts;
+    if (split_by_extents(offset, length, parts)) {
+        for (const EraseRange& part : parts) {
+            if (!write_at(part.offset, buffer + (part.offset - offset), static_cast<size_t>(part.length))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    if (io_uring_eraser_) {
+        if (direct_in_flight_) {
+            io_uring_eraser_->wait_file(file_descriptor_);
+            direct_in_flight_ = false;
+        }
+        buffered_in_flight_ = (direct_descriptor_ >= 0);
+        written_ = true;
+        return io_uring_eraser_->write(file_descriptor_, offset, buffer, length);
+    }
+
+    while (length > 0) {
+        ssize_t bytes_written = ::pwrite(file_descriptor_, buffer, length, static_cast<off_t>(offset));
+        if (bytes_written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        if (0 == bytes_written) {
+            return false;
+        }
+        buffer += bytes_written;
+        length -= static_cast<size_t>(bytes_written);
+        offset += static_cast<uint64_t>(bytes_written);
+        written_ = true;
+    }
+    return true;
+}
+
+bool NativeFileEraser::write_anchors(const std::vector<uint64_t>& anchor_points, const uint8_t* anchor)
+{
+    // the engine submits the whole queue depth of anchors by one system call, so does the short-lived queue.
+    // There is no vectored write to scattered offsets otherwise
+    IoUringQueue queue;
+    if (io_uring_eraser_ || anchor_points.size() < 2 || !queue.init(anchor_queue_depth_)) {
+        for (uint64_t anchor_point : anchor_points) {
+            if (!write_at(anchor_point, anchor, 1)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // anchors are inside the file and its allocated extents, see prepare()
+    for (size_t first = 0; first < anchor_points.size(); first += queue.queue_depth()) {
+        const size_t last = std::min<size_t>(anchor_points.size(), first + queue.queue_depth());
+        for (size_t point = first; point < last; ++point) {
+            if (!queue.prepare_write(file_descriptor_, anchor, 1, anchor_points[point], point)) {
+                return false;
+            }
+        }
+        if (!queue.submit()) {
+            return false;
+        }
+
+        bool completed = true;
+        while (queue.in_flight() > 0) {
+            IoUringCompletion completion;
+            if (!queue.wait_completion(completion)) {
+                return false;
+            }
+            completed = completed && (1 == completion.result);
+        }
+        if (!completed) {
+            return false;
+        }
+        written_ = true;
+    }
+    return true;
+}
+
+bool NativeFileEraser::write_repeated(uint64_t offset, uint64_t length, const uint8_t* start_mask, size_t mask_length)
+{
+    // never write past the end, as write_at()
+    if (offset >= file_size_ || 0 == mask_length) {
+        return (0 == length);
+    }
+    length = std::min(length, file_size_ - offset);
+
+    std::vector<EraseRange> parts;
+    if (split_by_extents(offset, length, parts)) {
+        for (const EraseRange& part : parts) {
+            if (!write_repeated(part.offset, part.length, start_mask, mask_length)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    if (io_uring_eraser_) {
+        if (direct_in_flight_) {
+            io_uring_eraser_->wait_file(file_descriptor_);
+            direct_in_flight_ = false;
+        }
+        buffered_in_flight_ = (direct_descriptor_ >= 0);
+        written_ = true;
+        record_write(offset, length, start_mask, mask_length, io_uring_eraser_->block_size());
+        return io_uring_eraser_->write_pattern(file_descriptor_, offset, length, start_mask, mask_length);
+    }
+
+    // every vector points to the mask, the extent is written by one call unless it is longer than IOV_MAX masks
+    record_write(offset, length, start_mask, mask_length, 0);
+    std::vector<iovec> vectors;
+    for (uint64_t bytes_erased = 0; bytes_erased < length; ) {
+        vectors.clear();
+        size_t mask_offset = static_cast<size_t>(bytes_erased % mask_length);
+        for (uint64_t bytes_queued = bytes_erased; bytes_queued < length && vectors.size() < max_vectors_; mask_offset = 0) {
+            size_t vector_length = static_cast<size_t>(std::min<uint64_t>(mask_length - mask_offset, length - bytes_queued));
+            vectors.push_back({ const_cast<uint8_t*>(start_mask) + mask_offset, vector_length });
+            bytes_queued += vector_length;
+        }
+
+        ssize_t bytes_written = ::pwritev(file_descriptor_, vectors.data(), static_cast<int>(vectors.size()),
+                                          static_cast<off_t>(offset + bytes_erased));
+        if (bytes_written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes_written <= 0) {
+            return false;
+        }
+        bytes_erased += static_cast<uint64_t>(bytes_written);
+        written_ = true;
+    }
+    return true;
+}
+
+bool NativeFileEraser::write_range(uint64_t offset, uint64_t length, const uint8_t* start_mask, size_t mask_length)
+{
+    if (0 == mask_length) {
+        return false;
+    }
+
+    std::vector<EraseRange> parts;
+    if (split_by_extents(offset, std::min(length, file_size_ - std::min(offset, file_size_)), parts)) {
+        for (const EraseRange& part : parts) {
+            if (!write_range(part.offset, part.length, start_mask, mask_length)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    if (direct_descriptor_ >= 0 && offset < file_size_) {
+        // direct I/O never writes past the end, the unaligned tail of the file is always buffered
+        constexpr uint64_t alignment = AlignedBufferPool::IO_ALIGNMENT;
+        const uint64_t end = std::min(offset + length, file_size_);
+        const uint64_t direct_begin = (offset + alignment - 1) / alignment * alignment;
+        const uint64_t direct_end = end / alignment * alignment;
+        if (direct_begin < direct_end) {
+            return write_blocks(offset, direct_begin - offset, start_mask, mask_length) &&
+                write_direct(direct_begin, direct_end - direct_begin, start_mask, mask_length) &&
+                write_blocks(direct_end, end - direct_end, start_mask, mask_length);
+        }
+    }
+    return write_blocks(offset, length, start_mask, mask_length);
+}
+
+bool NativeFileEraser::write_blocks(uint64_t offset, uint64_t length, const uint8_t* start_mask, size_t mask_length)
+{
+    if (0 == length) {
+        return true;
+    }
+
+    if (io_uring_eraser_) {
+        // never write past the end, as write_at()
+        if (offset >= file_size_) {
+            return true;
+        }
+        written_ = true;
+        record_write(offset, length, start_mask, mask_length, io_uring_eraser_->block_size());
+        return io_uring_eraser_->write_pattern(file_descriptor_, offset, std::min(length, file_size_ - offset),
+                                               start_mask, mask_length);
+    }
+
+    // big writes take the most of sequential drive throughput
+    if (write_block_mask_ != start_mask || write_block_.size() != std::max(block_size_, mask_length)) {
+        write_block_mask_ = start_mask;
+        write_block_.resize(std::max(block_size_, mask_length));
+        for (size_t filled = 0; filled < write_block_.size(); filled += mask_length) {
+            std::copy_n(start_mask, std::min(mask_length, write_block_.size() - filled), write_block_.begin() + filled);
+        }
+    }
+
+    record_write(offset, length, start_mask, mask_length, write_block_.size());
+    for (uint64_t bytes_erased = 0; bytes_erased < length; ) {
+        size_t erase_chunk = static_cast<size_t>(std::min<uint64_t>(length - bytes_erased, write_block_.size()));
+        if (!write_at(offset + bytes_erased, write_block_.data(), erase_chunk)) {
+            return false;
+        }
+        bytes_erased += erase_chunk;
+    }
+    return true;
+}
+
+bool NativeFileEraser::write_direct(uint64_t offset, uint64_t length, const uint8_t* start_mask, size_t mask_length)
+{
+    if (io_uring_eraser_) {
+        // unaligned head and tail of the range are never in the pages of direct writes, anchors could be
+        if (buffered_in_flight_) {
+            io_uring_eraser_->wait_file(file_descriptor_);
+            buffered_in_flight_ = false;
+        }
+        direct_in_flight_ = true;
+        written_ = true;
+        record_write(offset, length, start_mask, mask_length, io_uring_eraser_->block_size());
+        return io_uring_eraser_->write_pattern(direct_descriptor_, offset, length, start_mask, mask_length, file_descriptor_);
+    }
+
+    const size_t buffer_size = std::max(block_size_, mask_length);
+    if (!direct_buffers_.is_ready() || direct_buffers_.buffer_size() < buffer_size) {
+        if (!direct_buffers_.init(1, buffer_size, huge_pages_)) {
+            close_direct();
+            return write_blocks(offset, length, start_mask, mask_length);
+        }
+        direct_buffers_mask_ = nullptr;
+    }
+    if (direct_buffers_mask_ != start_mask) {
+        direct_buffers_mask_ = start_mask;
+        direct_buffers_.fill(start_mask, mask_length);
+    }
+
+    // the mask restarts every buffer, after a short write as well
+    record_write(offset, length, start_mask, mask_length, direct_buffers_.buffer_size());
+    uint64_t bytes_erased = 0;
+    while (bytes_erased < length) {
+        const size_t buffer_offset = static_cast<size_t>(bytes_erased % direct_buffers_.buffer_size());
+        size_t erase_chunk = static_cast<size_t>(std::min<uint64_t>(length - bytes_erased, direct_buffers_.buffer_size() - buffer_offset));
+        ssize_t bytes_written = ::pwrite(direct_descriptor_, direct_buffers_.buffer(0) + buffer_offset, erase_chunk,
+                                         static_cast<off_t>(offset + bytes_erased));
+        if (bytes_written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes_written <= 0) {
+            break;
+        }
+        written_ = true;
+        bytes_erased += static_cast<uint64_t>(bytes_written);
+        if (0 != bytes_erased % AlignedBufferPool::IO_ALIGNMENT) {
+            break;
+        }
+    }
+
+    if (bytes_erased < length) {
+        // refused or short write, the rest goes through the page cache
+        close_direct();
+        return write_blocks(offset + bytes_erased, length - bytes_erased, start_mask, mask_length);
+    }
+    return true;
+}
+
+void NativeFileEraser::close_direct()
+{
+    if (direct_descriptor_ >= 0) {
+        ::close(direct_descriptor_);
+    }
+    direct_descriptor_ = -1;
+    direct_buffers_.release();
+    direct_buffers_mask_ = nullptr;
+}
+
 #endif // defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
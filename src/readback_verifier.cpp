@@ -0,0 +1,179 @@
+#if defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
+#include <eraser/readback_verifier.h>
+#include <eraser/aligned_buffer_pool.h>
+#include <plog/Log.h>
+
+#include <algorithm>
+#include <limits>
+#include <cstring>
+#include <cerrno>
+
+#include <unistd.h>
+
+using namespace shredder;
+
+void WrittenRanges::add(const WrittenRange& range)
+{
+    if (0 == range.length) {
+        return;
+    }
+
+    // the first range ending after the new one begins
+    auto it = ranges_.lower_bound(range.offset);
+    if (it != ranges_.begin() && std::prev(it)->second.end() > range.offset) {
+        --it;
+    }
+
+    // overlapped ranges are cut, their remainders keep the origin
+    std::vector<WrittenRange> remainders;
+    while (it != ranges_.end() && it->second.offset < range.end()) {
+        const WrittenRange& overlapped = it->second;
+        if (overlapped.offset < range.offset) {
+            WrittenRange head = overlapped;
+            head.length = range.offset - overlapped.offset;
+            remainders.push_back(head);
+        }
+        if (overlapped.end() > range.end()) {
+            WrittenRange tail = overlapped;
+            tail.offset = range.end();
+            tail.length = overlapped.end() - range.end();
+            remainders.push_back(tail);
+        }
+        it = ranges_.erase(it);
+    }
+    for (const WrittenRange& remainder : remainders) {
+        ranges_.emplace(remainder.offset, remainder);
+    }
+    ranges_.emplace(range.offset, range);
+}
+
+std::vector<WrittenRange> WrittenRanges::ranges() const
+{
+    std::vector<WrittenRange> ranges;
+    ranges.reserve(ranges_.size());
+    for (const auto& range : ranges_) {
+        ranges.push_back(range.second);
+    }
+    return ranges;
+}
+
+ReadBackVerifier::ReadBackVerifier()
+    : worker_(&ReadBackVerifier::run, this)
+{
+}
+
+ReadBackVerifier::~ReadBackVerifier()
+{
+    {
+        std::lock_guard<std::mutex> l(lock_);
+        stopping_ = true;
+    }
+    job_submitted_.notify_one();
+    worker_.join();
+}
+
+void ReadBackVerifier::submit(VerificationJob job)
+{
+    {
+        std::lock_guard<std::mutex> l(lock_);
+        jobs_.push_back(std::move(job));
+    }
+    job_submitted_.notify_one();
+}
+
+std::vector<std::string> ReadBackVerifier::wait()
+{
+    std::unique_lock<std::mutex> l(lock_);
+    jobs_done_.wait(l, [this]() { return jobs_.empty() && !busy_; });
+    return std::move(failed_files_);
+}
+
+void ReadBackVerifier::run()
+{
+    // direct I/O needs an aligned buffer
+    AlignedBufferPool buffer;
+    const bool buffer_ready = buffer.init(1, READ_BLOCK_SIZE);
+
+    std::unique_lock<std::mutex> l(lock_);
+    while (true) {
+        // pending files are verified before the worker stops
+        job_submitted_.wait(l, [this]() { return stopping_ || !jobs_.empty(); });
+        if (jobs_.empty()) {
+            return;
+        }
+        VerificationJob job = std::move(jobs_.front());
+        jobs_.pop_front();
+        busy_ = true;
+        l.unlock();
+
+        const bool verified = buffer_ready && verify(job, buffer.buffer(0), buffer.buffer_size());
+        if (job.truncate && job.fd >= 0 && 0 != ::ftruncate(job.fd, 0)) {
+            // the node is already removed, its blocks are released with the last descriptor anyway
+            LOG_DEBUG << "Unable to truncate verified file " << job.path << ", errno " << errno;
+        }
+        ::close(job.fd);
+
+        l.lock();
+        if (!verified) {
+            failed_files_.push_back(job.path);
+        }
+        busy_ = false;
+        if (jobs_.empty()) {
+            jobs_done_.notify_all();
+        }
+    }
+}
+
+// static
+bool ReadBackVerifier::verify(const VerificationJob& job, uint8_t* buffer, size_t buffer_size)
+{
+    if (job.fd < 0 || job.mask.empty()) {
+        return false;
+    }
+
+    constexpr uint64_t alignment = AlignedBufferPool::IO_ALIGNMENT;
+    const uint64_t mask_length = job.mask.size();
+    for (const WrittenRange& range : job.ranges) {
+        uint64_t position = range.offset;
+        while (position < range.end()) {
+            // direct reads are aligned, the range is compared within the read block
+            const uint64_t read_offset = position / alignment * alignment;
+            const uint64_t read_end = std::min<uint64_t>(read_offset + buffer_size,
+                                                         (range.end() + alignment - 1) / alignment * alignment);
+            size_t bytes_read = 0;
+            while (read_offset + bytes_read < std::min(read_end, range.end())) {
+                ssize_t result = ::pread(job.fd, buffer + bytes_read, static_cast<size_t>(read_end - read_offset) - bytes_read,
+                                         static_cast<off_t>(read_offset + bytes_read));
+                if (result < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (result <= 0) {
+                    // the file is shorter than written or unreadable
+                    return false;
+                }
+                bytes_read += static_cast<size_t>(result);
+            }
+
+            // compare runs of consecutive mask bytes, memcmp is vectorized
+            const uint64_t compare_end = std::min(read_offset + bytes_read, range.end());
+            while (position < compare_end) {
+                uint64_t period_offset = position - range.origin;
+                uint64_t period_left = std::numeric_limits<uint64_t>::max();
+                if (range.period > 0) {
+                    period_left = range.period - period_offset % range.period;
+                    period_offset %= range.period;
+                }
+                const uint64_t mask_offset = period_offset % mask_length;
+                const size_t run_length = static_cast<size_t>(
+                    std::min({ mask_length - mask_offset, period_left, compare_end - position }));
+                if (0 != std::memcmp(buffer + (position - read_offset), job.mask.data() + mask_offset, run_length)) {
+                    return false;
+                }
+                position += run_length;
+            }
+        }
+    }
+    return true;
+}
+
+#endif // defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
@@ -28,28 +28,23 @@ ShredderCache::ShredderCache()
     }
 }
 
-void ShredderCache::submit(const std::wstring& file_path, double entropy)
+void ShredderCache::submit(const std::wstring& file_path, double entropy, int64_t flags /*= 0*/,
+                           std::shared_ptr<const EntropyMap> entropy_map /*= nullptr*/)
 {
-    const size_t root_size = PartititonInformation::instance().root_string_size();
-#if defined(_WIN32) || defined(_WIN64)
-    std::wstring file_root = file_path.substr(0, root_size);
-#else
-    throw std::logic_error("Not implemented: FileShredder::submit");
-#endif
+    std::wstring file_root = partition_root(file_path);
 
     // Add record to cache
     auto it = partition_to_drive_.find(file_root);
     if (it != partition_to_drive_.end()) {
         int drive_index = (*it).second;
-        erasible_drives_[drive_index]->submit(file_root, file_path, entropy);
+        erasible_drives_[drive_index]->submit(file_root, file_path, entropy, flags, std::move(entropy_map));
     }
 }
 
 void ShredderCache::remove(const std::wstring& file_path)
 {
     // Remove from cache
-    const size_t root_size = PartititonInformation::instance().root_string_size();
-    std::wstring file_root = file_path.substr(0, root_size);
+    std::wstring file_root = partition_root(file_path);
 
     auto it = partition_to_drive_.find(file_root);
     if (it != partition_to_drive_.end()) {
@@ -66,23 +61,22 @@ void ShredderCache::clean()
     });
 }
 
-void ShredderCache::erase_files()
+std::vector<std::wstring> ShredderCache::erase_files(std::shared_ptr<const ErasureScheme> erasure_scheme /*= nullptr*/,
+                                                     ShredderDatabaseWrapper* journal /*= nullptr*/)
 {
-    std::for_each(erasible_drives_.begin(), erasible_drives_.end(), [](auto& drive) {
+    std::vector<std::wstring> unverified_files;
+    std::for_each(erasible_drives_.begin(), erasible_drives_.end(), [&erasure_scheme, journal, &unverified_files](auto& drive) {
         LOG_DEBUG << "Shred files on volume ID = " << drive.first;
-        drive.second->shred_files();
+        std::vector<std::wstring> drive_unverified = drive.second->shred_files(erasure_scheme, journal);
+        unverified_files.insert(unverified_files.end(), drive_unverified.begin(), drive_unverified.end());
     });
     cache_ready_.store(false);
+    return unverified_files;
 }
 
 bool ShredderCache::already_exist(const std::wstring& file_path)
 {
-    const size_t root_size = PartititonInformation::instance().root_string_size();
-#if defined(_WIN32) || defined(_WIN64)
-    std::wstring file_root = file_path.substr(0, root_size);
-#else
-    throw std::logic_error("Not implemented: FileShredder::submit");
-#endif
+    std::wstring file_root = partition_root(file_path);
 
     // Add record to cache
     auto it = partition_to_drive_.find(file_root);
@@ -93,6 +87,28 @@ bool ShredderCache::already_exist(const std::wstring& file_path)
     return false;
 }
 
+std::wstring ShredderCache::partition_root(const std::wstring& file_path) const
+{
+#if defined(_WIN32) || defined(_WIN64)
+    const size_t root_size = PartititonInformation::instance().root_string_size();
+    return file_path.substr(0, root_size);
+#else
+    // mount points are nested, the file belongs to the longest one
+    std::wstring file_root;
+    for (const auto& partition : partition_to_drive_) {
+        const std::wstring& root = partition.first;
+        if (root.size() <= file_root.size() || file_path.compare(0, root.size(), root) != 0) {
+            continue;
+        }
+        // whole path components only, "/mnt/data" is not the root of "/mnt/database"
+        if (root.back() == L'/' || file_path.size() == root.size() || file_path[root.size()] == L'/') {
+            file_root = root;
+        }
+    }
+    return file_root;
+#endif
+}
+
 void ShredderCache::set_cache_ready(bool cache_ready)
 {
     cache_ready_.store(cache_ready);
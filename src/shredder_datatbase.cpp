@@ -1,4 +1,5 @@
 #include <cassert>
+#include <iomanip>
 #include <string>
 #include <vector>
 
@@ -34,8 +35,79 @@ int ShredderDatabaseWrapper::select_callback(void* raw_data,
     double entropy = std::stod(std::string(column_values[EntropyColumn]));
     int64_t flags = std::stoll(std::string(column_values[FlagsColumn]));
 
+    // entropy map is optional, NULL from LEFT JOIN if not calculated
+    std::shared_ptr<EntropyMap> entropy_map;
+    if (column_count > EntropyMapColumn && column_values[RegionSizeColumn] && column_values[EntropyMapColumn]) {
+        entropy_map = std::make_shared<EntropyMap>();
+        uint64_t region_size = std::stoull(std::string(column_values[RegionSizeColumn]));
+        if (!EntropyMap::from_hex(column_values[EntropyMapColumn], region_size, *entropy_map)) {
+            entropy_map.reset();
+        }
+    }
+
     ShredderDatabaseWrapper::instance().read_db_row(
-        std::move(path), entropy, flags);
+        std::move(path), entropy, flags, std::move(entropy_map));
+    return 0;
+}
+
+// static
+int ShredderDatabaseWrapper::cache_select_callback(void* raw_data,
+                                                   int column_count,
+                                                   char** column_values,
+                                                   char** column_name)
+{
+    assert(std::string(column_name[0]) == "entropy");
+    assert(std::string(column_name[1]) == "compressed");
+    assert(std::string(column_name[2]) == "regionsize");
+    assert(std::string(column_name[3]) == "map");
+    ShredderDatabaseWrapper::instance().tmp_cached_entropy_ =
+        std::stod(std::string(column_values[0]));
+    ShredderDatabaseWrapper::instance().tmp_cached_compressed_ =
+        (std::stoll(std::string(column_values[1])) != 0);
+
+    // entropy map is optional, NULL if not calculated
+    EntropyMap& entropy_map = ShredderDatabaseWrapper::instance().tmp_cached_entropy_map_;
+    entropy_map.clear();
+    if (column_values[2] && column_values[3] &&
+        !EntropyMap::from_hex(column_values[3], std::stoull(std::string(column_values[2])), entropy_map)) {
+        entropy_map.clear();
+    }
+    return 0;
+}
+
+// static
+int ShredderDatabaseWrapper::journal_select_callback(void* raw_data,
+                                                     int column_count,
+                                                     char** column_values,
+                                                     char** column_name)
+{
+    assert(std::string(column_name[0]) == "pass");
+    assert(std::string(column_name[1]) == "offset");
+    assert(std::string(column_name[2]) == "overwritten");
+    assert(std::string(column_name[3]) == "probe");
+    ErasureCheckpoint& checkpoint = ShredderDatabaseWrapper::instance().tmp_checkpoint_;
+    checkpoint.pass = static_cast<unsigned>(std::stoul(std::string(column_values[0])));
+    checkpoint.offset = std::stoull(std::string(column_values[1]));
+    checkpoint.overwritten = (std::stoll(std::string(column_values[2])) != 0);
+    checkpoint.probe = static_cast<uint64_t>(std::stoll(std::string(column_values[3])));
+    ShredderDatabaseWrapper::instance().tmp_checkpoint_found_ = true;
+    return 0;
+}
+
+// static
+int ShredderDatabaseWrapper::job_select_callback(void* raw_data,
+                                                 int column_count,
+                                                 char** column_values,
+                                                 char** column_name)
+{
+    assert(std::string(column_name[0]) == "type");
+    assert(std::string(column_name[1]) == "passes");
+    assert(std::string(column_name[2]) == "seed");
+    ShredderDatabaseWrapper& wrapper = ShredderDatabaseWrapper::instance();
+    wrapper.tmp_job_type_ = static_cast<ErasureScheme::Type>(std::stoi(std::string(column_values[0])));
+    wrapper.tmp_job_passes_ = static_cast<unsigned>(std::stoul(std::string(column_values[1])));
+    wrapper.tmp_job_seed_ = static_cast<uint32_t>(std::stoll(std::string(column_values[2])));
+    wrapper.tmp_job_found_ = true;
     return 0;
 }
 
@@ -70,16 +142,65 @@ void ShredderDatabaseWrapper::open_eraser_db()
         "entropy REAL NOT NULL,"
         "flags INT8 NOT NULL)";
 
+    // entropy of unchanged files, one entry per file (the latest version)
+    const char* create_cache_sql =
+        "CREATE TABLE IF NOT EXISTS entropycache("
+        "device INT8 NOT NULL,"
+        "inode INT8 NOT NULL,"
+        "size INT8 NOT NULL,"
+        "mtime INT8 NOT NULL,"
+        "ctime INT8 NOT NULL,"
+        "entropy REAL NOT NULL,"
+        "compressed INT8 NOT NULL,"
+        "regionsize INT8,"
+        "map TEXT,"
+        "PRIMARY KEY(device, inode))";
+
+    // entropy of file regions, one row per filetable row with the same hash
+    const char* create_map_sql =
+        "CREATE TABLE IF NOT EXISTS entropymap("
+        "hash TEXT PRIMARY KEY,"
+        "regionsize INT8 NOT NULL,"
+        "map TEXT NOT NULL)";
+
+    // progress of the erase job, kept until the job is finished, so that the interrupted one resumes
+    const char* create_journal_sql =
+        "CREATE TABLE IF NOT EXISTS erasejournal("
+        "device INT8 NOT NULL,"
+        "inode INT8 NOT NULL,"
+        "size INT8 NOT NULL,"
+        "pass INT8 NOT NULL,"
+        "offset INT8 NOT NULL,"
+        "overwritten INT8 NOT NULL,"
+        "probe INT8 NOT NULL,"
+        "PRIMARY KEY(device, inode))";
+
+    // patterns of the erase job journaled above, one row, so that the resumed job writes the same passes
+    const char* create_job_sql =
+        "CREATE TABLE IF NOT EXISTS erasejob("
+        "id INTEGER PRIMARY KEY CHECK (id = 0),"
+        "type INT8 NOT NULL,"
+        "passes INT8 NOT NULL,"
+        "seed INT8 NOT NULL)";
+
     std::string database_name = ShredderDatabaseWrapper::database_name();
 
     eraser_db_.open(database_name.c_str());
     eraser_db_.exec(create_table_sql);
+    eraser_db_.exec(create_cache_sql);
+    eraser_db_.exec(create_map_sql);
+    eraser_db_.exec(create_journal_sql);
+    eraser_db_.exec(create_job_sql);
 
     // try twice to avoid sporadic issues like anti-virus
     // 1.
     if (!eraser_db_.is_valid()) {
         eraser_db_.open(database_name.c_str());
         eraser_db_.exec(create_table_sql);
+        eraser_db_.exec(create_cache_sql);
+        eraser_db_.exec(create_map_sql);
+        eraser_db_.exec(create_journal_sql);
+        eraser_db_.exec(create_job_sql);
     }
 
     // 2.
@@ -92,7 +213,9 @@ void ShredderDatabaseWrapper::open_eraser_db()
 bool ShredderDatabaseWrapper::read_table(
     std::vector<ShredderFileInfo>& ret_table)
 {
-    eraser_db_.exec("SELECT filename, entropy, flags FROM filetable",
+    eraser_db_.exec("SELECT filetable.filename, filetable.entropy, filetable.flags, "
+                    "entropymap.regionsize, entropymap.map FROM filetable "
+                    "LEFT JOIN entropymap ON filetable.hash = entropymap.hash",
                     &ShredderDatabaseWrapper::select_callback);
     if (eraser_db_.get_last_error() == 0) {
         LOG_DEBUG << "Returned table of " << tmp_table_.size() << " rows";
@@ -125,6 +248,13 @@ bool ShredderDatabaseWrapper::remove_record(const std::string& hash)
         boost::format("DELETE FROM filetable WHERE hash='%1%'") % hash);
 
     eraser_db_.exec(sql.c_str());
+    if (eraser_db_.get_last_error() != 0) {
+        return false;
+    }
+
+    sql = boost::str(
+        boost::format("DELETE FROM entropymap WHERE hash='%1%'") % hash);
+    eraser_db_.exec(sql.c_str());
     return (eraser_db_.get_last_error() == 0);
 }
 
@@ -139,25 +269,225 @@ bool ShredderDatabaseWrapper::update_record(const std::string& hash,
     return (eraser_db_.get_last_error() == 0);
 }
 
+bool ShredderDatabaseWrapper::update_record(const std::string& hash,
+                                            double entropy,
+                                            bool compressed)
+{
+    // other flags are kept as is
+    std::string sql = boost::str(
+        boost::format("UPDATE filetable SET entropy=%1%, flags=((flags & ~%2%) | %3%) WHERE hash='%4%'")
+        % entropy % ShredderFileProperties::Compressed
+        % (compressed ? ShredderFileProperties::Compressed : 0LL) % hash);
+
+    eraser_db_.exec(sql.c_str());
+    return (eraser_db_.get_last_error() == 0);
+}
+
 bool ShredderDatabaseWrapper::drop_table()
 {
     eraser_db_.exec("DROP TABLE filetable");
+    if (eraser_db_.get_last_error() != 0) {
+        return false;
+    }
+
+    eraser_db_.exec("DELETE FROM entropymap");
+    return (eraser_db_.get_last_error() == 0);
+}
+
+bool ShredderDatabaseWrapper::update_entropy_map(const std::string& hash,
+                                                 const EntropyMap& entropy_map)
+{
+    std::string sql = boost::str(
+        boost::format("INSERT OR REPLACE INTO entropymap(hash, regionsize, map) "
+                      "VALUES ('%1%', %2%, '%3%')")
+        % hash % entropy_map.region_size() % entropy_map.to_hex());
+
+    eraser_db_.exec(sql.c_str());
+    return (eraser_db_.get_last_error() == 0);
+}
+
+bool ShredderDatabaseWrapper::find_cached_entropy(
+    const ShredderFileIdentity& identity, double& entropy, bool& compressed, EntropyMap& entropy_map)
+{
+    if (!identity.valid) {
+        return false;
+    }
+
+    // unsigned device and inode numbers are stored as signed 64-bit integers
+    std::string sql = boost::str(
+        boost::format("SELECT entropy, compressed, regionsize, map FROM entropycache "
+                      "WHERE device=%1% AND inode=%2% AND size=%3% AND mtime=%4% AND ctime=%5%")
+        % static_cast<int64_t>(identity.device) % static_cast<int64_t>(identity.inode)
+        % static_cast<int64_t>(identity.size) % identity.mtime_ns % identity.ctime_ns);
+
+    std::lock_guard<std::mutex> l(cache_lookup_mutex_);
+    tmp_cached_entropy_ = -1.0;
+    eraser_db_.exec(sql.c_str(), &ShredderDatabaseWrapper::cache_select_callback);
+    if (eraser_db_.get_last_error() != 0 || tmp_cached_entropy_ < 0.0) {
+        return false;
+    }
+    entropy = tmp_cached_entropy_;
+    compressed = tmp_cached_compressed_;
+    entropy_map = tmp_cached_entropy_map_;
+    return true;
+}
+
+bool ShredderDatabaseWrapper::update_cached_entropy(
+    const ShredderFileIdentity& identity, double entropy, bool compressed, const EntropyMap& entropy_map)
+{
+    if (!identity.valid) {
+        return false;
+    }
+
+    std::string region_size = entropy_map.empty() ? "NULL" : std::to_string(entropy_map.region_size());
+    std::string map = entropy_map.empty() ? "NULL" : "'" + entropy_map.to_hex() + "'";
+    std::string sql = boost::str(
+        boost::format("INSERT OR REPLACE INTO entropycache(device, inode, size, mtime, ctime, entropy, compressed, regionsize, map) "
+                      "VALUES (%1%, %2%, %3%, %4%, %5%, %6%, %7%, %8%, %9%)")
+        % static_cast<int64_t>(identity.device) % static_cast<int64_t>(identity.inode)
+        % static_cast<int64_t>(identity.size) % identity.mtime_ns % identity.ctime_ns
+        % boost::io::group(std::setprecision(17), entropy) % (compressed ? 1 : 0)
+        % region_size % map);
+
+    eraser_db_.exec(sql.c_str());
+    return (eraser_db_.get_last_error() == 0);
+}
+
+bool ShredderDatabaseWrapper::remove_cached_entropy(const std::vector<ShredderFileIdentity>& identities)
+{
+    std::string sql = "BEGIN;";
+    for (const ShredderFileIdentity& identity : identities) {
+        if (!identity.valid) {
+            continue;
+        }
+        sql += boost::str(
+            boost::format("DELETE FROM entropycache WHERE device=%1% AND inode=%2%;")
+            % static_cast<int64_t>(identity.device) % static_cast<int64_t>(identity.inode));
+    }
+    sql += "COMMIT;";
+
+    eraser_db_.exec(sql.c_str());
+    if (eraser_db_.get_last_error() != 0) {
+        eraser_db_.exec("ROLLBACK");
+        return false;
+    }
+    return true;
+}
+
+bool ShredderDatabaseWrapper::clean_entropy_cache()
+{
+    eraser_db_.exec("DELETE FROM entropycache");
     return (eraser_db_.get_last_error() == 0);
 }
 
 bool ShredderDatabaseWrapper::clean_user_files()
 {
-    // SystemAdded flag is not set
-    std::string sql = "DELETE FROM filetable WHERE flags IN (0, 2)";
+    // SystemAdded flag is not set, other flags do not matter
+    std::string sql = "DELETE FROM filetable WHERE (flags & 1) = 0";
+    eraser_db_.exec(sql.c_str());
+    if (eraser_db_.get_last_error() != 0) {
+        return false;
+    }
+
+    sql = "DELETE FROM entropymap WHERE hash NOT IN (SELECT hash FROM filetable)";
+    eraser_db_.exec(sql.c_str());
+    return (eraser_db_.get_last_error() == 0);
+}
+
+bool ShredderDatabaseWrapper::find_erasure_checkpoint(
+    const ShredderFileIdentity& identity, ErasureCheckpoint& checkpoint)
+{
+    if (!identity.valid) {
+        return false;
+    }
+
+    // the overwrite changes modification times, the size and the node stay the same
+    std::string sql = boost::str(
+        boost::format("SELECT pass, offset, overwritten, probe FROM erasejournal "
+                      "WHERE device=%1% AND inode=%2% AND size=%3%")
+        % static_cast<int64_t>(identity.device) % static_cast<int64_t>(identity.inode)
+        % static_cast<int64_t>(identity.size));
+
+    std::lock_guard<std::mutex> l(journal_lookup_mutex_);
+    tmp_checkpoint_found_ = false;
+    eraser_db_.exec(sql.c_str(), &ShredderDatabaseWrapper::journal_select_callback);
+    if (eraser_db_.get_last_error() != 0 || !tmp_checkpoint_found_) {
+        return false;
+    }
+    checkpoint = tmp_checkpoint_;
+    return true;
+}
+
+bool ShredderDatabaseWrapper::update_erasure_checkpoint(
+    const ShredderFileIdentity& identity, const ErasureCheckpoint& checkpoint)
+{
+    return update_erasure_checkpoints({ { identity, checkpoint } });
+}
+
+bool ShredderDatabaseWrapper::update_erasure_checkpoints(
+    const std::vector<std::pair<ShredderFileIdentity, ErasureCheckpoint>>& checkpoints)
+{
+    // one transaction, so that the database file is synced once
+    std::string sql = "BEGIN;";
+    for (const auto& file_checkpoint : checkpoints) {
+        const ShredderFileIdentity& identity = file_checkpoint.first;
+        const ErasureCheckpoint& checkpoint = file_checkpoint.second;
+        if (!identity.valid) {
+            continue;
+        }
+        sql += boost::str(
+            boost::format("INSERT OR REPLACE INTO erasejournal(device, inode, size, pass, offset, overwritten, probe) "
+                          "VALUES (%1%, %2%, %3%, %4%, %5%, %6%, %7%);")
+            % static_cast<int64_t>(identity.device) % static_cast<int64_t>(identity.inode)
+            % static_cast<int64_t>(identity.size) % checkpoint.pass
+            % static_cast<int64_t>(checkpoint.offset) % (checkpoint.overwritten ? 1 : 0)
+            % static_cast<int64_t>(checkpoint.probe));
+    }
+    sql += "COMMIT;";
+
     eraser_db_.exec(sql.c_str());
+    if (eraser_db_.get_last_error() != 0) {
+        eraser_db_.exec("ROLLBACK");
+        return false;
+    }
+    return true;
+}
+
+bool ShredderDatabaseWrapper::find_erasure_job(ErasureScheme::Type& type, unsigned& passes_count, uint32_t& seed)
+{
+    std::lock_guard<std::mutex> l(journal_lookup_mutex_);
+    tmp_job_found_ = false;
+    eraser_db_.exec("SELECT type, passes, seed FROM erasejob", &ShredderDatabaseWrapper::job_select_callback);
+    if (eraser_db_.get_last_error() != 0 || !tmp_job_found_) {
+        return false;
+    }
+    type = tmp_job_type_;
+    passes_count = tmp_job_passes_;
+    seed = tmp_job_seed_;
+    return true;
+}
+
+bool ShredderDatabaseWrapper::update_erasure_job(const ErasureScheme& scheme)
+{
+    std::string sql = boost::str(
+        boost::format("INSERT OR REPLACE INTO erasejob(id, type, passes, seed) VALUES (0, %1%, %2%, %3%)")
+        % static_cast<int>(scheme.type()) % scheme.passes_count() % static_cast<int64_t>(scheme.seed()));
+    eraser_db_.exec(sql.c_str());
+    return (eraser_db_.get_last_error() == 0);
+}
+
+bool ShredderDatabaseWrapper::clean_erasure_journal()
+{
+    eraser_db_.exec("DELETE FROM erasejournal; DELETE FROM erasejob");
     return (eraser_db_.get_last_error() == 0);
 }
 
 void ShredderDatabaseWrapper::read_db_row(std::wstring&& path,
                                           double entropy,
-                                          int64_t flags)
+                                          int64_t flags,
+                                          std::shared_ptr<const EntropyMap> entropy_map)
 {
-    tmp_table_.emplace_back(ShredderFileInfo(path, entropy, flags));
+    tmp_table_.emplace_back(ShredderFileInfo(path, entropy, flags, std::move(entropy_map)));
 }
 
 bool ShredderDatabaseWrapper::check_sqlite_error() const
@@ -0,0 +1,84 @@
+#include <eraser/shredder_file_identity.h>
+#include <winapi-helpers/utilities.h>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <Windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+using namespace shredder;
+
+#if defined(_WIN32) || defined(_WIN64)
+
+// static
+ShredderFileIdentity ShredderFileIdentity::read(const std::wstring& file_path)
+{
+    ShredderFileIdentity identity;
+    HANDLE file_handle = CreateFileW(file_path.c_str(), FILE_READ_ATTRIBUTES,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        NULL,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL,
+        NULL);
+    if (INVALID_HANDLE_VALUE == file_handle) {
+        return identity;
+    }
+
+    // ChangeTime is only available from FILE_BASIC_INFO
+    BY_HANDLE_FILE_INFORMATION file_information{};
+    FILE_BASIC_INFO basic_information{};
+    if (GetFileInformationByHandle(file_handle, &file_information) &&
+        GetFileInformationByHandleEx(file_handle, FileBasicInfo, &basic_information, sizeof(basic_information))) {
+        ULARGE_INTEGER file_size{};
+        file_size.LowPart = file_information.nFileSizeLow;
+        file_size.HighPart = file_information.nFileSizeHigh;
+
+        // FILETIME is in 100-nanosecond intervals
+        identity.device = file_information.dwVolumeSerialNumber;
+        identity.inode = (static_cast<uint64_t>(file_information.nFileIndexHigh) << 32) | file_information.nFileIndexLow;
+        identity.size = file_size.QuadPart;
+        identity.mtime_ns = basic_information.LastWriteTime.QuadPart * 100;
+        identity.ctime_ns = basic_information.ChangeTime.QuadPart * 100;
+        identity.valid = true;
+    }
+    ::CloseHandle(file_handle);
+    return identity;
+}
+
+#else
+
+// static
+ShredderFileIdentity ShredderFileIdentity::read(const std::wstring& file_path)
+{
+    ShredderFileIdentity identity;
+    struct stat file_stat{};
+    if (::stat(helpers::wstring_to_string(file_path).c_str(), &file_stat) != 0 || !S_ISREG(file_stat.st_mode)) {
+        return identity;
+    }
+
+    identity.device = static_cast<uint64_t>(file_stat.st_dev);
+    identity.inode = static_cast<uint64_t>(file_stat.st_ino);
+    identity.size = static_cast<uint64_t>(file_stat.st_size);
+#if defined(__APPLE__)
+    identity.mtime_ns = static_cast<int64_t>(file_stat.st_mtimespec.tv_sec) * 1000000000 + file_stat.st_mtimespec.tv_nsec;
+    identity.ctime_ns = static_cast<int64_t>(file_stat.st_ctimespec.tv_sec) * 1000000000 + file_stat.st_ctimespec.tv_nsec;
+#else
+    identity.mtime_ns = static_cast<int64_t>(file_stat.st_mtim.tv_sec) * 1000000000 + file_stat.st_mtim.tv_nsec;
+    identity.ctime_ns = static_cast<int64_t>(file_stat.st_ctim.tv_sec) * 1000000000 + file_stat.st_ctim.tv_nsec;
+#endif
+    identity.valid = true;
+    return identity;
+}
+
+#endif // defined(_WIN32) || defined(_WIN64)
+
+bool ShredderFileIdentity::operator==(const ShredderFileIdentity& other) const
+{
+    return valid && other.valid &&
+        device == other.device &&
+        inode == other.inode &&
+        size == other.size &&
+        mtime_ns == other.mtime_ns &&
+        ctime_ns == other.ctime_ns;
+}
@@ -22,6 +22,16 @@ void ShredderFileProperties::set_is_file(bool is_file)
     }
 }
 
+void ShredderFileProperties::set_compressed(bool compressed)
+{
+    if (compressed) {
+        flags_ |= Compressed;
+    }
+    else {
+        flags_ &= ~Compressed;
+    }
+}
+
 bool ShredderFileProperties::is_file() const
 {
     return (flags_ & IsFile);
@@ -31,3 +41,8 @@ bool ShredderFileProperties::is_system_added() const
 {
     return (flags_ & SystemAdded);
 }
+
+bool ShredderFileProperties::is_compressed() const
+{
+    return (flags_ & Compressed);
+}
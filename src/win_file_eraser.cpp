@@ -11,8 +11,9 @@ using namespace shredder;
 
 std::default_random_engine NativeFileEraser::generator_;
 
-NativeFileEraser::NativeFileEraser(const std::wstring& filename, EntropyEstimation estimation, DiskType disk_type)
-    : information_estimation_(estimation), disk_type_(disk_type)
+NativeFileEraser::NativeFileEraser(const std::wstring& filename, EntropyEstimation estimation, DiskType disk_type,
+                                   DurabilityPolicy durability)
+    : information_estimation_(estimation), disk_type_(disk_type), durability_(durability)
 {
     open(filename);
 }
@@ -48,36 +49,75 @@ bool NativeFileEraser::open(const std::wstring& filename)
 void NativeFileEraser::close()
 {
     if (INVALID_HANDLE_VALUE != file_handle_) {
+        // data is on the drive before the file node is erased, written through or synced by the caller otherwise
+        if (DurabilityPolicy::PerFile == durability_) {
+            ::FlushFileBuffers(file_handle_);
+        }
         ::CloseHandle(file_handle_);
     }
     file_handle_ = INVALID_HANDLE_VALUE;
 }
 
-bool NativeFileEraser::erase_full(uint8_t* start_mask, size_t mask_length/* = 65536*/)
+bool NativeFileEraser::flush()
 {
-    // check mask length complaint to block size
-    if (file_handle_ == INVALID_HANDLE_VALUE || (0 == file_size_)) {
+    if (INVALID_HANDLE_VALUE == file_handle_) {
         return false;
     }
+    if (DurabilityPolicy::PerWrite == durability_) {
+        return true;
+    }
+    return TRUE == ::FlushFileBuffers(file_handle_);
+}
+
+void NativeFileEraser::set_resume_offset(uint64_t offset)
+{
+    resume_offset_ = offset;
+}
 
-    if (big_file_) {
+void NativeFileEraser::set_checkpoint(uint64_t interval, std::function<void(uint64_t)> checkpoint)
+{
+    checkpoint_interval_ = interval;
+    checkpoint_ = std::move(checkpoint);
+}
+
+bool NativeFileEraser::erase_full(uint8_t* start_mask, size_t mask_length/* = 65536*/)
+{
+    // check mask length complaint to block size
+    if (file_handle_ == INVALID_HANDLE_VALUE || (0 == file_size_) || (0 == mask_length)) {
         return false;
     }
 
     if (!prepared_to_erase_) {
-        prepare();
+        prepare({ { 0, static_cast<uint64_t>(file_size_) } });
     }
 
-    // back to the file beginning
-    last_pointer_ = SetFilePointer(file_handle_, 0, NULL, FILE_BEGIN);
+    // 64-bit offsets, files over 4 Gb are streamed as well, from the resume offset if set
+    const uint64_t file_size = static_cast<uint64_t>(file_size_);
+    uint64_t bytes_erased = std::min(resume_offset_, file_size);
+    resume_offset_ = 0;
+    LARGE_INTEGER position{};
+    position.QuadPart = static_cast<LONGLONG>(bytes_erased);
+    if (!SetFilePointerEx(file_handle_, position, NULL, FILE_BEGIN)) {
+        return false;
+    }
 
+    const uint64_t interval = (checkpoint_ && checkpoint_interval_ > 0) ? checkpoint_interval_ : file_size;
+    uint64_t next_checkpoint = bytes_erased + interval;
     DWORD bytes_written{};
-    for (size_t bytes_erased = 0; bytes_erased < file_size_; bytes_erased += bytes_written) {
-        size_t erase_chunk = std::min<size_t>((file_size_ - bytes_erased), mask_length);
-        if (!WriteFile(file_handle_, start_mask, erase_chunk, &bytes_written, NULL)) {
+    while (bytes_erased < file_size) {
+        DWORD erase_chunk = static_cast<DWORD>(std::min<uint64_t>(file_size - bytes_erased, mask_length));
+        if (!WriteFile(file_handle_, start_mask, erase_chunk, &bytes_written, NULL) || 0 == bytes_written) {
             return false;
         }
         bytes_erased += bytes_written;
+
+        // written data is on the drive before the progress is recorded
+        if (checkpoint_ && bytes_erased >= next_checkpoint && bytes_erased < file_size) {
+            if (flush()) {
+                checkpoint_(bytes_erased);
+            }
+            next_checkpoint = bytes_erased + interval;
+        }
     }
 
     return true;
@@ -89,33 +129,42 @@ bool NativeFileEraser::erase_random(uint8_t* start_mask, size_t mask_length)
         return erase_full(start_mask, mask_length);
     }
 
-    if (!prepared_to_erase_) {
-        prepare();
-    }
+    // every pass of the multi-pass erasure overwrites the same areas
+    if (random_ranges_.empty()) {
+        size_t begin_offset = 0;
+        size_t end_offset = file_size_ - mask_length;
+        size_t erased_areas = file_size_ / (mask_length * 5);
 
-    size_t begin_offset = 0;
-    size_t end_offset = file_size_ - mask_length;
-    size_t erased_areas = file_size_ / (mask_length * 5);
+        // add erase at begin, end and generate erase points in the middle (linearly distributed)
+        random_ranges_.push_back({ begin_offset, mask_length });
+        std::uniform_int_distribution<size_t> distribution(mask_length, end_offset - mask_length);
+        for (size_t i = 0; i < erased_areas; ++i) {
+            random_ranges_.push_back({ distribution(generator_), mask_length });
+        }
+        random_ranges_.push_back({ end_offset, mask_length });
 
-    // add erase at begin, end and generate erase points in the middle (linearly distributed)
-    std::vector<size_t> erase_points({ begin_offset });
-    std::uniform_int_distribution<size_t> distribution(mask_length, end_offset - mask_length);
-    for (int i = 0; i < erased_areas; ++i) {
-        erase_points.push_back(distribution(generator_));
+        // one seek per distinct extent, overlapping and adjacent areas are written sequentially
+        coalesce_ranges(random_ranges_);
     }
-    erase_points.push_back(end_offset);
 
-    if (!std::is_sorted(erase_points.begin(), erase_points.end())) {
-        std::sort(erase_points.begin(), erase_points.end());
+    if (!prepared_to_erase_) {
+        prepare(random_ranges_);
     }
-    
+
     DWORD bytes_written{};
-    for (size_t erase_point : erase_points) {
-        assert(erase_point <= file_size_ - mask_length);
-        last_pointer_ = SetFilePointer(file_handle_, erase_point, NULL, FILE_BEGIN);
-        if (!WriteFile(file_handle_, start_mask, mask_length, &bytes_written, NULL)) {
+    for (const EraseRange& erase_range : random_ranges_) {
+        assert(erase_range.end() <= static_cast<uint64_t>(file_size_));
+        LARGE_INTEGER erase_offset{};
+        erase_offset.QuadPart = static_cast<LONGLONG>(erase_range.offset);
+        if (!SetFilePointerEx(file_handle_, erase_offset, NULL, FILE_BEGIN)) {
             return false;
         }
+        for (uint64_t bytes_erased = 0; bytes_erased < erase_range.length; bytes_erased += bytes_written) {
+            DWORD erase_chunk = static_cast<DWORD>(std::min<uint64_t>(erase_range.length - bytes_erased, mask_length));
+            if (!WriteFile(file_handle_, start_mask, erase_chunk, &bytes_written, NULL) || 0 == bytes_written) {
+                return false;
+            }
+        }
     }
     return true;
 }
@@ -127,7 +176,10 @@ bool NativeFileEraser::erase_begin_end(uint8_t* start_mask, size_t mask_length)
     }
 
     if (!prepared_to_erase_) {
-        prepare();
+        const uint64_t file_size = static_cast<uint64_t>(file_size_);
+        std::vector<EraseRange> overwritten{ { 0, mask_length }, { file_size - mask_length, mask_length } };
+        coalesce_ranges(overwritten);
+        prepare(overwritten);
     }
 
     DWORD bytes_written{};
@@ -146,19 +198,55 @@ bool NativeFileEraser::erase_begin_end(uint8_t* start_mask, size_t mask_length)
     return true;
 }
 
+bool NativeFileEraser::erase_discard(uint8_t* start_mask, size_t mask_length)
+{
+    if (file_handle_ == INVALID_HANDLE_VALUE || (0 == file_size_)) {
+        return false;
+    }
+
+    // the middle is either deallocated or overwritten, anchors are useless there
+    if (!prepared_to_erase_) {
+        prepare({ { 0, static_cast<uint64_t>(file_size_) } });
+    }
+
+    if (!erase_begin_end(start_mask, mask_length)) {
+        return false;
+    }
+    if (megabyte_ > file_size_) {
+        // erased fully
+        return true;
+    }
+
+    // zeroed range of the sparse file is deallocated, NTFS trims released clusters itself
+    DWORD bytes_returned{};
+    FILE_ZERO_DATA_INFORMATION zero_data{};
+    zero_data.FileOffset.QuadPart = static_cast<LONGLONG>(mask_length);
+    zero_data.BeyondFinalZero.QuadPart = file_size_ - static_cast<LONGLONG>(mask_length);
+    if (::DeviceIoControl(file_handle_, FSCTL_SET_SPARSE, NULL, 0, NULL, 0, &bytes_returned, NULL) &&
+        ::DeviceIoControl(file_handle_, FSCTL_SET_ZERO_DATA, &zero_data, sizeof(zero_data), NULL, 0, &bytes_returned, NULL)) {
+        return true;
+    }
+
+    // filesystem does not support sparse files, overwrite the middle
+    return erase_full(start_mask, mask_length);
+}
+
 bool NativeFileEraser::erase_smart(uint8_t* start_mask, size_t mask_length)
 {
-    if (big_file_) {
-        return erase_begin_end(start_mask, mask_length);
+    // map built for the same file size, otherwise file has been changed since the scan
+    if (entropy_map_ && !entropy_map_->empty() &&
+        entropy_map_->regions_count() == (file_size_ + entropy_map_->region_size() - 1) / entropy_map_->region_size()) {
+        return erase_regions(start_mask, mask_length);
     }
-    else if (false == big_file_ && information_estimation_ == ShannonEncryptionChecker::Encrypted) {
+
+    if (information_estimation_ == ShannonEncryptionChecker::Encrypted) {
         return erase_begin_end(start_mask, mask_length);
     }
-    else if (false == big_file_ && information_estimation_ == ShannonEncryptionChecker::Binary) {
+    else if (information_estimation_ == ShannonEncryptionChecker::Binary) {
         // TODO: erase_begin_end?
         return erase_full(start_mask, mask_length);
     }
-    else if (false == big_file_ && information_estimation_ == ShannonEncryptionChecker::Plain) {
+    else if (information_estimation_ == ShannonEncryptionChecker::Plain) {
         return erase_full(start_mask, mask_length);
     }
     else if (information_estimation_ == ShannonEncryptionChecker::Unknown) {
@@ -170,38 +258,94 @@ bool NativeFileEraser::erase_smart(uint8_t* start_mask, size_t mask_length)
     return false;
 }
 
-bool NativeFileEraser::is_file_compressed(DWORD file_attributes) const
+void NativeFileEraser::set_entropy_map(std::shared_ptr<const EntropyMap> entropy_map)
 {
-    return (file_attributes_ & FILE_ATTRIBUTE_COMPRESSED ||
-        file_attributes_ & FILE_ATTRIBUTE_ENCRYPTED ||
-        file_attributes_ & FILE_ATTRIBUTE_SPARSE_FILE);
+    entropy_map_ = std::move(entropy_map);
 }
 
-bool NativeFileEraser::prepare()
+bool NativeFileEraser::erase_regions(uint8_t* start_mask, size_t mask_length)
 {
-    constexpr BYTE anchor = 0xEF;
-    LONG high_word_length{};
+    if (file_handle_ == INVALID_HANDLE_VALUE || (0 == file_size_)) {
+        return false;
+    }
+
+    const uint64_t region_size = entropy_map_->region_size();
+    std::vector<EraseRange> erase_ranges;
+    for (size_t region = 0; region < entropy_map_->regions_count(); ++region) {
+        const uint64_t region_begin = region * region_size;
+        const uint64_t region_length = std::min<uint64_t>(region_size, file_size_ - region_begin);
+
+        // high-entropy region is useless without its beginning, plain and binary ones are erased fully
+        uint64_t erase_length = region_length;
+        if (ShannonEncryptionChecker::Encrypted ==
+            ShannonEncryptionChecker::information_entropy_estimation(entropy_map_->entropy(region), region_length)) {
+            erase_length = std::min<uint64_t>(region_length, mask_length);
+        }
+        erase_ranges.push_back({ region_begin, erase_length });
+    }
+
+    if (!prepared_to_erase_) {
+        const uint64_t file_size = static_cast<uint64_t>(file_size_);
+        std::vector<EraseRange> overwritten = erase_ranges;
+        if (megabyte_ <= file_size) {
+            overwritten.push_back({ 0, mask_length });
+            overwritten.push_back({ file_size - mask_length, mask_length });
+        }
+        coalesce_ranges(overwritten);
+        prepare(overwritten);
+    }
+
     DWORD bytes_written{};
+    for (const EraseRange& erase_range : erase_ranges) {
+        LARGE_INTEGER position{};
+        position.QuadPart = static_cast<LONGLONG>(erase_range.offset);
+        if (!SetFilePointerEx(file_handle_, position, NULL, FILE_BEGIN)) {
+            return false;
+        }
+        for (uint64_t bytes_erased = 0; bytes_erased < erase_range.length; bytes_erased += bytes_written) {
+            DWORD erase_chunk = static_cast<DWORD>(std::min<uint64_t>(erase_range.length - bytes_erased, mask_length));
+            if (!WriteFile(file_handle_, start_mask, erase_chunk, &bytes_written, NULL) || 0 == bytes_written) {
+                return false;
+            }
+        }
+    }
 
-    // set to last byte
-    last_pointer_ = SetFilePointer(file_handle_, -1, NULL, FILE_END);
-    
-    if (last_pointer_ == INVALID_SET_FILE_POINTER) {
-        return false;
+    if (megabyte_ > file_size_) {
+        return true;
     }
+    return erase_begin_end(start_mask, mask_length);
+}
+
+bool NativeFileEraser::is_file_compressed(DWORD file_attributes) const
+{
+    return (file_attributes_ & FILE_ATTRIBUTE_COMPRESSED ||
+        file_attributes_ & FILE_ATTRIBUTE_ENCRYPTED ||
+        file_attributes_ & FILE_ATTRIBUTE_SPARSE_FILE);
+}
 
-    if (!WriteFile(file_handle_, &anchor, sizeof(BYTE), &bytes_written, NULL)) {
+bool NativeFileEraser::prepare(const std::vector<EraseRange>& overwritten)
+{
+    if (0 == file_size_) {
         return false;
     }
 
+    // the last byte and, on SSD, every anchor_step_ bytes. The overwrite writes covered anchors anyway
+    const uint64_t file_size = static_cast<uint64_t>(file_size_);
+    std::vector<uint64_t> anchor_points;
     if (disk_type_ == helpers::PartititonInformation::SSD) {
-        for (size_t ahchor_point = 0xFFFF; ahchor_point <= file_size_; ahchor_point += 0xFFFF) {
-            last_pointer_ = SetFilePointer(file_handle_, ahchor_point, &high_word_length, FILE_BEGIN);
-            if (!WriteFile(file_handle_, &anchor, sizeof(BYTE), &bytes_written, NULL)) {
-                return false;
+        for (uint64_t anchor_point = anchor_step_; anchor_point < file_size - 1; anchor_point += anchor_step_) {
+            if (!contains_offset(overwritten, anchor_point)) {
+                anchor_points.push_back(anchor_point);
             }
         }
     }
+    if (!contains_offset(overwritten, file_size - 1)) {
+        anchor_points.push_back(file_size - 1);
+    }
+
+    if (!write_anchors(anchor_points)) {
+        return false;
+    }
 
     // we can start safe erase
     prepared_to_erase_ = true;
@@ -209,6 +353,64 @@ bool NativeFileEraser::prepare()
     return true;
 }
 
+bool NativeFileEraser::write_anchors(const std::vector<uint64_t>& anchor_points)
+{
+    static constexpr BYTE anchor = 0xEF;
+    if (anchor_points.empty()) {
+        return true;
+    }
+
+    // the main handle is synchronous, the overlapped one queues the whole batch at once
+    // and its writes go through the same cache
+    HANDLE anchor_handle = CreateFileW(initial_filepath_.c_str(), GENERIC_WRITE,
+        FILE_SHARE_READ | FILE_SHARE_WRITE,
+        NULL,
+        OPEN_EXISTING,
+        FILE_FLAG_OVERLAPPED | ((DurabilityPolicy::PerWrite == durability_) ? FILE_FLAG_WRITE_THROUGH : 0),
+        NULL);
+    if (INVALID_HANDLE_VALUE == anchor_handle) {
+        return false;
+    }
+
+    // every write has its own event, the handle is signaled by any of them
+    std::vector<OVERLAPPED> batch(std::min(anchor_batch_size_, anchor_points.size()));
+    for (OVERLAPPED& overlapped : batch) {
+        overlapped.hEvent = ::CreateEventW(NULL, TRUE, FALSE, NULL);
+    }
+
+    bool success = std::all_of(batch.begin(), batch.end(), [](const OVERLAPPED& overlapped) { return NULL != overlapped.hEvent; });
+    for (size_t first_point = 0; success && first_point < anchor_points.size(); first_point += batch.size()) {
+        size_t writes_queued = 0;
+        for (; writes_queued < batch.size() && first_point + writes_queued < anchor_points.size(); ++writes_queued) {
+            OVERLAPPED& overlapped = batch[writes_queued];
+            const uint64_t anchor_point = anchor_points[first_point + writes_queued];
+            overlapped.Offset = static_cast<DWORD>(anchor_point);
+            overlapped.OffsetHigh = static_cast<DWORD>(anchor_point >> 32);
+            ::ResetEvent(overlapped.hEvent);
+            if (!::WriteFile(anchor_handle, &anchor, sizeof(BYTE), NULL, &overlapped) && ERROR_IO_PENDING != ::GetLastError()) {
+                success = false;
+                break;
+            }
+        }
+
+        // queued writes should complete before their OVERLAPPED are reused or freed
+        for (size_t i = 0; i < writes_queued; ++i) {
+            DWORD bytes_written{};
+            if (!::GetOverlappedResult(anchor_handle, &batch[i], &bytes_written, TRUE) || sizeof(BYTE) != bytes_written) {
+                success = false;
+            }
+        }
+    }
+
+    for (OVERLAPPED& overlapped : batch) {
+        if (NULL != overlapped.hEvent) {
+            ::CloseHandle(overlapped.hEvent);
+        }
+    }
+    ::CloseHandle(anchor_handle);
+    return success;
+}
+
 bool NativeFileEraser::try_open(const std::wstring& filename)
 {
     // First, open the file in overwrite mode
@@ -216,7 +418,7 @@ bool NativeFileEraser::try_open(const std::wstring& filename)
         FILE_SHARE_READ | FILE_SHARE_WRITE,
         NULL,
         OPEN_EXISTING, 
-        FILE_FLAG_WRITE_THROUGH,
+        (DurabilityPolicy::PerWrite == durability_) ? FILE_FLAG_WRITE_THROUGH : FILE_ATTRIBUTE_NORMAL,
         NULL);
 
     if (file_handle_ == INVALID_HANDLE_VALUE) {
@@ -227,9 +429,6 @@ bool NativeFileEraser::try_open(const std::wstring& filename)
 
     LARGE_INTEGER file_size{};
     GetFileSizeEx(file_handle_, &file_size);
-    if (file_size.HighPart) {
-        big_file_ = true;
-    }
     file_size_ = file_size.QuadPart;
 
     return true;
@@ -369,4 +568,51 @@ bool NativeFileEraser::clean_ntfs_journal(const std::wstring& drive_root)
     return clean_ntfs_journal(get_volume_handle(drive_root[0]));
 }
 
+// static
+bool NativeFileEraser::trim_filesystem(const std::wstring& drive_root)
+{
+    // NTFS trims clusters as soon as they are released
+    return false;
+}
+
+// static
+bool NativeFileEraser::sync_filesystem(const std::wstring& drive_root)
+{
+    assert(!drive_root.empty());
+    wchar_t volume_filename[] = L"\\\\.\\X:";
+    volume_filename[4] = ::toupper(drive_root[0]);
+
+    HANDLE volume_handle = CreateFileW(volume_filename,
+        GENERIC_READ | GENERIC_WRITE,
+        FILE_SHARE_READ | FILE_SHARE_WRITE,
+        NULL,
+        OPEN_EXISTING,
+        0, NULL);
+    if (INVALID_HANDLE_VALUE == volume_handle) {
+        return false;
+    }
+
+    BOOL success = ::FlushFileBuffers(volume_handle);
+    ::CloseHandle(volume_handle);
+    return (TRUE == success);
+}
+
+// static
+bool NativeFileEraser::flush_file(const std::wstring& filename)
+{
+    HANDLE file_handle = CreateFileW(filename.c_str(),
+        GENERIC_WRITE,
+        FILE_SHARE_READ | FILE_SHARE_WRITE,
+        NULL,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, NULL);
+    if (INVALID_HANDLE_VALUE == file_handle) {
+        return false;
+    }
+
+    BOOL success = ::FlushFileBuffers(file_handle);
+    ::CloseHandle(file_handle);
+    return (TRUE == success);
+}
+
 #endif // defined(_WIN32) || defined(_WIN64)
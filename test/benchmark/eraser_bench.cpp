@@ -0,0 +1,351 @@
+#include <eraser/encryption_checker.h>
+#include <eraser/histogram_kernels.h>
+#include <eraser/drive_eraser.h>
+#include <eraser/random_generator.h>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <eraser/win_file_eraser.h>
+#elif defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
+#include <eraser/posix_file_eraser.h>
+#include <eraser/io_uring_eraser.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+using namespace shredder;
+namespace fs = boost::filesystem;
+
+// Throughput benchmark of entropy calculation and file erasure on synthetic corpora
+// Usage: eraser_bench [--size-mb N] [--repeat N] [--dir PATH] [--output FILE.json] [--direct-io 0|1] [--queue-depth N]
+// Results are printed as JSON, so that they could be compared between releases
+
+namespace {
+
+/// Block counted by one kernel call, 32-bit tables of the kernel do not overflow
+constexpr size_t KERNEL_BLOCK_SIZE = 1024 * 1024;
+
+struct BenchOptions
+{
+    /// Size of every corpus file
+    uintmax_t corpus_size = 1024 * 1024 * 64;
+
+    /// Every measurement is repeated, the best time is reported
+    unsigned repeat = 3;
+
+    /// Directory for corpus files, should be on a local drive
+    fs::path directory = fs::temp_directory_path() / "eraser_bench";
+
+    /// JSON output file, standard output if empty
+    fs::path output;
+
+    /// Erase by direct I/O (POSIX only), measures the drive rather than the page cache
+    bool direct_io = false;
+
+    /// Writes in flight of the io_uring erasure (Linux only), 0 for blocking writes
+    unsigned queue_depth = 0;
+};
+
+struct BenchResult
+{
+    std::string corpus;
+    std::string operation;
+    uintmax_t bytes;
+    double seconds;
+};
+
+/// Corpus generator fills the buffer of the given size
+using CorpusGenerator = std::function<void(std::vector<uint8_t>&, std::mt19937_64&)>;
+
+void generate_zeros(std::vector<uint8_t>& content, std::mt19937_64&)
+{
+    std::fill(content.begin(), content.end(), 0);
+}
+
+void generate_text(std::vector<uint8_t>& content, std::mt19937_64& generator)
+{
+    static const char* words[] = { "the", "eraser", "of", "file", "entropy", "and", "drive",
+                                   "to", "data", "is", "in", "secure", "region", "a", "block" };
+    std::uniform_int_distribution<size_t> word(0, std::size(words) - 1);
+    size_t position = 0;
+    while (position < content.size()) {
+        const char* next_word = words[word(generator)];
+        for (size_t i = 0; next_word[i] && position < content.size(); ++i) {
+            content[position++] = static_cast<uint8_t>(next_word[i]);
+        }
+        if (position < content.size()) {
+            content[position++] = (word(generator) == 0) ? '\n' : ' ';
+        }
+    }
+}
+
+void generate_random(std::vector<uint8_t>& content, std::mt19937_64& generator)
+{
+    for (size_t i = 0; i + sizeof(uint64_t) <= content.size(); i += sizeof(uint64_t)) {
+        uint64_t value = generator();
+        std::memcpy(content.data() + i, &value, sizeof(value));
+    }
+    for (size_t i = content.size() / sizeof(uint64_t) * sizeof(uint64_t); i < content.size(); ++i) {
+        content[i] = static_cast<uint8_t>(generator());
+    }
+}
+
+// gzip header followed by LZ-like stream: random literal runs and short back-references,
+// entropy is high but not exactly random
+void generate_compressed(std::vector<uint8_t>& content, std::mt19937_64& generator)
+{
+    static const uint8_t gzip_header[] = { 0x1F, 0x8B, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03 };
+    std::uniform_int_distribution<size_t> run(4, 64);
+    std::uniform_int_distribution<size_t> distance(1, 4096);
+    size_t position = std::min(sizeof(gzip_header), content.size());
+    std::copy(gzip_header, gzip_header + position, content.begin());
+    while (position < content.size()) {
+        size_t literals = std::min(run(generator), content.size() - position);
+        for (size_t i = 0; i < literals; ++i) {
+            content[position++] = static_cast<uint8_t>(generator());
+        }
+        size_t reference = std::min<size_t>(distance(generator), position);
+        size_t length = std::min(run(generator) / 8, content.size() - position);
+        for (size_t i = 0; i < length; ++i, ++position) {
+            content[position] = content[position - reference];
+        }
+    }
+}
+
+// 1 Mb regions of text and random data
+void generate_mixed(std::vector<uint8_t>& content, std::mt19937_64& generator)
+{
+    constexpr size_t region_size = 1024 * 1024;
+    std::vector<uint8_t> region;
+    for (size_t offset = 0; offset < content.size(); offset += region_size) {
+        region.resize(std::min(region_size, content.size() - offset));
+        if ((offset / region_size) % 2) {
+            generate_random(region, generator);
+        }
+        else {
+            generate_text(region, generator);
+        }
+        std::copy(region.begin(), region.end(), content.begin() + offset);
+    }
+}
+
+bool write_file(const fs::path& path, const std::vector<uint8_t>& content)
+{
+    fs::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(content.data()), content.size());
+    return file.good();
+}
+
+/// Best of several runs, the function returns false if the run failed
+double best_seconds(unsigned repeat, const std::function<void()>& prepare, const std::function<bool()>& run)
+{
+    double best = -1.0;
+    for (unsigned i = 0; i < repeat; ++i) {
+        prepare();
+        auto start = std::chrono::steady_clock::now();
+        bool success = run();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        if (success && (best < 0.0 || elapsed.count() < best)) {
+            best = elapsed.count();
+        }
+    }
+    return best;
+}
+
+std::string json_escape(const std::string& s)
+{
+    std::string escaped;
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            escaped.push_back('\\');
+        }
+        escaped.push_back(c);
+    }
+    return escaped;
+}
+
+void write_json(std::ostream& os, const BenchOptions& options, const std::vector<BenchResult>& results)
+{
+    os << "{\n  \"corpus_size\": " << options.corpus_size
+       << ",\n  \"repeat\": " << options.repeat
+       << ",\n  \"direct_io\": " << (options.direct_io ? "true" : "false")
+       << ",\n  \"queue_depth\": " << options.queue_depth
+       << ",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& r = results[i];
+        double gbps = (r.seconds > 0.0) ? (r.bytes / r.seconds / 1e9) : 0.0;
+        os << "    {\"corpus\": \"" << json_escape(r.corpus)
+           << "\", \"operation\": \"" << json_escape(r.operation)
+           << "\", \"bytes\": " << r.bytes
+           << ", \"seconds\": " << std::setprecision(6) << r.seconds
+           << ", \"gbps\": " << std::setprecision(4) << gbps
+           << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    os << "  ]\n}\n";
+}
+
+bool parse_options(int argc, char* argv[], BenchOptions& options)
+{
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            return false;
+        }
+        std::string value = argv[++i];
+        if (arg == "--size-mb") {
+            options.corpus_size = std::stoull(value) * 1024 * 1024;
+        }
+        else if (arg == "--repeat") {
+            options.repeat = std::max(1u, static_cast<unsigned>(std::stoul(value)));
+        }
+        else if (arg == "--dir") {
+            options.directory = value;
+        }
+        else if (arg == "--output") {
+            options.output = value;
+        }
+        else if (arg == "--direct-io") {
+            options.direct_io = (value != "0");
+        }
+        else if (arg == "--queue-depth") {
+            options.queue_depth = static_cast<unsigned>(std::stoul(value));
+        }
+        else {
+            return false;
+        }
+    }
+    return options.corpus_size > 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    BenchOptions options;
+    if (!parse_options(argc, argv, options)) {
+        std::cerr << "Usage: eraser_bench [--size-mb N] [--repeat N] [--dir PATH] [--output FILE.json] [--direct-io 0|1] [--queue-depth N]\n";
+        return 1;
+    }
+
+    boost::system::error_code ec;
+    fs::create_directories(options.directory, ec);
+    if (ec) {
+        std::cerr << "Unable to create " << options.directory << ": " << ec.message() << "\n";
+        return 1;
+    }
+
+    const std::vector<std::pair<std::string, CorpusGenerator>> corpora = {
+        { "zeros", generate_zeros },
+        { "text", generate_text },
+        { "random", generate_random },
+        { "compressed", generate_compressed },
+        { "mixed", generate_mixed }
+    };
+
+    using EraseFunction = bool (NativeFileEraser::*)(uint8_t*, size_t);
+    const std::vector<std::tuple<DriveEraser::ErasureMethod, std::string, EraseFunction>> erasure_methods = {
+        { DriveEraser::ErasureMethod::Smart, "erase_smart", &NativeFileEraser::erase_smart },
+        { DriveEraser::ErasureMethod::Full, "erase_full", &NativeFileEraser::erase_full },
+        { DriveEraser::ErasureMethod::Random, "erase_random", &NativeFileEraser::erase_random },
+        { DriveEraser::ErasureMethod::BeginEnd, "erase_begin_end", &NativeFileEraser::erase_begin_end },
+        { DriveEraser::ErasureMethod::Discard, "erase_discard", &NativeFileEraser::erase_discard }
+    };
+
+#if defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
+    IoUringEraser io_uring_eraser;
+    if (options.queue_depth > 0 && !io_uring_eraser.init(options.queue_depth)) {
+        std::cerr << "io_uring is not available, blocking writes are measured\n";
+        options.queue_depth = 0;
+    }
+#endif
+
+    std::vector<BenchResult> results;
+    std::mt19937_64 generator(2024);
+    std::vector<uint8_t> content(static_cast<size_t>(options.corpus_size));
+    RandomGenerator random_mask;
+
+    for (const auto& corpus : corpora) {
+        corpus.second(content, generator);
+        const fs::path corpus_path = options.directory / (corpus.first + ".bin");
+        if (!write_file(corpus_path, content)) {
+            std::cerr << "Unable to write " << corpus_path << "\n";
+            return 1;
+        }
+
+        ShannonEncryptionChecker checker;
+        double entropy = -1.0;
+        double seconds = best_seconds(options.repeat, [] {}, [&] {
+            entropy = checker.get_sequence_entropy(content.data(), content.size());
+            return entropy >= 0.0;
+        });
+        results.push_back({ corpus.first, "get_sequence_entropy", options.corpus_size, seconds });
+
+        // every kernel alone, get_sequence_entropy() takes the scalar or the run-skipping one for every page
+        for (const HistogramKernelInfo& kernel : supported_histogram_kernels()) {
+            seconds = best_seconds(options.repeat, [] {}, [&] {
+                HistogramTables tables;
+                for (size_t offset = 0; offset < content.size(); offset += KERNEL_BLOCK_SIZE) {
+                    std::memset(tables, 0, sizeof(tables));
+                    kernel.kernel(content.data() + offset, std::min(KERNEL_BLOCK_SIZE, content.size() - offset), tables);
+                }
+                return true;
+            });
+            results.push_back({ corpus.first, std::string("histogram_") + kernel.name, options.corpus_size, seconds });
+        }
+
+        // the first run reads the file from the drive, the best one is likely page cache
+        seconds = best_seconds(options.repeat, [] {}, [&] {
+            return checker.get_file_entropy(corpus_path.wstring()) >= 0.0;
+        });
+        results.push_back({ corpus.first, "get_file_entropy", options.corpus_size, seconds });
+
+        // every erasure run gets a fresh copy of the corpus, copying is not measured
+        const ShannonEncryptionChecker::InformationEntropyEstimation estimation =
+            ShannonEncryptionChecker::information_entropy_estimation(entropy, options.corpus_size);
+        const fs::path erased_path = options.directory / (corpus.first + ".erased");
+        for (const auto& method : erasure_methods) {
+            seconds = best_seconds(options.repeat, [&] {
+                fs::copy_file(corpus_path, erased_path, fs::copy_options::overwrite_existing);
+            }, [&] {
+                NativeFileEraser eraser(erased_path.wstring(), estimation, helpers::PartititonInformation::UnknownType);
+#if defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
+                eraser.set_direct_io(options.direct_io);
+                eraser.set_io_uring_eraser(options.queue_depth > 0 ? &io_uring_eraser : nullptr);
+#endif
+                bool success = (eraser.*std::get<2>(method))(random_mask.random_sequence(), random_mask.random_length());
+                eraser.close();
+#if defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
+                success = (options.queue_depth > 0) ? (io_uring_eraser.wait_all() && success) : success;
+#endif
+                return success;
+            });
+            results.push_back({ corpus.first, std::get<1>(method), options.corpus_size, seconds });
+        }
+
+        fs::remove(erased_path, ec);
+        fs::remove(corpus_path, ec);
+    }
+    fs::remove(options.directory, ec);
+
+    if (options.output.empty()) {
+        write_json(std::cout, options, results);
+    }
+    else {
+        fs::ofstream json(options.output);
+        write_json(json, options, results);
+    }
+    return 0;
+}
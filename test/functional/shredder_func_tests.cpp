@@ -1,10 +1,44 @@
 #include <eraser/shredder_file_properties.h>
+#include <eraser/shredder_file_identity.h>
+#include <eraser/cancellation_token.h>
+#include <eraser/histogram_kernels.h>
+#include <eraser/encryption_checker.h>
+#include <eraser/entropy_file_reader.h>
+#include <eraser/content_signature.h>
+#include <eraser/content_statistics.h>
+#include <eraser/entropy_map.h>
+#include <eraser/erase_range.h>
+#include <eraser/erasure_scheme.h>
+
+#if defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
+#include <eraser/drive_eraser.h>
+#include <eraser/posix_file_eraser.h>
+#include <eraser/io_uring_eraser.h>
+#include <eraser/readback_verifier.h>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <vector>
+#include <memory>
+#include <string>
+#include <iterator>
 
 #define BOOST_AUTO_TEST_MAIN
 #include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
 
 using namespace shredder;
 using namespace boost::unit_test;
+namespace fs = boost::filesystem;
 
 // Functional tests
 /*
@@ -41,6 +75,1172 @@ BOOST_AUTO_TEST_CASE(TestShredderFileProperties)
     BOOST_CHECK_EQUAL(p.get_flags(), 0LL);
 }
 
+BOOST_AUTO_TEST_CASE(TestShredderFileIdentity)
+{
+    fs::path file_path = fs::temp_directory_path() / "eraser_identity_test.bin";
+    fs::ofstream(file_path, std::ios::binary) << "first version";
+
+    ShredderFileIdentity identity = ShredderFileIdentity::read(file_path.wstring());
+    BOOST_CHECK(identity.valid);
+    BOOST_CHECK_EQUAL(identity.size, 13u);
+    BOOST_CHECK(ShredderFileIdentity::read(file_path.wstring()) == identity);
+
+    // any modification changes the identity
+    fs::ofstream(file_path, std::ios::binary | std::ios::app) << ", second version";
+    BOOST_CHECK(ShredderFileIdentity::read(file_path.wstring()) != identity);
+
+    fs::remove(file_path);
+    BOOST_CHECK(!ShredderFileIdentity::read(file_path.wstring()).valid);
+    BOOST_CHECK(ShredderFileIdentity::read(file_path.wstring()) != ShredderFileIdentity::read(file_path.wstring()));
+}
+
+BOOST_AUTO_TEST_CASE(TestCancellationToken)
+{
+    std::vector<uint8_t> sequence(1024 * 1024 * 4, 'a');
+    auto cancelled_token = std::make_shared<CancellationToken>();
+    auto other_token = std::make_shared<CancellationToken>();
+
+    ShannonEncryptionChecker cancelled_checker;
+    cancelled_checker.set_cancellation_token(cancelled_token);
+    ShannonEncryptionChecker other_checker;
+    other_checker.set_cancellation_token(other_token);
+
+    // cancellation of one check does not affect the others
+    cancelled_token->cancel();
+    BOOST_CHECK_EQUAL(cancelled_checker.get_sequence_entropy(sequence.data(), sequence.size()), -1.0);
+    BOOST_CHECK_SMALL(other_checker.get_sequence_entropy(sequence.data(), sequence.size()), 1e-9);
+    BOOST_CHECK(!other_token->is_cancelled());
+}
+
+BOOST_AUTO_TEST_CASE(TestProgressThrottling)
+{
+    struct ProgressCounter : IShredderCallback
+    {
+        void init(uintmax_t op_count) override { total = op_count; ++inits; }
+        void set_value(uintmax_t value) override { increasing = increasing && value > last; last = value; ++calls; }
+        void cleanup() override {}
+
+        uintmax_t total{};
+        uintmax_t last{};
+        size_t inits{};
+        size_t calls{};
+        bool increasing = true;
+    };
+
+    // 256 blocks of the scan, reported once per percent or per 250 ms
+    const std::vector<uint8_t> sequence(1024 * 1024 * 256, 'a');
+    ProgressCounter progress;
+    ShannonEncryptionChecker checker;
+    checker.set_callback(&progress);
+    auto start = std::chrono::steady_clock::now();
+    BOOST_CHECK_SMALL(checker.get_sequence_entropy(sequence.data(), sequence.size()), 1e-9);
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+    BOOST_CHECK_EQUAL(progress.inits, 1u);
+    BOOST_CHECK_EQUAL(progress.total, sequence.size());
+    BOOST_CHECK_EQUAL(progress.last, sequence.size());
+    BOOST_CHECK(progress.increasing);
+    BOOST_CHECK_LE(progress.calls, 101u + static_cast<size_t>(elapsed.count() / 250));
+    BOOST_CHECK_GE(progress.calls, 50u);
+}
+
+BOOST_AUTO_TEST_CASE(TestCoalesceRanges)
+{
+    std::vector<EraseRange> ranges{ { 300, 50 }, { 0, 100 }, { 100, 20 }, { 50, 10 }, { 200, 0 }, { 320, 100 } };
+    coalesce_ranges(ranges);
+    BOOST_REQUIRE_EQUAL(ranges.size(), 2u);
+    BOOST_CHECK_EQUAL(ranges[0].offset, 0u);
+    BOOST_CHECK_EQUAL(ranges[0].length, 120u);
+    BOOST_CHECK_EQUAL(ranges[1].offset, 300u);
+    BOOST_CHECK_EQUAL(ranges[1].end(), 420u);
+
+    // anchors covered by the overwrite are skipped
+    BOOST_CHECK(contains_offset(ranges, 0));
+    BOOST_CHECK(contains_offset(ranges, 119));
+    BOOST_CHECK(!contains_offset(ranges, 120));
+    BOOST_CHECK(!contains_offset(ranges, 299));
+    BOOST_CHECK(contains_offset(ranges, 419));
+    BOOST_CHECK(!contains_offset(ranges, 420));
+    BOOST_CHECK(!contains_offset({}, 0));
+}
+
 #pragma endregion
 
 BOOST_AUTO_TEST_SUITE_END()
+
+#pragma region HistogramKernelsTests
+
+namespace {
+
+/// Straightforward byte counting every kernel is compared against
+std::array<uint64_t, 256> reference_histogram(const uint8_t* data, size_t size)
+{
+    std::array<uint64_t, 256> counters{};
+    for (size_t i = 0; i < size; ++i) {
+        ++counters[data[i]];
+    }
+    return counters;
+}
+
+/// Run the kernel and sum up its partial tables
+std::array<uint64_t, 256> kernel_histogram(HistogramKernel kernel, const uint8_t* data, size_t size)
+{
+    HistogramTables tables = {};
+    kernel(data, size, tables);
+    std::array<uint64_t, 256> counters{};
+    for (size_t b = 0; b < 256; ++b) {
+        for (size_t t = 0; t < HISTOGRAM_TABLES_COUNT; ++t) {
+            counters[b] += tables[t][b];
+        }
+    }
+    return counters;
+}
+
+/// Random data, same-byte runs crossing vector boundaries and the whole byte range
+std::vector<std::vector<uint8_t>> histogram_test_inputs()
+{
+    std::mt19937 generator(20240611);
+    std::uniform_int_distribution<unsigned> byte_distribution(0, 255);
+    std::vector<std::vector<uint8_t>> inputs;
+
+    std::vector<uint8_t> random_data(1024 * 1024 + 13);
+    for (uint8_t& b : random_data) {
+        b = static_cast<uint8_t>(byte_distribution(generator));
+    }
+    inputs.push_back(std::move(random_data));
+
+    inputs.push_back(std::vector<uint8_t>(64 * 1024 + 7, 0x00));
+    inputs.push_back(std::vector<uint8_t>(64 * 1024 + 63, 0xFF));
+
+    // runs of every length from 1 to 130 bytes, partly equal vectors
+    std::vector<uint8_t> runs;
+    for (size_t run_length = 1; run_length <= 130; ++run_length) {
+        runs.insert(runs.end(), run_length, static_cast<uint8_t>(run_length * 37));
+    }
+    inputs.push_back(std::move(runs));
+
+    // vector-sized blocks which differ in the last byte only
+    std::vector<uint8_t> almost_equal(64 * 64, 0xAA);
+    for (size_t i = 63; i < almost_equal.size(); i += 64) {
+        almost_equal[i] = 0xAB;
+    }
+    inputs.push_back(std::move(almost_equal));
+
+    std::vector<uint8_t> all_bytes;
+    for (size_t i = 0; i < 256 * 17; ++i) {
+        all_bytes.push_back(static_cast<uint8_t>(i));
+    }
+    inputs.push_back(std::move(all_bytes));
+
+    return inputs;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(HistogramKernelsTests);
+
+BOOST_AUTO_TEST_CASE(TestKernelsMatchScalar)
+{
+    std::vector<HistogramKernelInfo> kernels = supported_histogram_kernels();
+    BOOST_REQUIRE(!kernels.empty());
+    BOOST_CHECK_EQUAL(std::string(kernels.front().name), "scalar");
+
+    for (const std::vector<uint8_t>& input : histogram_test_inputs()) {
+        // every size around vector width and every misaligned start
+        for (size_t offset = 0; offset < 65 && offset < input.size(); offset += 7) {
+            for (size_t size : { size_t(0), size_t(1), size_t(15), size_t(16), size_t(31), size_t(33),
+                                 size_t(63), size_t(64), size_t(65), input.size() - offset }) {
+                if (offset + size > input.size()) {
+                    continue;
+                }
+                auto expected = reference_histogram(input.data() + offset, size);
+                for (const HistogramKernelInfo& k : kernels) {
+                    BOOST_TEST_CONTEXT("kernel " << k.name << ", offset " << offset << ", size " << size) {
+                        BOOST_CHECK(kernel_histogram(k.kernel, input.data() + offset, size) == expected);
+                    }
+                }
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestRunSkippingPages)
+{
+    // zero-filled pages, random pages, and pages starting with a run followed by random bytes
+    std::mt19937 generator(31);
+    std::vector<uint8_t> content;
+    for (size_t page = 0; page < 24; ++page) {
+        std::vector<uint8_t> bytes(4096 + (page % 5) * 1000, 0);
+        if (page % 3 != 0) {
+            const size_t run_length = (page % 3 == 2) ? 100 : 0;
+            for (size_t i = run_length; i < bytes.size(); ++i) {
+                bytes[i] = static_cast<uint8_t>(generator());
+            }
+        }
+        content.insert(content.end(), bytes.begin(), bytes.end());
+    }
+
+    BOOST_CHECK(starts_with_run(content.data(), content.size()));
+    BOOST_CHECK(!starts_with_run(content.data(), RUN_PROBE_SIZE - 1));
+
+    ByteHistogram histogram;
+    histogram.update(content.data(), content.size());
+    const auto expected = reference_histogram(content.data(), content.size());
+    BOOST_REQUIRE_EQUAL(histogram.total(), content.size());
+    for (size_t b = 0; b < ByteHistogram::BINS_COUNT; ++b) {
+        BOOST_CHECK_EQUAL(histogram.count(static_cast<uint8_t>(b)), expected[b]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestHistogramEntropy)
+{
+    std::array<uint64_t, 256> uniform;
+    uniform.fill(1000);
+    BOOST_CHECK_CLOSE(histogram_entropy(uniform.data(), uniform.size(), 256000), 8.0, 1e-12);
+
+    std::array<uint64_t, 256> single{};
+    single[0x41] = 12345;
+    BOOST_CHECK_EQUAL(histogram_entropy(single.data(), single.size(), 12345), 0.0);
+    BOOST_CHECK_EQUAL(histogram_entropy(single.data(), single.size(), 0), 0.0);
+
+    // same value as Shannon formula over probabilities
+    std::mt19937 generator(42);
+    std::array<uint64_t, 256> counters{};
+    uintmax_t total{};
+    for (uint64_t& c : counters) {
+        c = generator() % 5000;
+        total += c;
+    }
+    std::vector<double> probabilities;
+    for (uint64_t c : counters) {
+        probabilities.push_back(static_cast<double>(c) / total);
+    }
+    BOOST_CHECK_CLOSE(histogram_entropy(counters.data(), counters.size(), total),
+        shannon_entropy(probabilities.begin(), probabilities.end()), 1e-9);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#pragma endregion
+
+#pragma region ContentStatisticsTests
+
+BOOST_AUTO_TEST_SUITE(ContentStatisticsTests);
+
+BOOST_AUTO_TEST_CASE(TestStatisticsDoNotDependOnBlocks)
+{
+    std::mt19937 generator(7);
+    std::vector<uint8_t> input(1024 * 300 + 17);
+    for (uint8_t& b : input) {
+        b = static_cast<uint8_t>(generator() % 97);
+    }
+
+    ContentStatistics whole;
+    whole.update(input.data(), input.size());
+
+    // odd block sizes split Monte Carlo points and consecutive pairs
+    ContentStatistics blocks;
+    for (size_t offset = 0, block = 1; offset < input.size(); offset += block, block = block * 3 + 1) {
+        block = std::min(block, input.size() - offset);
+        blocks.update(input.data() + offset, block);
+    }
+
+    BOOST_CHECK_EQUAL(whole.total(), blocks.total());
+    BOOST_CHECK_EQUAL(whole.chi_square(), blocks.chi_square());
+    BOOST_CHECK_EQUAL(whole.serial_correlation(), blocks.serial_correlation());
+    BOOST_CHECK_EQUAL(whole.monte_carlo_pi(), blocks.monte_carlo_pi());
+    BOOST_CHECK_EQUAL(whole.monte_carlo_points(), input.size() / 6);
+}
+
+BOOST_AUTO_TEST_CASE(TestClassifyRandomAndSkewed)
+{
+    std::mt19937 generator(11);
+    std::vector<uint8_t> random_bytes(1024 * 1024 * 8);
+    for (uint8_t& b : random_bytes) {
+        b = static_cast<uint8_t>(generator());
+    }
+
+    ShannonEncryptionChecker checker;
+    ShannonEncryptionChecker::ContentClassification random_class =
+        checker.get_sequence_classification(random_bytes.data(), random_bytes.size());
+    BOOST_CHECK(random_class.random);
+    BOOST_CHECK(!random_class.compressed);
+    BOOST_CHECK_CLOSE(random_class.mean, 127.5, 0.5);
+    BOOST_CHECK_SMALL(random_class.serial_correlation, 0.01);
+    BOOST_CHECK_CLOSE(random_class.monte_carlo_pi, 3.14159, 1.0);
+
+    // every 64th byte is zero: entropy is still high, but chi-square is far from uniform
+    for (size_t i = 0; i < random_bytes.size(); i += 64) {
+        random_bytes[i] = 0;
+    }
+    ShannonEncryptionChecker::ContentClassification skewed_class =
+        checker.get_sequence_classification(random_bytes.data(), random_bytes.size());
+    BOOST_CHECK(!skewed_class.random);
+    BOOST_CHECK(skewed_class.estimation != ShannonEncryptionChecker::Encrypted);
+}
+
+BOOST_AUTO_TEST_CASE(TestSignatureClassification)
+{
+    const uint8_t xz_header[] = { 0xFD, '7', 'z', 'X', 'Z', 0x00, 0x00, 0x04 };
+    const uint8_t mp4_header[] = { 0x00, 0x00, 0x00, 0x20, 'f', 't', 'y', 'p', 'i', 's', 'o', 'm' };
+    const uint8_t gpg_header[] = { 0x8C, 0x0D, 0x04, 0x09, 0x03, 0x08 };
+    BOOST_CHECK_EQUAL(ContentSignature::detect(xz_header, sizeof(xz_header)), ContentSignature::Xz);
+    BOOST_CHECK_EQUAL(ContentSignature::detect(mp4_header, sizeof(mp4_header)), ContentSignature::Mp4);
+    BOOST_CHECK_EQUAL(ContentSignature::detect(gpg_header, sizeof(gpg_header)), ContentSignature::Gpg);
+    BOOST_CHECK_EQUAL(ContentSignature::detect(mp4_header, 6), ContentSignature::Unknown);
+    BOOST_CHECK(ContentSignature::is_encrypted(ContentSignature::Gpg));
+
+    // zip header followed by random data is compressed, followed by text is rejected by the sample
+    std::mt19937 generator(17);
+    std::vector<uint8_t> content(1024 * 1024 * 2);
+    for (uint8_t& b : content) {
+        b = static_cast<uint8_t>(generator());
+    }
+    std::memcpy(content.data(), "PK\x03\x04", 4);
+    fs::path file_path = fs::temp_directory_path() / "eraser_signature_test.zip";
+    fs::ofstream(file_path, std::ios::binary).write(reinterpret_cast<const char*>(content.data()), content.size());
+
+    ShannonEncryptionChecker checker;
+    ShannonEncryptionChecker::ContentClassification classification;
+    BOOST_REQUIRE(checker.get_signature_classification(file_path.wstring(), classification));
+    BOOST_CHECK(classification.compressed);
+    BOOST_CHECK_EQUAL(classification.estimation, ShannonEncryptionChecker::Binary);
+
+    // GPG header is accepted only if the sample is ciphertext, binary data after it goes to the regular scan
+    std::memcpy(content.data(), gpg_header, sizeof(gpg_header));
+    fs::ofstream(file_path, std::ios::binary).write(reinterpret_cast<const char*>(content.data()), content.size());
+    BOOST_REQUIRE(checker.get_signature_classification(file_path.wstring(), classification));
+    BOOST_CHECK_EQUAL(classification.estimation, ShannonEncryptionChecker::Encrypted);
+
+    for (auto it = content.begin() + sizeof(gpg_header); it != content.end(); ++it) {
+        *it = static_cast<uint8_t>(generator() % 160);
+    }
+    fs::ofstream(file_path, std::ios::binary).write(reinterpret_cast<const char*>(content.data()), content.size());
+    BOOST_CHECK(!checker.get_signature_classification(file_path.wstring(), classification));
+
+    std::memcpy(content.data(), "PK\x03\x04", 4);
+    std::fill(content.begin() + 4, content.end(), 'a');
+    fs::ofstream(file_path, std::ios::binary).write(reinterpret_cast<const char*>(content.data()), content.size());
+    BOOST_CHECK(!checker.get_signature_classification(file_path.wstring(), classification));
+    fs::remove(file_path);
+}
+
+BOOST_AUTO_TEST_CASE(TestEntropyMapOfMixedFile)
+{
+    // plain text region, random region, shorter plain tail
+    constexpr size_t region_size = 1024 * 256;
+    std::mt19937 generator(13);
+    std::vector<uint8_t> content(region_size * 2 + 1000, 'a');
+    for (size_t i = region_size; i < region_size * 2; ++i) {
+        content[i] = static_cast<uint8_t>(generator());
+    }
+
+    fs::path file_path = fs::temp_directory_path() / "eraser_entropy_map_test.bin";
+    fs::ofstream(file_path, std::ios::binary).write(reinterpret_cast<const char*>(content.data()), content.size());
+
+    EntropyMap entropy_map(region_size);
+    ShannonEncryptionChecker checker;
+    checker.set_entropy_map(&entropy_map);
+    BOOST_CHECK_GE(checker.get_file_entropy(file_path.wstring()), 0.0);
+    fs::remove(file_path);
+
+    BOOST_REQUIRE_EQUAL(entropy_map.regions_count(), 3u);
+    BOOST_CHECK_SMALL(entropy_map.entropy(0), 0.05);
+    BOOST_CHECK_GT(entropy_map.entropy(1), 7.9);
+    BOOST_CHECK_SMALL(entropy_map.entropy(2), 0.05);
+
+    EntropyMap stored_map;
+    BOOST_REQUIRE(EntropyMap::from_hex(entropy_map.to_hex(), region_size, stored_map));
+    BOOST_CHECK_EQUAL(stored_map.to_hex(), entropy_map.to_hex());
+    BOOST_CHECK(!EntropyMap::from_hex("abc", region_size, stored_map));
+}
+
+BOOST_AUTO_TEST_CASE(TestSampledEstimate)
+{
+    std::mt19937 generator(29);
+    std::vector<uint8_t> content(1024 * 1024 * 32);
+    for (uint8_t& b : content) {
+        b = static_cast<uint8_t>(generator() % 200);
+    }
+    fs::path file_path = fs::temp_directory_path() / "eraser_sampled_test.bin";
+    fs::ofstream(file_path, std::ios::binary).write(reinterpret_cast<const char*>(content.data()), content.size());
+    ByteHistogram whole;
+    whole.update(content.data(), content.size());
+
+    // homogeneous content: bias-corrected estimate of the 4 Mb sample is close, the interval is narrow
+    ShannonEncryptionChecker checker;
+    checker.set_sampling(64);
+    ShannonEncryptionChecker::EntropyEstimate homogeneous = checker.get_sampled_file_entropy(file_path.wstring());
+    BOOST_CHECK(homogeneous.sampled);
+    BOOST_CHECK_EQUAL(homogeneous.sample_size, 64u * 64 * 1024);
+    BOOST_CHECK_EQUAL(homogeneous.file_size, content.size());
+    BOOST_CHECK_SMALL(homogeneous.entropy - whole.entropy(), 0.01);
+    BOOST_CHECK_LE(homogeneous.lower_bound, homogeneous.entropy);
+    BOOST_CHECK_GE(homogeneous.upper_bound, homogeneous.entropy);
+    BOOST_CHECK_LT(homogeneous.upper_bound - homogeneous.lower_bound, 0.01);
+
+    // plain first half: blocks differ, the jackknife interval widens and still holds the whole file entropy.
+    // Strata cover both halves evenly, so the point estimate stays close as well
+    std::fill(content.begin(), content.begin() + content.size() / 2, 'a');
+    fs::ofstream(file_path, std::ios::binary).write(reinterpret_cast<const char*>(content.data()), content.size());
+    whole.clear();
+    whole.update(content.data(), content.size());
+    ShannonEncryptionChecker::EntropyEstimate mixed = checker.get_sampled_file_entropy(file_path.wstring());
+    BOOST_CHECK_SMALL(mixed.entropy - whole.entropy(), 0.05);
+    BOOST_CHECK_LE(mixed.lower_bound, whole.entropy());
+    BOOST_CHECK_GE(mixed.upper_bound, whole.entropy());
+    BOOST_CHECK_GT(mixed.upper_bound - mixed.lower_bound, (homogeneous.upper_bound - homogeneous.lower_bound) * 10);
+
+    // the file not bigger than the sample is read completely
+    checker.set_sampling(1024);
+    ShannonEncryptionChecker::EntropyEstimate complete = checker.get_sampled_file_entropy(file_path.wstring());
+    BOOST_CHECK(!complete.sampled);
+    BOOST_CHECK_EQUAL(complete.lower_bound, complete.upper_bound);
+    fs::remove(file_path);
+}
+
+BOOST_AUTO_TEST_CASE(TestMappedWindows)
+{
+    // longer than one 128 Mb window, the last window is short and Monte Carlo points cross the window boundary
+    std::vector<uint8_t> content(1024 * 1024 * 133 + 777);
+    for (size_t i = 0; i < content.size(); ++i) {
+        content[i] = static_cast<uint8_t>((i * 7 + i / 4096) % 251);
+    }
+    fs::path file_path = fs::temp_directory_path() / "eraser_mapped_test.bin";
+    fs::ofstream(file_path, std::ios::binary).write(reinterpret_cast<const char*>(content.data()), content.size());
+
+    ContentStatistics whole;
+    whole.update(content.data(), content.size());
+
+    ShannonEncryptionChecker checker;
+    checker.set_scan_mode(ShannonEncryptionChecker::MappedScan);
+    ByteHistogram mapped;
+    BOOST_REQUIRE(checker.get_file_range_histogram(file_path.wstring(), 0, content.size(), mapped));
+    BOOST_REQUIRE_EQUAL(mapped.total(), content.size());
+    for (size_t b = 0; b < ByteHistogram::BINS_COUNT; ++b) {
+        BOOST_CHECK_EQUAL(mapped.count(static_cast<uint8_t>(b)), whole.histogram().count(static_cast<uint8_t>(b)));
+    }
+
+    // windows are mapped from the range offset, not from the file start
+    ContentStatistics mapped_statistics;
+    BOOST_REQUIRE(checker.get_file_range_statistics(file_path.wstring(), 0, content.size(), mapped_statistics));
+    BOOST_CHECK_EQUAL(mapped_statistics.serial_correlation(), whole.serial_correlation());
+    BOOST_CHECK_EQUAL(mapped_statistics.monte_carlo_pi(), whole.monte_carlo_pi());
+
+    ByteHistogram tail;
+    BOOST_REQUIRE(checker.get_file_range_histogram(file_path.wstring(), 1024 * 1024 * 4, content.size(), tail));
+    BOOST_CHECK_EQUAL(tail.total(), content.size() - 1024 * 1024 * 4);
+    fs::remove(file_path);
+}
+
+BOOST_AUTO_TEST_CASE(TestFileRangesMerge)
+{
+    // ranges are long enough to be mapped and made of whole Monte Carlo points, the last one is shorter
+    constexpr size_t range_size = 1024 * 1024 * 18;
+    std::mt19937 generator(19);
+    std::vector<uint8_t> content(range_size * 2 + 12345);
+    for (uint8_t& b : content) {
+        b = static_cast<uint8_t>(generator() % 200);
+    }
+    fs::path file_path = fs::temp_directory_path() / "eraser_ranges_test.bin";
+    fs::ofstream(file_path, std::ios::binary).write(reinterpret_cast<const char*>(content.data()), content.size());
+
+    ByteHistogram whole;
+    whole.update(content.data(), content.size());
+    ContentStatistics whole_statistics;
+    whole_statistics.update(content.data(), content.size());
+    for (auto scan_mode : { ShannonEncryptionChecker::BufferedScan, ShannonEncryptionChecker::MappedScan, ShannonEncryptionChecker::AsyncScan }) {
+        ShannonEncryptionChecker checker;
+        checker.set_scan_mode(scan_mode);
+        ByteHistogram merged;
+        ContentStatistics appended;
+        EntropyMap appended_map;
+        for (uintmax_t offset = 0; offset < content.size(); offset += range_size) {
+            EntropyMap range_map;
+            checker.set_entropy_map(&range_map);
+            ByteHistogram range;
+            BOOST_REQUIRE(checker.get_file_range_histogram(file_path.wstring(), offset, range_size, range));
+            merged.merge(range);
+            appended_map.append(range_map);
+            checker.set_entropy_map(nullptr);
+
+            ContentStatistics range_statistics;
+            BOOST_REQUIRE(checker.get_file_range_statistics(file_path.wstring(), offset, range_size, range_statistics));
+            appended.append(range_statistics);
+        }
+        BOOST_REQUIRE_EQUAL(merged.total(), whole.total());
+        for (size_t b = 0; b < ByteHistogram::BINS_COUNT; ++b) {
+            BOOST_CHECK_EQUAL(merged.count(static_cast<uint8_t>(b)), whole.count(static_cast<uint8_t>(b)));
+        }
+
+        // appended statistics are exactly those of the whole file
+        BOOST_CHECK_EQUAL(appended.total(), whole_statistics.total());
+        BOOST_CHECK_EQUAL(appended.serial_correlation(), whole_statistics.serial_correlation());
+        BOOST_CHECK_EQUAL(appended.monte_carlo_points(), whole_statistics.monte_carlo_points());
+        BOOST_CHECK_EQUAL(appended.monte_carlo_pi(), whole_statistics.monte_carlo_pi());
+
+        // appended maps of ranges are the map of the whole file
+        EntropyMap whole_map;
+        checker.set_entropy_map(&whole_map);
+        checker.get_file_entropy(file_path.wstring());
+        BOOST_CHECK_EQUAL(appended_map.regions_count(), (content.size() + whole_map.region_size() - 1) / whole_map.region_size());
+        BOOST_CHECK_EQUAL(appended_map.to_hex(), whole_map.to_hex());
+    }
+
+    // the sample is classified the same way as the whole file, every region gets the map entry
+    ShannonEncryptionChecker checker;
+    checker.set_sampling(64);
+    EntropyMap sampled_map;
+    checker.set_entropy_map(&sampled_map);
+    BOOST_CHECK_EQUAL(checker.get_sampled_file_classification(file_path.wstring()).estimation,
+                      ShannonEncryptionChecker::get_statistics_classification(whole_statistics).estimation);
+    BOOST_CHECK_EQUAL(sampled_map.regions_count(), (content.size() + sampled_map.region_size() - 1) / sampled_map.region_size());
+    fs::remove(file_path);
+}
+
+BOOST_AUTO_TEST_CASE(TestAsyncScan)
+{
+    if (!ShannonEncryptionChecker::is_async_scan_supported()) {
+        BOOST_TEST_MESSAGE("io_uring is not available, skipped");
+        return;
+    }
+
+    // more blocks than the queue depth, the last one is short
+    std::mt19937 generator(29);
+    std::vector<uint8_t> content(1024 * 1024 * 20 + 777);
+    for (uint8_t& b : content) {
+        b = static_cast<uint8_t>(generator() % 100);
+    }
+    fs::path file_path = fs::temp_directory_path() / "eraser_async_test.bin";
+    fs::ofstream(file_path, std::ios::binary).write(reinterpret_cast<const char*>(content.data()), content.size());
+
+    // the pipeline is started for the file, ordered blocks are the file content
+    EntropyFileReader reader;
+    BOOST_REQUIRE(reader.open(file_path.wstring()));
+    BOOST_REQUIRE(reader.start_async(1024 * 1024, 4, 0, UINTMAX_MAX, true));
+    std::vector<uint8_t> ordered;
+    const uint8_t* block_start{};
+    size_t block_size{};
+    while (reader.next_async_block(block_start, block_size) && block_size > 0) {
+        ordered.insert(ordered.end(), block_start, block_start + block_size);
+    }
+    BOOST_CHECK(ordered == content);
+    reader.close();
+
+    ShannonEncryptionChecker buffered;
+    ShannonEncryptionChecker async;
+    async.set_scan_mode(ShannonEncryptionChecker::AsyncScan);
+    async.set_async_queue_depth(4);
+    BOOST_CHECK_EQUAL(async.get_file_entropy(file_path.wstring()), buffered.get_file_entropy(file_path.wstring()));
+
+    // blocks come in completion order, the histogram of the range is the same
+    ByteHistogram buffered_range;
+    ByteHistogram async_range;
+    BOOST_REQUIRE(buffered.get_file_range_histogram(file_path.wstring(), 1024 * 1024 * 3, 1024 * 1024 * 10, buffered_range));
+    BOOST_REQUIRE(async.get_file_range_histogram(file_path.wstring(), 1024 * 1024 * 3, 1024 * 1024 * 10, async_range));
+    BOOST_REQUIRE_EQUAL(async_range.total(), buffered_range.total());
+    for (size_t b = 0; b < ByteHistogram::BINS_COUNT; ++b) {
+        BOOST_CHECK_EQUAL(async_range.count(static_cast<uint8_t>(b)), buffered_range.count(static_cast<uint8_t>(b)));
+    }
+
+    // statistics depend on the order of blocks
+    ShannonEncryptionChecker::ContentClassification buffered_classification = buffered.get_file_classification(file_path.wstring());
+    ShannonEncryptionChecker::ContentClassification async_classification = async.get_file_classification(file_path.wstring());
+    BOOST_CHECK_EQUAL(async_classification.serial_correlation, buffered_classification.serial_correlation);
+    BOOST_CHECK_EQUAL(async_classification.monte_carlo_pi, buffered_classification.monte_carlo_pi);
+    fs::remove(file_path);
+}
+
+BOOST_AUTO_TEST_CASE(TestClassifyEarlyStop)
+{
+    std::mt19937 generator(23);
+    std::vector<uint8_t> content(1024 * 1024 * 32);
+    for (uint8_t& b : content) {
+        b = static_cast<uint8_t>(generator());
+    }
+    fs::path file_path = fs::temp_directory_path() / "eraser_classify_test.bin";
+    fs::ofstream(file_path, std::ios::binary).write(reinterpret_cast<const char*>(content.data()), content.size());
+
+    // random content is settled long before the end of file
+    ShannonEncryptionChecker checker;
+    ShannonEncryptionChecker::EntropyEstimate estimate = checker.classify_file_entropy(file_path.wstring());
+    BOOST_CHECK(estimate.sampled);
+    BOOST_CHECK_LT(estimate.sample_size, content.size());
+    BOOST_CHECK_EQUAL(estimate.estimation, ShannonEncryptionChecker::Encrypted);
+    BOOST_CHECK_LE(estimate.lower_bound, estimate.entropy);
+    BOOST_CHECK_GE(estimate.upper_bound, estimate.entropy);
+
+    // the file smaller than the minimal sample is read completely
+    fs::resize_file(file_path, 1024 * 1024 * 2);
+    estimate = checker.classify_file_entropy(file_path.wstring());
+    BOOST_CHECK(!estimate.sampled);
+    BOOST_CHECK_EQUAL(estimate.sample_size, 1024 * 1024 * 2);
+    BOOST_CHECK_EQUAL(estimate.lower_bound, estimate.entropy);
+    fs::remove(file_path);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#pragma endregion
+
+#if defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
+
+#pragma region PosixFileEraserTests
+
+namespace {
+
+/// Erasure is checked on tmpfs (/dev/shm) and, if ERASER_TEST_EXT4_DIR is set,
+/// in the directory of the mounted ext4 image (loop-mounted by scripts/ext4_test_image.sh,
+/// see the ERASER_TEST_EXT4 option)
+std::vector<fs::path> eraser_test_directories()
+{
+    std::vector<fs::path> directories;
+    boost::system::error_code ec;
+    if (fs::is_directory("/dev/shm", ec)) {
+        directories.emplace_back("/dev/shm");
+    }
+    else {
+        directories.push_back(fs::temp_directory_path());
+    }
+    if (const char* ext4_directory = std::getenv("ERASER_TEST_EXT4_DIR")) {
+        directories.emplace_back(ext4_directory);
+    }
+    return directories;
+}
+
+std::vector<uint8_t> read_content(const fs::path& file_path)
+{
+    fs::ifstream file(file_path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(PosixFileEraserTests);
+
+BOOST_AUTO_TEST_CASE(TestEraseFullAndBeginEnd)
+{
+    constexpr size_t mask_length = 0xFFFF;
+    std::vector<uint8_t> mask(mask_length, 0x5A);
+    const std::vector<uint8_t> content(1024 * 1024 * 3 + 100, 'a');
+
+    for (const fs::path& directory : eraser_test_directories()) {
+        fs::path file_path = directory / "eraser_posix_test.bin";
+        fs::ofstream(file_path, std::ios::binary).write(reinterpret_cast<const char*>(content.data()), content.size());
+
+        {
+            NativeFileEraser eraser(file_path.wstring(), ShannonEncryptionChecker::Encrypted, helpers::PartititonInformation::HDD);
+            BOOST_CHECK(eraser.erase_begin_end(mask.data(), mask.size()));
+        }
+        std::vector<uint8_t> erased = read_content(file_path);
+        BOOST_REQUIRE_EQUAL(erased.size(), content.size());
+        BOOST_CHECK(std::all_of(erased.begin(), erased.begin() + mask_length, [](uint8_t b) { return b == 0x5A; }));
+        BOOST_CHECK(std::all_of(erased.end() - mask_length, erased.end(), [](uint8_t b) { return b == 0x5A; }));
+        BOOST_CHECK_EQUAL(erased[content.size() / 2], 'a');
+
+        // anchors of SSD are marked between the header and the footer, a queue of them at once
+        fs::ofstream(file_path, std::ios::binary).write(reinterpret_cast<const char*>(content.data()), content.size());
+        {
+            NativeFileEraser eraser(file_path.wstring(), ShannonEncryptionChecker::Encrypted, helpers::PartititonInformation::SSD);
+            BOOST_CHECK(eraser.erase_begin_end(mask.data(), mask.size()));
+        }
+        erased = read_content(file_path);
+        BOOST_REQUIRE_EQUAL(erased.size(), content.size());
+        for (size_t anchor = mask_length * 2; anchor < content.size() - mask_length; anchor += mask_length) {
+            BOOST_CHECK_EQUAL(erased[anchor], 0xEF);
+        }
+        BOOST_CHECK_EQUAL(erased[mask_length * 2 + 1], 'a');
+
+        // small write blocks, so that the mask is repeated and the tail is shorter than a block
+        {
+            NativeFileEraser eraser(file_path.wstring(), ShannonEncryptionChecker::Plain, helpers::PartititonInformation::SSD);
+            eraser.set_block_size(1024 * 100);
+            BOOST_CHECK(eraser.erase_smart(mask.data(), mask.size()));
+        }
+        erased = read_content(file_path);
+        BOOST_REQUIRE_EQUAL(erased.size(), content.size());
+        BOOST_CHECK(std::all_of(erased.begin(), erased.end(), [](uint8_t b) { return b == 0x5A; }));
+
+        fs::remove(file_path);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestEraseRandom)
+{
+    // short mask, so that many random areas overlap and are written together
+    constexpr size_t mask_length = 1024;
+    std::vector<uint8_t> mask(mask_length, 0x5A);
+    const std::vector<uint8_t> content(1024 * 1024 * 2 + 100, 'a');
+
+    for (const fs::path& directory : eraser_test_directories()) {
+        fs::path file_path = directory / "eraser_random_test.bin";
+        fs::ofstream(file_path, std::ios::binary).write(reinterpret_cast<const char*>(content.data()), content.size());
+
+        {
+            NativeFileEraser eraser(file_path.wstring(), ShannonEncryptionChecker::Encrypted, helpers::PartititonInformation::HDD);
+            BOOST_CHECK(eraser.erase_random(mask.data(), mask.size()));
+        }
+        std::vector<uint8_t> erased = read_content(file_path);
+        BOOST_REQUIRE_EQUAL(erased.size(), content.size());
+        BOOST_CHECK(std::all_of(erased.begin(), erased.begin() + mask_length, [](uint8_t b) { return b == 0x5A; }));
+        BOOST_CHECK(std::all_of(erased.end() - mask_length, erased.end(), [](uint8_t b) { return b == 0x5A; }));
+        const size_t erased_bytes = std::count(erased.begin(), erased.end(), 0x5A);
+        BOOST_CHECK_GT(erased_bytes, content.size() / 10);
+        BOOST_CHECK_LT(erased_bytes, content.size() / 4);
+
+        fs::remove(file_path);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestEraseDiscard)
+{
+    constexpr size_t mask_length = 0xFFFF;
+    std::vector<uint8_t> mask(mask_length, 0x5A);
+    const std::vector<uint8_t> content(1024 * 1024 * 3 + 100, 'a');
+
+    for (const fs::path& directory : eraser_test_directories()) {
+        fs::path file_path = directory / "eraser_discard_test.bin";
+        fs::ofstream(file_path, std::ios::binary).write(reinterpret_cast<const char*>(content.data()), content.size());
+        // blocks are allocated on flush, the data of delayed allocation is released without blocks
+        BOOST_REQUIRE(NativeFileEraser::flush_file(file_path.wstring()));
+
+        {
+            NativeFileEraser eraser(file_path.wstring(), ShannonEncryptionChecker::Plain, helpers::PartititonInformation::SSD);
+            BOOST_CHECK(eraser.erase_discard(mask.data(), mask.size()));
+
+            // only blocks between the header and the footer are released and trimmed
+            uint64_t released_bytes{};
+            for (const EraseRange& released : eraser.released_extents()) {
+                released_bytes += released.length;
+            }
+            BOOST_CHECK_LE(released_bytes, content.size() - 2 * mask_length);
+            const char* ext4_directory = std::getenv("ERASER_TEST_EXT4_DIR");
+            if (ext4_directory && directory == ext4_directory) {
+                BOOST_CHECK_GT(released_bytes, 0u);
+                BOOST_CHECK(NativeFileEraser::trim_filesystem(directory.wstring(), eraser.released_extents()));
+            }
+        }
+
+        // header and footer are overwritten, the middle is a hole read as zeros, or overwritten if not supported
+        std::vector<uint8_t> erased = read_content(file_path);
+        BOOST_REQUIRE_EQUAL(erased.size(), content.size());
+        BOOST_CHECK(std::all_of(erased.begin(), erased.begin() + mask_length, [](uint8_t b) { return b == 0x5A; }));
+        BOOST_CHECK(std::all_of(erased.end() - mask_length, erased.end(), [](uint8_t b) { return b == 0x5A; }));
+        BOOST_CHECK(std::none_of(erased.begin(), erased.end(), [](uint8_t b) { return b == 'a'; }));
+
+        fs::remove(file_path);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestEraseSparseFile)
+{
+    constexpr size_t mask_length = 0xFFFF;
+    constexpr std::streamoff file_size = 1024 * 1024 * 8;
+    constexpr std::streamoff data_offset = 1024 * 1024 * 3;
+    std::vector<uint8_t> mask(mask_length, 0x5A);
+    const std::vector<uint8_t> content(1024 * 1024, 'a');
+
+    for (const fs::path& directory : eraser_test_directories()) {
+        // one allocated megabyte in the middle of holes
+        fs::path file_path = directory / "eraser_sparse_test.bin";
+        {
+            fs::ofstream file(file_path, std::ios::binary);
+            file.seekp(data_offset);
+            file.write(reinterpret_cast<const char*>(content.data()), content.size());
+        }
+        fs::resize_file(file_path, file_size);
+        struct stat allocated{};
+        BOOST_REQUIRE_EQUAL(::stat(file_path.c_str(), &allocated), 0);
+
+        {
+            NativeFileEraser eraser(file_path.wstring(), ShannonEncryptionChecker::Plain, helpers::PartititonInformation::SSD);
+            BOOST_CHECK(eraser.is_sparse());
+            BOOST_CHECK(eraser.erase_full(mask.data(), mask.size()));
+        }
+
+        // data is overwritten, holes are neither written nor allocated
+        std::vector<uint8_t> erased = read_content(file_path);
+        BOOST_REQUIRE_EQUAL(erased.size(), static_cast<size_t>(file_size));
+        BOOST_CHECK(std::all_of(erased.begin() + data_offset, erased.begin() + data_offset + content.size(),
+                                [](uint8_t b) { return b == 0x5A; }));
+        BOOST_CHECK(std::all_of(erased.begin(), erased.begin() + data_offset, [](uint8_t b) { return b == 0; }));
+        BOOST_CHECK(std::all_of(erased.begin() + data_offset + content.size(), erased.end(), [](uint8_t b) { return b == 0; }));
+        struct stat erased_stat{};
+        BOOST_REQUIRE_EQUAL(::stat(file_path.c_str(), &erased_stat), 0);
+        BOOST_CHECK_EQUAL(erased_stat.st_blocks, allocated.st_blocks);
+
+        fs::remove(file_path);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestMultiPassErasure)
+{
+    const ErasureScheme dod_scheme(ErasureScheme::Type::DoD5220_22M);
+    BOOST_REQUIRE_EQUAL(dod_scheme.passes_count(), 3u);
+    BOOST_CHECK_EQUAL(dod_scheme.pattern(1)[100], static_cast<uint8_t>(~dod_scheme.pattern(0)[0]));
+    BOOST_CHECK_EQUAL(ErasureScheme(ErasureScheme::Type::RandomPasses, 7).passes_count(), 7u);
+
+    // the resumed job writes the patterns of the interrupted one
+    const ErasureScheme resumed_scheme(dod_scheme.type(), dod_scheme.passes_count(), dod_scheme.seed());
+    for (unsigned pass = 0; pass < dod_scheme.passes_count(); ++pass) {
+        BOOST_CHECK(std::equal(dod_scheme.pattern(pass), dod_scheme.pattern(pass) + dod_scheme.pattern_length(),
+                               resumed_scheme.pattern(pass)));
+    }
+
+    const ErasureScheme scheme(ErasureScheme::Type::ZeroOneRandom);
+    BOOST_REQUIRE_EQUAL(scheme.passes_count(), 3u);
+    BOOST_CHECK(std::all_of(scheme.pattern(0), scheme.pattern(0) + scheme.pattern_length(), [](uint8_t b) { return b == 0x00; }));
+    BOOST_CHECK(std::all_of(scheme.pattern(1), scheme.pattern(1) + scheme.pattern_length(), [](uint8_t b) { return b == 0xFF; }));
+
+    const std::vector<uint8_t> content(1024 * 1024 * 3 + 100, 'a');
+    for (const fs::path& directory : eraser_test_directories()) {
+        fs::path file_path = directory / "eraser_passes_test.bin";
+        fs::ofstream(file_path, std::ios::binary).write(reinterpret_cast<const char*>(content.data()), content.size());
+
+        {
+            NativeFileEraser eraser(file_path.wstring(), ShannonEncryptionChecker::Plain, helpers::PartititonInformation::HDD);
+            for (unsigned pass = 0; pass < scheme.passes_count(); ++pass) {
+                BOOST_CHECK(pass == 0 || eraser.flush());
+                BOOST_CHECK(eraser.erase_random(scheme.pattern(pass), scheme.pattern_length()));
+            }
+        }
+
+        // every pass overwrites the same areas, the last pattern stays
+        std::vector<uint8_t> erased = read_content(file_path);
+        BOOST_REQUIRE_EQUAL(erased.size(), content.size());
+        BOOST_CHECK(std::equal(scheme.pattern(2), scheme.pattern(2) + scheme.pattern_length(), erased.begin()));
+        BOOST_CHECK(std::search_n(erased.begin(), erased.end(), 64, 0x00) == erased.end());
+        BOOST_CHECK(std::search_n(erased.begin(), erased.end(), 64, 0xFF) == erased.end());
+
+        fs::remove(file_path);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestResumedErasure)
+{
+    constexpr uint64_t megabyte = 1024 * 1024;
+    std::vector<uint8_t> mask(0xFFFF, 0x5A);
+    const std::vector<uint8_t> content(megabyte * 5 + 100, 'a');
+
+    for (const fs::path& directory : eraser_test_directories()) {
+        fs::path file_path = directory / "eraser_resume_test.bin";
+        fs::ofstream(file_path, std::ios::binary).write(reinterpret_cast<const char*>(content.data()), content.size());
+
+        // the interrupted job has overwritten two megabytes, progress is reported every megabyte after that
+        std::vector<uint64_t> checkpoints;
+        {
+            NativeFileEraser eraser(file_path.wstring(), ShannonEncryptionChecker::Plain, helpers::PartititonInformation::HDD);
+            eraser.set_resume_offset(megabyte * 2);
+            eraser.set_checkpoint(megabyte, [&checkpoints](uint64_t offset) { checkpoints.push_back(offset); });
+            BOOST_CHECK(eraser.erase_full(mask.data(), mask.size()));
+        }
+        BOOST_CHECK((checkpoints == std::vector<uint64_t>{ megabyte * 3, megabyte * 4, megabyte * 5 }));
+
+        std::vector<uint8_t> erased = read_content(file_path);
+        BOOST_REQUIRE_EQUAL(erased.size(), content.size());
+        BOOST_CHECK(std::all_of(erased.begin(), erased.begin() + megabyte * 2, [](uint8_t b) { return b == 'a'; }));
+        BOOST_CHECK(std::all_of(erased.begin() + megabyte * 2, erased.end(), [](uint8_t b) { return b == 0x5A; }));
+
+        // the checkpoint is trusted while the bytes before its offset are the journaled ones
+        ErasureCheckpoint checkpoint;
+        checkpoint.offset = megabyte * 3;
+        BOOST_REQUIRE(DriveEraser::read_checkpoint_probe(file_path.wstring(), checkpoint, checkpoint.probe));
+        {
+            fs::fstream file(file_path, std::ios::binary | std::ios::in | std::ios::out);
+            file.seekp(megabyte * 3);
+            file.put('a');
+        }
+        uint64_t probe = 0;
+        BOOST_REQUIRE(DriveEraser::read_checkpoint_probe(file_path.wstring(), checkpoint, probe));
+        BOOST_CHECK_EQUAL(probe, checkpoint.probe);
+        {
+            fs::fstream file(file_path, std::ios::binary | std::ios::in | std::ios::out);
+            file.seekp(megabyte * 3 - 1);
+            file.put('a');
+        }
+        BOOST_REQUIRE(DriveEraser::read_checkpoint_probe(file_path.wstring(), checkpoint, probe));
+        BOOST_CHECK_NE(probe, checkpoint.probe);
+
+        // overwritten file is validated by its beginning
+        ErasureCheckpoint overwritten;
+        overwritten.overwritten = true;
+        BOOST_REQUIRE(DriveEraser::read_checkpoint_probe(file_path.wstring(), overwritten, probe));
+        BOOST_CHECK_NE(probe, checkpoint.probe);
+
+        fs::remove(file_path);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestReadBackVerification)
+{
+    // later write replaces the overlapped part, remainders keep their origin
+    WrittenRanges written_ranges;
+    written_ranges.add({ 0, 100, 0, 0 });
+    written_ranges.add({ 50, 10, 50, 0 });
+    std::vector<WrittenRange> ranges = written_ranges.ranges();
+    BOOST_REQUIRE_EQUAL(ranges.size(), 3u);
+    BOOST_CHECK_EQUAL(ranges[1].origin, 50u);
+    BOOST_CHECK_EQUAL(ranges[2].offset, 60u);
+    BOOST_CHECK_EQUAL(ranges[2].origin, 0u);
+
+    // the mask restarts every write block, so that its phase is checked
+    constexpr size_t mask_length = 0xFFFF;
+    std::vector<uint8_t> mask(mask_length);
+    for (size_t i = 0; i < mask_length; ++i) {
+        mask[i] = static_cast<uint8_t>(i * 131 + (i >> 8));
+    }
+    const std::vector<uint8_t> content(1024 * 1024 * 3 + 100, 'a');
+
+    for (const fs::path& directory : eraser_test_directories()) {
+        ReadBackVerifier verifier;
+        std::vector<fs::path> file_paths = { directory / "eraser_verified_test.bin", directory / "eraser_corrupted_test.bin" };
+        for (const fs::path& file_path : file_paths) {
+            fs::ofstream(file_path, std::ios::binary).write(reinterpret_cast<const char*>(content.data()), content.size());
+
+            NativeFileEraser eraser(file_path.wstring(), ShannonEncryptionChecker::Plain, helpers::PartititonInformation::HDD);
+            eraser.set_verification(true);
+            eraser.set_block_size(1024 * 100);
+            eraser.set_direct_io(true);
+            BOOST_CHECK(eraser.erase_full(mask.data(), mask.size()));
+            BOOST_CHECK(eraser.erase_begin_end(mask.data(), mask.size()));
+
+            VerificationJob job;
+            BOOST_REQUIRE(eraser.verification_job(job));
+            if (file_path == file_paths.back()) {
+                fs::fstream corrupted(file_path, std::ios::binary | std::ios::in | std::ios::out);
+                corrupted.seekp(1024 * 1024 * 2);
+                corrupted.put('a');
+            }
+            verifier.submit(std::move(job));
+
+            // the node is removed while the file is read back, as the eraser does
+            if (file_path == file_paths.front()) {
+                fs::remove(file_path);
+            }
+        }
+
+        std::vector<std::string> failed_files = verifier.wait();
+        BOOST_REQUIRE_EQUAL(failed_files.size(), 1u);
+        BOOST_CHECK_EQUAL(failed_files.front(), file_paths.back().string());
+        for (const fs::path& file_path : file_paths) {
+            fs::remove(file_path);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestEraseRegions)
+{
+    constexpr size_t mask_length = 0xFFFF;
+    constexpr uint64_t region_size = 1024 * 1024;
+    std::vector<uint8_t> mask(mask_length, 0x5A);
+    std::vector<uint8_t> content(region_size * 4, 'a');
+
+    // the second region is ciphertext, it is erased only at the beginning
+    auto entropy_map = std::make_shared<EntropyMap>(region_size);
+    entropy_map->push_back(0.0);
+    entropy_map->push_back(8.0);
+    entropy_map->push_back(0.0);
+    entropy_map->push_back(0.0);
+
+    fs::path file_path = eraser_test_directories().front() / "eraser_regions_test.bin";
+    fs::ofstream(file_path, std::ios::binary).write(reinterpret_cast<const char*>(content.data()), content.size());
+    {
+        NativeFileEraser eraser(file_path.wstring(), ShannonEncryptionChecker::Binary, helpers::PartititonInformation::HDD);
+        eraser.set_entropy_map(entropy_map);
+        BOOST_CHECK(eraser.erase_smart(mask.data(), mask.size()));
+    }
+    std::vector<uint8_t> erased = read_content(file_path);
+    fs::remove(file_path);
+
+    BOOST_REQUIRE_EQUAL(erased.size(), content.size());
+    BOOST_CHECK_EQUAL(erased[region_size - 1], 0x5A);
+    BOOST_CHECK_EQUAL(erased[region_size + mask_length - 1], 0x5A);
+    BOOST_CHECK_EQUAL(erased[region_size + mask_length], 'a');
+    BOOST_CHECK_EQUAL(erased[region_size * 2], 0x5A);
+}
+
+BOOST_AUTO_TEST_CASE(TestEraseDirectIo)
+{
+    constexpr size_t mask_length = 0xFFFF;
+    std::vector<uint8_t> mask(mask_length, 0x5A);
+    const std::vector<uint8_t> content(1024 * 1024 * 3 + 100, 'a');
+
+    // tmpfs may refuse direct I/O, erasure falls back to the page cache then
+    for (const fs::path& directory : eraser_test_directories()) {
+        fs::path file_path = directory / "eraser_direct_test.bin";
+        fs::ofstream(file_path, std::ios::binary).write(reinterpret_cast<const char*>(content.data()), content.size());
+        {
+            NativeFileEraser eraser(file_path.wstring(), ShannonEncryptionChecker::Plain, helpers::PartititonInformation::SSD);
+            eraser.set_block_size(1024 * 100);
+            eraser.set_direct_io(true);
+            BOOST_CHECK(eraser.erase_full(mask.data(), mask.size()));
+        }
+        std::vector<uint8_t> erased = read_content(file_path);
+        fs::remove(file_path);
+
+        BOOST_REQUIRE_EQUAL(erased.size(), content.size());
+        BOOST_CHECK(std::all_of(erased.begin(), erased.end(), [](uint8_t b) { return b == 0x5A; }));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestDurabilityPolicies)
+{
+    constexpr size_t mask_length = 0xFFFF;
+    std::vector<uint8_t> mask(mask_length, 0x5A);
+    const std::vector<uint8_t> content(1024 * 1024 + 100, 'a');
+
+    for (const fs::path& directory : eraser_test_directories()) {
+        fs::path file_path = directory / "eraser_durability_test.bin";
+        for (DurabilityPolicy durability : { DurabilityPolicy::PerWrite, DurabilityPolicy::PerFile, DurabilityPolicy::GroupCommit }) {
+            fs::ofstream(file_path, std::ios::binary).write(reinterpret_cast<const char*>(content.data()), content.size());
+            {
+                NativeFileEraser eraser(file_path.wstring(), ShannonEncryptionChecker::Plain,
+                                        helpers::PartititonInformation::HDD, durability);
+                BOOST_CHECK(eraser.erase_full(mask.data(), mask.size()));
+            }
+            BOOST_CHECK(NativeFileEraser::sync_filesystem(directory.wstring()));
+
+            std::vector<uint8_t> erased = read_content(file_path);
+            BOOST_REQUIRE_EQUAL(erased.size(), content.size());
+            BOOST_CHECK(std::all_of(erased.begin(), erased.end(), [](uint8_t b) { return b == 0x5A; }));
+        }
+
+        // group commit falls back to flushing files one by one, the node of a file not flushed is kept
+        BOOST_CHECK(NativeFileEraser::flush_file(file_path.wstring()));
+        fs::remove(file_path);
+        BOOST_CHECK(!NativeFileEraser::flush_file(file_path.wstring()));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestIoUringEraser)
+{
+    IoUringEraser io_uring_eraser;
+    if (!io_uring_eraser.init(8, 1024 * 256)) {
+        BOOST_TEST_MESSAGE("io_uring is not available, skipped");
+        return;
+    }
+
+    constexpr size_t mask_length = 0xFFFF;
+    std::vector<uint8_t> mask(mask_length, 0x5A);
+    const std::vector<uint8_t> content(1024 * 1024 * 3 + 100, 'a');
+
+    // writes of several files are in flight at once, the last one is unlinked after sync
+    for (const fs::path& directory : eraser_test_directories()) {
+        std::vector<fs::path> file_paths;
+        for (int i = 0; i < 3; ++i) {
+            file_paths.push_back(directory / ("eraser_uring_test" + std::to_string(i) + ".bin"));
+            fs::ofstream(file_paths.back(), std::ios::binary).write(reinterpret_cast<const char*>(content.data()), content.size());
+        }
+
+        std::vector<std::unique_ptr<NativeFileEraser>> erasers;
+        for (const fs::path& file_path : file_paths) {
+            erasers.push_back(std::make_unique<NativeFileEraser>(file_path.wstring(), ShannonEncryptionChecker::Plain,
+                                                                 helpers::PartititonInformation::SSD));
+            erasers.back()->set_direct_io(file_paths.size() == erasers.size());
+            erasers.back()->set_io_uring_eraser(&io_uring_eraser);
+            BOOST_CHECK(erasers.back()->erase_full(mask.data(), mask.size()));
+        }
+        erasers[0]->close();
+        erasers[1]->close();
+        BOOST_CHECK(erasers[2]->close_and_unlink(file_paths[2].wstring()));
+        BOOST_CHECK(io_uring_eraser.wait_all());
+
+        for (size_t i = 0; i < 2; ++i) {
+            std::vector<uint8_t> erased = read_content(file_paths[i]);
+            fs::remove(file_paths[i]);
+            BOOST_REQUIRE_EQUAL(erased.size(), content.size());
+            BOOST_CHECK(std::all_of(erased.begin(), erased.end(), [](uint8_t b) { return b == 0x5A; }));
+        }
+        BOOST_CHECK(!fs::exists(file_paths[2]));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestAsyncUnlinkOfSameLengthNames)
+{
+    IoUringEraser io_uring_eraser;
+    if (!io_uring_eraser.init(8, 1024 * 256)) {
+        BOOST_TEST_MESSAGE("io_uring is not available, skipped");
+        return;
+    }
+
+    constexpr size_t mask_length = 0xFFFF;
+    std::vector<uint8_t> mask(mask_length, 0x5A);
+    const std::vector<uint8_t> content(1024 * 1024 + 100, 'a');
+
+    // renamed nodes of both files wait for the unlink at once, the file named like them is kept
+    for (const fs::path& directory : eraser_test_directories()) {
+        const std::vector<fs::path> file_paths = { directory / "eraser_same_a.bin", directory / "eraser_same_b.bin" };
+        const fs::path kept_path = directory / std::string(file_paths[0].filename().string().size(), 'c');
+        fs::ofstream(kept_path, std::ios::binary) << "kept";
+
+        std::vector<std::unique_ptr<NativeFileEraser>> erasers;
+        std::vector<fs::path> renamed_paths;
+        for (const fs::path& file_path : file_paths) {
+            fs::ofstream(file_path, std::ios::binary).write(reinterpret_cast<const char*>(content.data()), content.size());
+            erasers.push_back(std::make_unique<NativeFileEraser>(file_path.wstring(), ShannonEncryptionChecker::Plain,
+                                                                 helpers::PartititonInformation::SSD));
+            erasers.back()->set_io_uring_eraser(&io_uring_eraser);
+            BOOST_CHECK(erasers.back()->erase_full(mask.data(), mask.size()));
+
+            fs::path renamed_path;
+            BOOST_REQUIRE(DriveEraser::rename_file_node(file_path.wstring(), renamed_path));
+            BOOST_CHECK_EQUAL(renamed_path.filename().string().size(), file_path.filename().string().size());
+            renamed_paths.push_back(renamed_path);
+        }
+        BOOST_CHECK(renamed_paths[0] != renamed_paths[1]);
+
+        for (size_t i = 0; i < erasers.size(); ++i) {
+            BOOST_CHECK(erasers[i]->close_and_unlink(renamed_paths[i].wstring()));
+        }
+        BOOST_CHECK(io_uring_eraser.wait_all());
+
+        for (size_t i = 0; i < file_paths.size(); ++i) {
+            BOOST_CHECK(!fs::exists(file_paths[i]));
+            BOOST_CHECK(!fs::exists(renamed_paths[i]));
+        }
+        const std::vector<uint8_t> kept = read_content(kept_path);
+        BOOST_CHECK_EQUAL(std::string(kept.begin(), kept.end()), "kept");
+        fs::remove(kept_path);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestIoUringPartialSubmit)
+{
+    IoUringQueue queue;
+    if (!queue.init(8)) {
+        BOOST_TEST_MESSAGE("io_uring is not available, skipped");
+        return;
+    }
+
+    const fs::path file_path = fs::temp_directory_path() / "eraser_partial_submit.bin";
+    fs::ofstream(file_path, std::ios::binary) << std::string(4096, 'a');
+    int fd = ::open(file_path.c_str(), O_RDONLY);
+    BOOST_REQUIRE(fd >= 0);
+
+    // unlink of an invalid path fails on submission and ends it, reads behind it stay in the ring
+    std::vector<char> buffer(4096);
+    BOOST_REQUIRE(queue.prepare_unlink(nullptr, 0));
+    BOOST_REQUIRE(queue.prepare_read(fd, buffer.data(), 4096, 0, 1));
+    BOOST_REQUIRE(queue.prepare_read(fd, buffer.data(), 4096, 0, 2));
+    BOOST_CHECK(queue.submit());
+
+    int reads_done{};
+    IoUringCompletion completion;
+    while (queue.in_flight() > 0 && queue.wait_completion(completion)) {
+        if (0 == completion.user_data) {
+            BOOST_CHECK(completion.result < 0);
+        }
+        else if (4096 == completion.result) {
+            ++reads_done;
+        }
+    }
+    BOOST_CHECK_EQUAL(reads_done, 2);
+    ::close(fd);
+    fs::remove(file_path);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#pragma endregion
+
+#endif // defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))